@@ -1,12 +1,51 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <ctype.h>
 #include <math.h>
+#include <time.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <pthread.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <dirent.h>
+#else
+#include <io.h>
+#include <direct.h>
+#include <sys/stat.h>
+#endif
 
 #define COMMAND_MAX_SIZE 100
+
+// Notas em ponto fixo: compilado com -DNOTA_PONTO_FIXO=1, o programa guarda e indexa as notas como dcimos
+// em int16 (436.8 vira 4368). A igualdade de chaves fica exata e as comparaes so inteiras; como a chave
+// ocupa metade, o n de ndice tem mais filhos no mesmo tamanho. Uma base gravada num modo no abre no outro.
+#ifndef NOTA_PONTO_FIXO
+#define NOTA_PONTO_FIXO 0
+#endif
+
+#if NOTA_PONTO_FIXO
+typedef int16_t Nota;
+#define ORDEM 682 // N de ndice com os mesmos 4104 bytes do de ordem 512 com chaves float
+#define NOTA_DE_FLOAT(f) ((Nota)lrintf((f) * 10.0f))
+#define NOTA_PARA_FLOAT(n) ((float)(n) / 10.0f)
+#define NOTAS_IGUAIS(a, b) ((a) == (b))
+#else
+typedef float Nota;
 #define ORDEM 512 // Ordem da rvore B+ (512 para otimizar I/O em grandes volumes)
+#define NOTA_DE_FLOAT(f) (f)
+#define NOTA_PARA_FLOAT(n) (n)
+#define NOTAS_IGUAIS(a, b) (fabsf((a) - (b)) < 0.0001f)
+#endif
 #define ALPHABET_SIZE 10 // O campo nu_seq tem 15 caracteres. O alfabeto  (0-9).
 #define CHAVE_MAX_LENGTH 15
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
@@ -15,28 +54,38 @@
 
 /************************************************ ESTRUTURAS DE CONTROLE ************************************************/
 
-// N da Lista Encadeada de Registros por Estado
-typedef struct NoRegistro {
-    int indice_registro; // ndice do Participante no participantes.bin
-    int prox;            // Posio no arquivo do prximo NoRegistro (-1 se for o ltimo)
-} NoRegistro;
-
 // Entrada da Tabela Hash Esttica (no Cabealho)
-// Guarda a posio inicial da lista encadeada no arquivo.
+// Depois do cabealho o arquivo guarda, estado aps estado, um vetor contguo e crescente
+// com os ndices (int) dos participantes de cada Estado.
 typedef struct {
     char estado[3]; // Sigla do Estado (Ex: "RS", "CE")
-    int pont_lista; // Posio no arquivo do primeiro NoRegistro da lista (-1 se vazia)
+    int inicio;     // Posio (em ndices, a partir do fim do cabealho) do primeiro ndice do Estado
+    int qtd;        // Quantidade de participantes do Estado
 } EntradaHashEstado;
 
 // Cabealho do Arquivo de Registros Invertidos
 #define QTD_ESTADOS 27
 typedef struct {
     EntradaHashEstado tabela_hash[QTD_ESTADOS];
-    int qtd_nos; // Quantidade total de ns de lista encadeada (para clculo de posio)
+    int qtd_nos; // Quantidade total de ndices gravados (soma de todos os Estados)
 } HeaderRegistroEstado;
 
+// participantes.bin e participantes_respostas.bin tm o mesmo cabealho. `formato` diz como os registros
+// esto gravados; sem ele (ou com outro valor) o arquivo  do formato em linhas, com o Participante inteiro.
+// Uma base num formato anterior ao compacto  convertida ao abrir
+#define FORMATO_PARTICIPANTES_COLUNAS 2       // RegistroColunas e RespostasParticipante
+#define FORMATO_PARTICIPANTES_COMPACTO 3      // RegistroCompacto e RespostasCompactas, notas em float
+#define FORMATO_PARTICIPANTES_COMPACTO_FIXO 4 // O mesmo com as notas em ponto fixo (NOTA_PONTO_FIXO)
+
+#if NOTA_PONTO_FIXO
+#define FORMATO_PARTICIPANTES FORMATO_PARTICIPANTES_COMPACTO_FIXO
+#else
+#define FORMATO_PARTICIPANTES FORMATO_PARTICIPANTES_COMPACTO
+#endif
+
 typedef struct {
     int qtd_registros;
+    int formato; // FORMATO_PARTICIPANTES_*
 } HeaderParticipantes;
 
 // Estrutura para os dados de localizao (tabela separada)
@@ -74,6 +123,8 @@ typedef struct {
 } HeaderTrie;
 
 
+// Participante completo, como vem do CSV (e como era gravado no formato em linhas). As notas ficam em float
+// at separar_participante
 typedef struct {
     char nu_seq[15];
     int ano;
@@ -94,6 +145,643 @@ typedef struct {
     float nota_red;
 } Participante;
 
+// O participante fica gravado em dois arquivos de colunas, com o mesmo ndice de registro.
+// participantes.bin: identificao, notas e ndices das dimenses (o que LIST, FILTER e os ndices leem)
+typedef struct {
+    char nu_seq[15];
+    int ano;
+    int indice_localizacao;
+    int indice_gabarito_cn;
+    int indice_gabarito_ch;
+    int indice_gabarito_lc;
+    int indice_gabarito_mt;
+    Nota nota_cn;
+    Nota nota_ch;
+    Nota nota_lc;
+    Nota nota_mt;
+    int ling_est;
+    Nota nota_red;
+} RegistroParticipante;
+
+// participantes_respostas.bin: as respostas, que s SHOW e FIND mostram
+typedef struct {
+    char resp_cn[50];
+    char resp_ch[50];
+    char resp_lc[50];
+    char resp_mt[50];
+} RespostasParticipante;
+
+// Os dois arquivos guardam os registros no formato compacto abaixo; os comandos leem sempre a verso
+// decodificada (RegistroParticipante e RespostasParticipante).
+// nu_seq vira inteiro: valor * 16 + quantidade de dgitos, para os zeros  esquerda voltarem na decodificao
+typedef struct {
+    uint64_t nu_seq;
+    Nota nota_cn;
+    Nota nota_ch;
+    Nota nota_lc;
+    Nota nota_mt;
+    Nota nota_red;
+    int32_t indice_localizacao;
+    int32_t indice_gabarito_cn;
+    int32_t indice_gabarito_ch;
+    int32_t indice_gabarito_lc;
+    int32_t indice_gabarito_mt;
+    int16_t ano;
+    int8_t ling_est;
+} RegistroCompacto;
+
+// Respostas a 3 bits por item (cdigo em ALFABETO_RESPOSTAS), com a quantidade de itens de cada rea
+#define MAX_ITENS_RESPOSTA 49 // resp_*[50] sem o '\0'
+#define BYTES_ITENS_RESPOSTA ((MAX_ITENS_RESPOSTA * 3 + 7) / 8)
+
+typedef struct {
+    uint8_t qtd_itens[4]; // CN, CH, LC, MT
+    uint8_t itens[4][BYTES_ITENS_RESPOSTA];
+} RespostasCompactas;
+
+// Tipos de campo do esquema de importao (colunas do Participante e colunas extras)
+#define TIPO_CAMPO_CODIGO 0    // Texto ASCII copiado como est (truncado no tamanho do destino)
+#define TIPO_CAMPO_TEXTO 1     // Texto livre, convertido para UTF-8 se o CSV est em latin1
+#define TIPO_CAMPO_INT 2
+#define TIPO_CAMPO_FLOAT 3
+#define TIPO_CAMPO_COD_PROVA 4 // Cdigo que pode vir como "1420.0": guarda s "1420"
+
+// Colunas extras: projetadas do CSV por CONFIG COLUNAS e gravadas em participantes_extra.bin,
+// um registro por participante, s com as colunas escolhidas
+#define MAX_COLUNAS_EXTRAS 32
+#define TAM_MAX_REGISTRO_EXTRA 128
+
+typedef struct {
+    char nome[32]; // Nome da coluna no CSV
+    int tipo;      // TIPO_CAMPO_*
+    int offset;    // Posio do valor dentro do registro
+    int tamanho;
+} ColunaExtra;
+
+typedef struct {
+    int qtd_registros;
+    int primeiro_registro; // Participante do primeiro registro (os anteriores no tm colunas extras)
+    int tamanho_registro;
+    int qtd_colunas;
+    ColunaExtra colunas[MAX_COLUNAS_EXTRAS];
+} HeaderExtras;
+
+// Caminhos dos arquivos da base: o diretrio da verso em uso ("." ou "base_<n>"), a barra e o nome do
+// arquivo, que no mximo  o de uma run LSM ou de um temporrio (como "participantes_respostas.bin.tmp")
+#define TAM_DIRETORIO_BASE 32
+#define TAM_NOME_ARQUIVO_BASE 64
+#define TAM_CAMINHO (TAM_DIRETORIO_BASE + TAM_NOME_ARQUIVO_BASE)
+
+// snprintf de um caminho de arquivo. Um caminho que no cabe em `tamanho` viraria o de outro arquivo se fosse
+// cortado; como todos os nomes do programa cabem em TAM_CAMINHO, isso  erro de programa e ele para
+void montar_caminho(char *destino, size_t tamanho, const char *formato, ...) {
+    va_list args;
+    va_start(args, formato);
+    int escritos = vsnprintf(destino, tamanho, formato, args);
+    va_end(args);
+    if (escritos < 0 || (size_t)escritos >= tamanho) {
+        fprintf(stderr, "Caminho de arquivo longo demais (limite de %zu caracteres): %s...\n", tamanho - 1, destino);
+        exit(1);
+    }
+}
+
+/************************************************ TRANSAO DE ESCRITA ************************************************/
+
+// Durante um READ os arquivos com cabealho (participantes, localizao e gabaritos)
+// so escritos numa transao: os cabealhos ficam s em memria, os appends seguem em sequncia por um
+// buffer grande do stdio e no h fflush por registro. O cabealho vai ao disco no commit ou num checkpoint,
+// sempre depois dos dados que ele conta, ento o cabealho gravado nunca aponta alm de dados vlidos.
+#define TAM_BUFFER_TRANSACAO (4 * 1024 * 1024)
+
+int ESCRITA_EM_TRANSACAO = 0;
+long CHECKPOINT_IMPORTACAO = 500000; // Registros entre checkpoints; 0 = s no commit (CONFIG CHECKPOINT)
+
+// Arquivos s de append ganham um buffer grande enquanto a transao estiver ativa.
+// Deve ser chamada logo aps o fopen, antes de qualquer leitura ou escrita no arquivo
+void preparar_buffer_transacao(FILE *fp) {
+    if (ESCRITA_EM_TRANSACAO && fp) {
+        setvbuf(fp, NULL, _IOFBF, TAM_BUFFER_TRANSACAO);
+    }
+}
+
+// Leva os dados pendentes ao disco e s ento regrava o cabealho. Deixa o arquivo posicionado no fim
+void gravar_cabecalho(FILE *fp, const void *header, long tamanho) {
+    fflush(fp);
+    fseek(fp, 0, SEEK_SET);
+    fwrite(header, tamanho, 1, fp);
+    fflush(fp);
+    fseek(fp, 0, SEEK_END);
+}
+
+// Descarta o que foi escrito depois do ltimo cabealho gravado (registros de um READ interrompido).
+// Deixa o arquivo posicionado no novo fim
+void truncar_arquivo(FILE *fp, long tamanho) {
+    fflush(fp);
+#ifdef _WIN32
+    _chsize(_fileno(fp), tamanho);
+#else
+    if (ftruncate(fileno(fp), tamanho) != 0) perror("Erro ao truncar arquivo");
+#endif
+    fseek(fp, 0, SEEK_END);
+}
+
+int arquivo_existe(const char *nome) {
+    struct stat st;
+    return stat(nome, &st) == 0;
+}
+
+// fsync de um arquivo ou diretrio pelo nome; um que no existe no  erro. Retorna 0 em caso de sucesso.
+// No Windows no h fsync de diretrio e os arquivos ficam com o que o sistema j gravou.
+int sincronizar_caminho_disco(const char *nome) {
+#ifndef _WIN32
+    int fd = open(nome, O_RDONLY);
+    if (fd < 0) return errno != ENOENT;
+    int erro = (fsync(fd) != 0);
+    close(fd);
+    return erro;
+#else
+    (void)nome;
+    return 0;
+#endif
+}
+
+// Os arquivos que so trocados inteiros (ndices, manifesto LSM) so gravados antes em `<nome>.tmp`.
+// Pe o temporrio no lugar de `nome`; retorna 1 se ele existia e foi trocado
+int trocar_arquivo_tmp(const char *nome) {
+    char nome_tmp[TAM_CAMINHO];
+    montar_caminho(nome_tmp, sizeof(nome_tmp), "%s.tmp", nome);
+    if (!arquivo_existe(nome_tmp)) return 0;
+#ifdef _WIN32
+    remove(nome); // rename() do Windows no sobrescreve
+#endif
+    if (rename(nome_tmp, nome) != 0) {
+        perror("Erro ao trocar um arquivo pelo temporario");
+        return 0;
+    }
+    return 1;
+}
+
+// fsync de `<nome>.tmp` se ele existe (a troca ainda no foi feita), seno do prprio `nome`
+int sincronizar_arquivo_ou_tmp_disco(const char *nome) {
+    char nome_tmp[TAM_CAMINHO];
+    montar_caminho(nome_tmp, sizeof(nome_tmp), "%s.tmp", nome);
+    return sincronizar_caminho_disco(arquivo_existe(nome_tmp) ? nome_tmp : nome);
+}
+
+/************************************************ ARENA DE MEMRIA ************************************************/
+
+// Memria de vida curta das construes em lote: arena_alocar s avana um deslocamento dentro do bloco
+// atual e nada  liberado individualmente; arena_liberar devolve todos os blocos de uma vez.
+#define TAM_BLOCO_ARENA (1024 * 1024)
+#define ALINHAMENTO_ARENA 16
+
+typedef struct BlocoArena {
+    struct BlocoArena *anterior;
+    size_t tamanho; // Bytes de dados depois do cabealho
+    size_t usado;
+} BlocoArena;
+
+typedef struct {
+    BlocoArena *atual;
+    size_t tam_bloco;
+} Arena;
+
+#define CABECALHO_BLOCO_ARENA ((sizeof(BlocoArena) + ALINHAMENTO_ARENA - 1) & ~(size_t)(ALINHAMENTO_ARENA - 1))
+
+void arena_inicializar(Arena *a, size_t tam_bloco) {
+    a->atual = NULL;
+    a->tam_bloco = tam_bloco;
+}
+
+// Retorna memria no inicializada, alinhada em ALINHAMENTO_ARENA. Pedidos maiores que o bloco ganham um bloco s seu
+void *arena_alocar(Arena *a, size_t tamanho) {
+    tamanho = (tamanho + ALINHAMENTO_ARENA - 1) & ~(size_t)(ALINHAMENTO_ARENA - 1);
+    BlocoArena *b = a->atual;
+    if (!b || b->tamanho - b->usado < tamanho) {
+        size_t tam_dados = MAX(tamanho, a->tam_bloco);
+        b = (BlocoArena *)malloc(CABECALHO_BLOCO_ARENA + tam_dados);
+        if (!b) { perror("Erro ao alocar bloco da arena"); exit(1); }
+        b->anterior = a->atual;
+        b->tamanho = tam_dados;
+        b->usado = 0;
+        a->atual = b;
+    }
+    void *ptr = (char *)b + CABECALHO_BLOCO_ARENA + b->usado;
+    b->usado += tamanho;
+    return ptr;
+}
+
+void arena_liberar(Arena *a) {
+    while (a->atual) {
+        BlocoArena *anterior = a->atual->anterior;
+        free(a->atual);
+        a->atual = anterior;
+    }
+}
+
+/************************************************ CACHE DE PGINAS DOS NDICES ************************************************/
+
+// Um nico pool de pginas de TAM_PAGINA_POOL bytes para os arquivos das rvores B+, da Trie e do ndice
+// por Estado, com limite de memria (CONFIG POOL) e substituio pelo relgio (CLOCK).
+// As pginas so identificadas pelo arquivo no disco (dispositivo + inode), no pelo FILE*: continuam no
+// pool de um comando para o outro, quando a verso de leitura  reaberta. Como o READ troca os ndices
+// por rename (inode novo), um arquivo s perde suas pginas se for reaberto com outro tamanho ou outra
+// data de modificao. Escritas ficam na pgina, marcada suja, e s vo ao disco quando ela  descartada,
+// quando o FILE* que a sujou  sincronizado (sincronizar_arquivo_pool) ou quando ele  fechado
+// (fechar_arquivo_pool, obrigatrio para esses arquivos).
+#define TAM_PAGINA_POOL 4096
+#define MAX_ARQUIVOS_POOL 128
+#define MAX_HANDLES_POOL 256
+
+#define POOL_BMAIS 0
+#define POOL_TRIE 1
+#define POOL_ESTADO 2
+#define QTD_TIPOS_POOL 3
+
+long MEMORIA_POOL_MB = 64; // CONFIG POOL
+
+typedef struct {
+    int em_uso;
+    unsigned long long dispositivo;
+    unsigned long long inode;
+    long long tamanho;     // Tamanho e data de modificao de quando o ltimo FILE* foi fechado
+    long long modificacao;
+    int handles;           // FILE* abertos para o arquivo
+    long long fim;         // Fim lgico, contando as escritas que ainda esto s no pool
+} ArquivoPool;
+
+typedef struct {
+    FILE *f;
+    int arquivo;
+} HandlePool;
+
+typedef struct {
+    int arquivo;       // ndice em arquivos; -1 se o quadro est livre
+    long pagina;
+    int valido;        // Bytes da pgina que existem no arquivo ou j foram escritos nela
+    int referenciada;  // Bit do relgio
+    FILE *f_sujo;      // Por onde a pgina volta ao disco; NULL se ela est igual ao arquivo
+    int proximo;       // Prximo quadro no mesmo balde da tabela hash
+} QuadroPool;
+
+typedef struct {
+    char *memoria;
+    QuadroPool *quadros;
+    int qtd_quadros;
+    int *baldes;
+    int qtd_baldes; // Potncia de 2
+    int relogio;
+    ArquivoPool arquivos[MAX_ARQUIVOS_POOL];
+    HandlePool handles[MAX_HANDLES_POOL];
+    int qtd_handles;
+    long long acertos[QTD_TIPOS_POOL];
+    long long faltas[QTD_TIPOS_POOL];
+    long long descartes;
+    long long gravacoes;
+    pthread_mutex_t mutex;
+} PoolPaginas;
+
+PoolPaginas POOL = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+// As funes abaixo at pool_ler so chamadas com o mutex do pool travado
+
+void pool_garantir_memoria() {
+    if (POOL.memoria) return;
+    POOL.qtd_quadros = (int)MAX(16, MEMORIA_POOL_MB * 1024 * 1024 / TAM_PAGINA_POOL);
+    POOL.qtd_baldes = 1;
+    while (POOL.qtd_baldes < 2 * POOL.qtd_quadros) POOL.qtd_baldes <<= 1;
+    POOL.memoria = (char *)malloc((size_t)POOL.qtd_quadros * TAM_PAGINA_POOL);
+    POOL.quadros = (QuadroPool *)malloc((size_t)POOL.qtd_quadros * sizeof(QuadroPool));
+    POOL.baldes = (int *)malloc((size_t)POOL.qtd_baldes * sizeof(int));
+    if (!POOL.memoria || !POOL.quadros || !POOL.baldes) { perror("Erro ao alocar o cache de paginas"); exit(1); }
+    for (int i = 0; i < POOL.qtd_quadros; i++) POOL.quadros[i].arquivo = -1;
+    for (int i = 0; i < POOL.qtd_baldes; i++) POOL.baldes[i] = -1;
+    POOL.relogio = 0;
+}
+
+int balde_pool(int arquivo, long pagina) {
+    unsigned long h = (unsigned long)pagina * 2654435761UL ^ (unsigned long)arquivo * 40503UL;
+    return (int)(h & (unsigned long)(POOL.qtd_baldes - 1));
+}
+
+int procurar_quadro_pool(int arquivo, long pagina) {
+    for (int q = POOL.baldes[balde_pool(arquivo, pagina)]; q != -1; q = POOL.quadros[q].proximo) {
+        if (POOL.quadros[q].arquivo == arquivo && POOL.quadros[q].pagina == pagina) return q;
+    }
+    return -1;
+}
+
+void gravar_quadro_pool(int q) {
+    QuadroPool *quadro = &POOL.quadros[q];
+    if (!quadro->f_sujo) return;
+    fseek(quadro->f_sujo, quadro->pagina * TAM_PAGINA_POOL, SEEK_SET);
+    fwrite(POOL.memoria + (size_t)q * TAM_PAGINA_POOL, 1, quadro->valido, quadro->f_sujo);
+    // Sem o fflush a pgina descartada ficaria no buffer do FILE*, e quem a relesse do disco por outro
+    // FILE* (uma verso de leitura) veria o contedo antigo
+    fflush(quadro->f_sujo);
+    quadro->f_sujo = NULL;
+    POOL.gravacoes++;
+}
+
+// Tira o quadro da tabela hash e o deixa livre (a pgina j deve estar gravada)
+void liberar_quadro_pool(int q) {
+    int *elo = &POOL.baldes[balde_pool(POOL.quadros[q].arquivo, POOL.quadros[q].pagina)];
+    while (*elo != q) elo = &POOL.quadros[*elo].proximo;
+    *elo = POOL.quadros[q].proximo;
+    POOL.quadros[q].arquivo = -1;
+}
+
+// Relgio: passa pelos quadros tirando o bit de referncia e usa o primeiro livre ou no referenciado
+int escolher_quadro_pool() {
+    for (;;) {
+        int q = POOL.relogio;
+        POOL.relogio = (POOL.relogio + 1) % POOL.qtd_quadros;
+        QuadroPool *quadro = &POOL.quadros[q];
+        if (quadro->arquivo == -1) return q;
+        if (quadro->referenciada) {
+            quadro->referenciada = 0;
+            continue;
+        }
+        gravar_quadro_pool(q);
+        liberar_quadro_pool(q);
+        POOL.descartes++;
+        return q;
+    }
+}
+
+void ler_quadro_pool(FILE *f, int q) {
+    QuadroPool *quadro = &POOL.quadros[q];
+    char *dados = POOL.memoria + (size_t)q * TAM_PAGINA_POOL;
+    size_t lidos = 0;
+    if (fseek(f, quadro->pagina * TAM_PAGINA_POOL, SEEK_SET) == 0) lidos = fread(dados, 1, TAM_PAGINA_POOL, f);
+    clearerr(f);
+    memset(dados + lidos, 0, TAM_PAGINA_POOL - lidos);
+    quadro->valido = (int)lidos;
+}
+
+// Quadro com a pgina `pagina` do arquivo, lida de `f` se ainda no est no pool
+int obter_quadro_pool(FILE *f, int arquivo, long pagina, int tipo) {
+    int q = procurar_quadro_pool(arquivo, pagina);
+    if (q != -1) {
+        POOL.acertos[tipo]++;
+    } else {
+        POOL.faltas[tipo]++;
+        q = escolher_quadro_pool();
+        QuadroPool *quadro = &POOL.quadros[q];
+        quadro->arquivo = arquivo;
+        quadro->pagina = pagina;
+        quadro->f_sujo = NULL;
+        int b = balde_pool(arquivo, pagina);
+        quadro->proximo = POOL.baldes[b];
+        POOL.baldes[b] = q;
+        ler_quadro_pool(f, q);
+    }
+    POOL.quadros[q].referenciada = 1;
+    return q;
+}
+
+void descartar_paginas_arquivo_pool(int arquivo) {
+    if (!POOL.memoria) return;
+    for (int q = 0; q < POOL.qtd_quadros; q++) {
+        if (POOL.quadros[q].arquivo == arquivo) {
+            gravar_quadro_pool(q);
+            liberar_quadro_pool(q);
+        }
+    }
+}
+
+void identificar_arquivo_pool(FILE *f, ArquivoPool *id) {
+    struct stat st;
+    memset(id, 0, sizeof(ArquivoPool));
+    if (fstat(fileno(f), &st) != 0) return;
+#ifdef _WIN32
+    // Sem inode: cada FILE*  um arquivo, e as pginas saem do pool quando ele  fechado
+    id->inode = (unsigned long long)(uintptr_t)f;
+#else
+    id->dispositivo = (unsigned long long)st.st_dev;
+    id->inode = (unsigned long long)st.st_ino;
+#endif
+    id->tamanho = (long long)st.st_size;
+#ifdef __linux__
+    id->modificacao = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#else
+    id->modificacao = (long long)st.st_mtime;
+#endif
+}
+
+// Arquivo do pool de `f`, registrando o FILE* no primeiro acesso. -1 se as tabelas esto cheias:
+// o chamador l e escreve direto no arquivo
+int arquivo_do_handle_pool(FILE *f) {
+    for (int h = 0; h < POOL.qtd_handles; h++) {
+        if (POOL.handles[h].f == f) return POOL.handles[h].arquivo;
+    }
+    if (POOL.qtd_handles == MAX_HANDLES_POOL) return -1;
+
+    ArquivoPool id;
+    identificar_arquivo_pool(f, &id);
+    int arquivo = -1, livre = -1;
+    for (int a = 0; a < MAX_ARQUIVOS_POOL; a++) {
+        ArquivoPool *arq = &POOL.arquivos[a];
+        if (!arq->em_uso) {
+            if (livre == -1) livre = a;
+        } else if (arq->dispositivo == id.dispositivo && arq->inode == id.inode) {
+            arquivo = a;
+            break;
+        }
+    }
+    if (arquivo != -1 && POOL.arquivos[arquivo].handles == 0 &&
+        (POOL.arquivos[arquivo].tamanho != id.tamanho || POOL.arquivos[arquivo].modificacao != id.modificacao)) {
+        // Mudou desde que foi fechado (ou  outro arquivo com o inode reaproveitado)
+        descartar_paginas_arquivo_pool(arquivo);
+        POOL.arquivos[arquivo].em_uso = 0;
+        livre = arquivo;
+        arquivo = -1;
+    }
+    if (arquivo == -1) {
+        // Sem posio livre, um arquivo que ningum tem aberto cede a sua
+        for (int a = 0; livre == -1 && a < MAX_ARQUIVOS_POOL; a++) {
+            if (POOL.arquivos[a].handles == 0) {
+                descartar_paginas_arquivo_pool(a);
+                livre = a;
+            }
+        }
+        if (livre == -1) return -1;
+        arquivo = livre;
+        POOL.arquivos[arquivo] = id;
+        POOL.arquivos[arquivo].em_uso = 1;
+        POOL.arquivos[arquivo].fim = id.tamanho;
+    }
+    POOL.arquivos[arquivo].handles++;
+    POOL.handles[POOL.qtd_handles].f = f;
+    POOL.handles[POOL.qtd_handles].arquivo = arquivo;
+    POOL.qtd_handles++;
+    return arquivo;
+}
+
+// L `tamanho` bytes a partir de `offset` pelo pool. Retorna quantos bytes existiam (menos no fim do arquivo)
+size_t pool_ler(FILE *f, int tipo, long offset, void *destino, size_t tamanho) {
+    pthread_mutex_lock(&POOL.mutex);
+    pool_garantir_memoria();
+    int arquivo = arquivo_do_handle_pool(f);
+    if (arquivo == -1) {
+        pthread_mutex_unlock(&POOL.mutex);
+        if (fseek(f, offset, SEEK_SET) != 0) return 0;
+        return fread(destino, 1, tamanho, f);
+    }
+
+    size_t copiados = 0;
+    while (copiados < tamanho) {
+        long pos = offset + (long)copiados;
+        long pagina = pos / TAM_PAGINA_POOL;
+        int inicio = (int)(pos % TAM_PAGINA_POOL);
+        int n = (int)MIN((size_t)(TAM_PAGINA_POOL - inicio), tamanho - copiados);
+        int q = obter_quadro_pool(f, arquivo, pagina, tipo);
+        QuadroPool *quadro = &POOL.quadros[q];
+        // Pgina guardada antes de o arquivo crescer: rel a parte nova
+        if (inicio + n > quadro->valido && !quadro->f_sujo) ler_quadro_pool(f, q);
+        if (inicio + n > quadro->valido) n = MAX(0, quadro->valido - inicio);
+        memcpy((char *)destino + copiados, POOL.memoria + (size_t)q * TAM_PAGINA_POOL + inicio, n);
+        copiados += n;
+        if (inicio + n < TAM_PAGINA_POOL) break; // Fim do arquivo
+    }
+    pthread_mutex_unlock(&POOL.mutex);
+    return copiados;
+}
+
+// Escreve `tamanho` bytes a partir de `offset` nas pginas do pool, que ficam sujas
+void pool_escrever(FILE *f, int tipo, long offset, const void *origem, size_t tamanho) {
+    pthread_mutex_lock(&POOL.mutex);
+    pool_garantir_memoria();
+    int arquivo = arquivo_do_handle_pool(f);
+    if (arquivo == -1) {
+        pthread_mutex_unlock(&POOL.mutex);
+        fseek(f, offset, SEEK_SET);
+        fwrite(origem, 1, tamanho, f);
+        fflush(f);
+        return;
+    }
+
+    size_t copiados = 0;
+    while (copiados < tamanho) {
+        long pos = offset + (long)copiados;
+        int inicio = (int)(pos % TAM_PAGINA_POOL);
+        int n = (int)MIN((size_t)(TAM_PAGINA_POOL - inicio), tamanho - copiados);
+        int q = obter_quadro_pool(f, arquivo, pos / TAM_PAGINA_POOL, tipo);
+        QuadroPool *quadro = &POOL.quadros[q];
+        memcpy(POOL.memoria + (size_t)q * TAM_PAGINA_POOL + inicio, (const char *)origem + copiados, n);
+        quadro->valido = MAX(quadro->valido, inicio + n);
+        quadro->f_sujo = f;
+        copiados += n;
+    }
+    ArquivoPool *arq = &POOL.arquivos[arquivo];
+    arq->fim = MAX(arq->fim, (long long)offset + (long long)tamanho);
+    pthread_mutex_unlock(&POOL.mutex);
+}
+
+// Fim do arquivo contando as escritas que ainda esto s no pool (onde entra um registro acrescentado)
+long pool_fim_arquivo(FILE *f) {
+    pthread_mutex_lock(&POOL.mutex);
+    fseek(f, 0, SEEK_END);
+    long fim = ftell(f);
+    for (int h = 0; h < POOL.qtd_handles; h++) {
+        if (POOL.handles[h].f == f) fim = (long)MAX((long long)fim, POOL.arquivos[POOL.handles[h].arquivo].fim);
+    }
+    pthread_mutex_unlock(&POOL.mutex);
+    return fim;
+}
+
+// Grava no disco as pginas que `f` sujou (com o mutex do pool travado); elas continuam no pool
+void gravar_paginas_sujas_pool(FILE *f) {
+    for (int q = 0; q < POOL.qtd_quadros; q++) {
+        if (POOL.quadros[q].f_sujo == f) gravar_quadro_pool(q);
+    }
+    fflush(f);
+}
+
+// Leva ao disco tudo o que foi escrito por `f` at aqui, sem fech-lo
+void sincronizar_arquivo_pool(FILE *f) {
+    pthread_mutex_lock(&POOL.mutex);
+    gravar_paginas_sujas_pool(f);
+    pthread_mutex_unlock(&POOL.mutex);
+}
+
+// Grava as pginas que `f` sujou, tira o FILE* do pool e o fecha
+int fechar_arquivo_pool(FILE *f) {
+    pthread_mutex_lock(&POOL.mutex);
+    for (int h = 0; h < POOL.qtd_handles; h++) {
+        if (POOL.handles[h].f != f) continue;
+        gravar_paginas_sujas_pool(f);
+        int arquivo = POOL.handles[h].arquivo;
+        ArquivoPool *arq = &POOL.arquivos[arquivo];
+        if (--arq->handles == 0) {
+            ArquivoPool id;
+            identificar_arquivo_pool(f, &id);
+            arq->tamanho = id.tamanho;
+            arq->modificacao = id.modificacao;
+#ifdef _WIN32
+            descartar_paginas_arquivo_pool(arquivo);
+            arq->em_uso = 0;
+#endif
+        }
+        POOL.handles[h] = POOL.handles[--POOL.qtd_handles];
+        break;
+    }
+    pthread_mutex_unlock(&POOL.mutex);
+    return fclose(f);
+}
+
+// Troca o limite de memria: grava as pginas sujas e descarta todas (o pool  realocado no prximo acesso)
+void redimensionar_pool(long memoria_mb) {
+    pthread_mutex_lock(&POOL.mutex);
+    if (POOL.memoria) {
+        for (int q = 0; q < POOL.qtd_quadros; q++) gravar_quadro_pool(q);
+        for (int h = 0; h < POOL.qtd_handles; h++) fflush(POOL.handles[h].f);
+        free(POOL.memoria);
+        free(POOL.quadros);
+        free(POOL.baldes);
+        POOL.memoria = NULL;
+        POOL.quadros = NULL;
+        POOL.baldes = NULL;
+        POOL.qtd_quadros = 0;
+    }
+    MEMORIA_POOL_MB = memoria_mb;
+    pthread_mutex_unlock(&POOL.mutex);
+}
+
+// POOL: acertos e faltas por tipo de ndice desde o incio (ou desde o ltimo POOL ZERAR)
+void mostrar_estatisticas_pool(int zerar) {
+    const char *nomes[QTD_TIPOS_POOL] = {"Arvores B+", "Trie", "Indice por Estado"};
+    pthread_mutex_lock(&POOL.mutex);
+    int em_uso = 0;
+    for (int q = 0; q < POOL.qtd_quadros; q++) em_uso += (POOL.quadros[q].arquivo != -1);
+    printf("------------------------------------------------------------------------\n");
+    printf("Cache de paginas dos indices: limite de %ld MB, paginas de %d bytes\n", MEMORIA_POOL_MB, TAM_PAGINA_POOL);
+    printf("Paginas em uso: %d de %d (%.1f MB)\n", em_uso, POOL.qtd_quadros,
+           (double)em_uso * TAM_PAGINA_POOL / (1024.0 * 1024.0));
+    printf("%-20s %14s %14s %10s\n", "Indice", "Acertos", "Faltas", "Acerto");
+    long long total_acertos = 0, total_faltas = 0;
+    for (int t = 0; t <= QTD_TIPOS_POOL; t++) {
+        long long acertos = t < QTD_TIPOS_POOL ? POOL.acertos[t] : total_acertos;
+        long long faltas = t < QTD_TIPOS_POOL ? POOL.faltas[t] : total_faltas;
+        long long acessos = acertos + faltas;
+        printf("%-20s %14lld %14lld %9.1f%%\n", t < QTD_TIPOS_POOL ? nomes[t] : "Total", acertos, faltas,
+               acessos ? 100.0 * acertos / acessos : 0.0);
+        if (t < QTD_TIPOS_POOL) {
+            total_acertos += acertos;
+            total_faltas += faltas;
+        }
+    }
+    printf("Paginas descartadas: %lld (%lld gravadas de volta no disco)\n", POOL.descartes, POOL.gravacoes);
+    if (zerar) {
+        memset(POOL.acertos, 0, sizeof(POOL.acertos));
+        memset(POOL.faltas, 0, sizeof(POOL.faltas));
+        POOL.descartes = POOL.gravacoes = 0;
+        printf("Estatisticas zeradas.\n");
+    }
+    printf("------------------------------------------------------------------------\n");
+    pthread_mutex_unlock(&POOL.mutex);
+}
+
 /************************************************ RVORE TRIE ************************************************/
 
 // Tamanhos das novas estruturas
@@ -108,16 +796,13 @@ int char_to_index(char c) {
     return -1; // Caractere invlido
 }
 
-// Cria um n da Trie vazio
-TrieNode *cria_trie_node() {
-    TrieNode *n = (TrieNode *)malloc(tamanho_trie_node());
-    if (!n) { perror("Erro ao alocar TrieNode"); exit(1); }
+// Deixa o n da Trie vazio
+void iniciar_trie_node(TrieNode *n) {
     n->is_fim_de_palavra = 0;
     n->indice_registro = -1;
     for (int i = 0; i < ALPHABET_SIZE; i++) {
         n->filhos[i] = -1; // -1 significa NULL (ponteiro vazio)
     }
-    return n;
 }
 
 // --- Manipulao do Arquivo da Trie ---
@@ -145,104 +830,15 @@ FILE *abrir_arquivo_trie(const char *nome, HeaderTrie *h) {
     return fp;
 }
 
-// Salva o cabealho
-void salva_header_trie(FILE *fp, HeaderTrie *h) {
-    fseek(fp, 0, SEEK_SET);
-    fwrite(h, tamanho_header_trie(), 1, fp);
-    fflush(fp);
-}
-
-// Busca um n da Trie por ndice no arquivo
-TrieNode *buscar_trie_node(FILE *fp, int indice) {
+// L o n da Trie de ndice `indice` em `destino`. Retorna destino, ou NULL se no existe
+TrieNode *buscar_trie_node_em(FILE *fp, int indice, TrieNode *destino) {
     if (indice == -1) return NULL;
 
-    TrieNode *node = cria_trie_node();
     long offset = tamanho_header_trie() + indice * tamanho_trie_node();
-
-    if (fseek(fp, offset, SEEK_SET) != 0 || fread(node, tamanho_trie_node(), 1, fp) != 1) {
-        free(node);
+    if (pool_ler(fp, POOL_TRIE, offset, destino, tamanho_trie_node()) != (size_t)tamanho_trie_node()) {
         return NULL;
     }
-    return node;
-}
-
-// Salva/Atualiza um n da Trie. Se pos == -1, insere no fim.
-int salva_trie_node(FILE *fp, TrieNode *node, int pos) {
-    long offset;
-    int indice_salvo;
-
-    if (pos == -1) { // Inserir no fim
-        fseek(fp, 0, SEEK_END);
-        offset = ftell(fp);
-        indice_salvo = (offset - tamanho_header_trie()) / tamanho_trie_node();
-    } else { // Atualizar existente
-        indice_salvo = pos;
-        offset = tamanho_header_trie() + pos * tamanho_trie_node();
-        fseek(fp, offset, SEEK_SET);
-    }
-
-    fwrite(node, tamanho_trie_node(), 1, fp);
-    fflush(fp);
-    return indice_salvo;
-}
-
-// Insere uma nova chave (nu_seq) na Trie
-void inserir_trie(FILE *fp_trie, HeaderTrie *h_trie, const char *nu_seq, int indice_registro) {
-    int i;
-
-    // 1. Inicializao: Se a Trie estiver vazia, cria a raiz
-    if (h_trie->pont_raiz == -1) {
-        TrieNode *raiz = cria_trie_node();
-        int raiz_pos = salva_trie_node(fp_trie, raiz, -1);
-        h_trie->pont_raiz = raiz_pos;
-        h_trie->qtd_nos++;
-        salva_header_trie(fp_trie, h_trie);
-        free(raiz);
-    }
-
-    // 2. Traversal e Criao de Ns
-    int p_atual = h_trie->pont_raiz;
-    TrieNode *no_atual = NULL;
-
-    for (i = 0; i < strlen(nu_seq); i++) {
-        int index = char_to_index(nu_seq[i]);
-        if (index == -1) {
-            fprintf(stderr, "Aviso: Caractere invalido no nu_seq: %s\n", nu_seq);
-            return;
-        }
-
-        no_atual = buscar_trie_node(fp_trie, p_atual);
-        if (!no_atual) return; // Erro de leitura
-
-        if (no_atual->filhos[index] == -1) {
-            // Cria um novo n, salva no fim, e atualiza o pai
-            TrieNode *novo_no = cria_trie_node();
-            int novo_pos = salva_trie_node(fp_trie, novo_no, -1);
-            h_trie->qtd_nos++;
-
-            no_atual->filhos[index] = novo_pos;
-            salva_trie_node(fp_trie, no_atual, p_atual); // Atualiza o pai no disco
-            p_atual = novo_pos;
-
-            free(novo_no);
-        } else {
-            // Caminha para o prximo n
-            p_atual = no_atual->filhos[index];
-        }
-
-        free(no_atual); // Libera o n lido/atualizado
-    }
-
-    // 3. Marcao de Fim de Palavra (N Final)
-    no_atual = buscar_trie_node(fp_trie, p_atual);
-    if (!no_atual) return;
-
-    no_atual->is_fim_de_palavra = 1;
-    no_atual->indice_registro = indice_registro; // Armazena o ponteiro de dados
-    salva_trie_node(fp_trie, no_atual, p_atual); // Salva as alteraes
-    free(no_atual);
-
-    salva_header_trie(fp_trie, h_trie); // Atualiza a contagem de ns no cabealho
+    return destino;
 }
 
 // Busca a chave nu_seq na Trie e retorna o ndice do Participante ou -1
@@ -250,6 +846,7 @@ int buscar_trie(FILE *fp_trie, HeaderTrie *h_trie, const char *nu_seq) {
     if (h_trie->pont_raiz == -1) return -1;
 
     int p_atual = h_trie->pont_raiz;
+    TrieNode no;
     TrieNode *no_atual;
     int i;
 
@@ -257,11 +854,10 @@ int buscar_trie(FILE *fp_trie, HeaderTrie *h_trie, const char *nu_seq) {
         int index = char_to_index(nu_seq[i]);
         if (index == -1) return -1;
 
-        no_atual = buscar_trie_node(fp_trie, p_atual);
+        no_atual = buscar_trie_node_em(fp_trie, p_atual, &no);
         if (!no_atual) return -1; // Erro de leitura
 
         int p_proximo = no_atual->filhos[index];
-        free(no_atual);
 
         if (p_proximo == -1) {
             return -1; // Caminho no existe
@@ -270,21 +866,144 @@ int buscar_trie(FILE *fp_trie, HeaderTrie *h_trie, const char *nu_seq) {
     }
 
     // Chegou ao fim do nu_seq. Checa se  um n final de palavra.
-    no_atual = buscar_trie_node(fp_trie, p_atual);
+    no_atual = buscar_trie_node_em(fp_trie, p_atual, &no);
     if (!no_atual) return -1;
 
     int indice = -1;
     if (no_atual->is_fim_de_palavra) {
         indice = no_atual->indice_registro;
     }
-
-    free(no_atual);
     return indice;
 }
 
+// --- Construo da Trie em Memria (usada pelo READ) ---
+
+// Pool de ns: os ndices em `filhos` apontam para posies do prprio pool
+typedef struct {
+    TrieNode *nos;
+    int qtd_nos;
+    int capacidade;
+    int raiz;
+} TrieMemoria;
+
+#define CAPACIDADE_INICIAL_TRIE 4096
+#define NOS_POR_ESCRITA_TRIE 4096
+
+int trie_memoria_novo_no(TrieMemoria *t) {
+    if (t->qtd_nos == t->capacidade) {
+        t->capacidade = t->capacidade ? t->capacidade * 2 : CAPACIDADE_INICIAL_TRIE;
+        t->nos = (TrieNode *)realloc(t->nos, (size_t)t->capacidade * tamanho_trie_node());
+        if (!t->nos) { perror("Erro ao alocar o pool da Trie"); exit(1); }
+    }
+    iniciar_trie_node(&t->nos[t->qtd_nos]);
+    return t->qtd_nos++;
+}
+
+// Carrega a Trie j gravada (se houver) para o pool, mantendo os ndices do arquivo
+void trie_memoria_carregar(TrieMemoria *t, FILE *fp_trie, HeaderTrie *h_trie) {
+    memset(t, 0, sizeof(TrieMemoria));
+    t->raiz = -1;
+    if (h_trie->pont_raiz == -1 || h_trie->qtd_nos == 0) return;
+
+    t->capacidade = MAX(h_trie->qtd_nos, CAPACIDADE_INICIAL_TRIE);
+    t->nos = (TrieNode *)malloc((size_t)t->capacidade * tamanho_trie_node());
+    if (!t->nos) { perror("Erro ao alocar o pool da Trie"); exit(1); }
+
+    fseek(fp_trie, tamanho_header_trie(), SEEK_SET);
+    t->qtd_nos = (int)fread(t->nos, tamanho_trie_node(), h_trie->qtd_nos, fp_trie);
+    t->raiz = h_trie->pont_raiz;
+}
+
+void trie_memoria_liberar(TrieMemoria *t) {
+    free(t->nos);
+    memset(t, 0, sizeof(TrieMemoria));
+    t->raiz = -1;
+}
+
+// Insere a chave nu_seq apontando para indice_registro (cria os ns que faltarem)
+void trie_memoria_inserir(TrieMemoria *t, const char *nu_seq, int indice_registro) {
+    if (t->raiz == -1) {
+        t->raiz = trie_memoria_novo_no(t);
+    }
+
+    int p_atual = t->raiz;
+    for (int i = 0; nu_seq[i] != '\0'; i++) {
+        int index = char_to_index(nu_seq[i]);
+        if (index == -1) {
+            fprintf(stderr, "Aviso: Caractere invalido no nu_seq: %s\n", nu_seq);
+            return;
+        }
+        if (t->nos[p_atual].filhos[index] == -1) {
+            int novo_pos = trie_memoria_novo_no(t); // Pode realocar o pool: acessar sempre por ndice
+            t->nos[p_atual].filhos[index] = novo_pos;
+        }
+        p_atual = t->nos[p_atual].filhos[index];
+    }
+
+    t->nos[p_atual].is_fim_de_palavra = 1;
+    t->nos[p_atual].indice_registro = indice_registro;
+}
+
+// Grava a Trie inteira de uma vez, em ordem de nvel (BFS): a raiz fica na posio 0 e os nveis
+// de cima ficam contguos no incio do arquivo, que  o trecho lido por toda busca_trie.
+// Escreve em `<nome>.tmp`, que quem chama pe no lugar com trocar_arquivo_tmp; a Trie anterior fica intacta at l.
+int trie_memoria_gravar(TrieMemoria *t, const char *nome, HeaderTrie *h_trie) {
+    char nome_tmp[TAM_CAMINHO];
+    montar_caminho(nome_tmp, sizeof(nome_tmp), "%s.tmp", nome);
+    FILE *fp = fopen(nome_tmp, "wb");
+    if (!fp) {
+        perror("Erro ao criar arquivo temporario da Trie");
+        return 1;
+    }
+
+    HeaderTrie h;
+    h.pont_raiz = (t->raiz == -1) ? -1 : 0;
+    h.qtd_nos = 0;
+    fwrite(&h, tamanho_header_trie(), 1, fp);
+
+    if (t->raiz != -1) {
+        // fila[] guarda os ns na ordem de sada; a posio na fila  o novo ndice do n
+        int *fila = (int *)malloc((size_t)t->qtd_nos * sizeof(int));
+        TrieNode *bloco = (TrieNode *)malloc(NOS_POR_ESCRITA_TRIE * tamanho_trie_node());
+        if (!fila || !bloco) { perror("Erro ao alocar a fila da Trie"); exit(1); }
+
+        int fim_fila = 0;
+        int no_bloco = 0;
+        fila[fim_fila++] = t->raiz;
+        for (int inicio = 0; inicio < fim_fila; inicio++) {
+            TrieNode *n = &bloco[no_bloco++];
+            *n = t->nos[fila[inicio]];
+            for (int i = 0; i < ALPHABET_SIZE; i++) {
+                if (n->filhos[i] != -1) {
+                    int filho = n->filhos[i];
+                    n->filhos[i] = fim_fila;
+                    fila[fim_fila++] = filho;
+                }
+            }
+            if (no_bloco == NOS_POR_ESCRITA_TRIE) {
+                fwrite(bloco, tamanho_trie_node(), no_bloco, fp);
+                no_bloco = 0;
+            }
+        }
+        fwrite(bloco, tamanho_trie_node(), no_bloco, fp);
+        h.qtd_nos = fim_fila;
+
+        free(bloco);
+        free(fila);
+    }
+
+    // Cabealho por ltimo, depois dos ns
+    gravar_cabecalho(fp, &h, tamanho_header_trie());
+    if (fclose(fp) != 0) {
+        perror("Erro ao gravar o arquivo temporario da Trie");
+        return 1;
+    }
+    *h_trie = h;
+    return 0;
+}
+
 /************************************************ FUNES PRINCIPAIS DA HASH TABLE ************************************************/
 
-long tamanho_no_registro() { return sizeof(NoRegistro); }
 long tamanho_header_registro_estado() { return sizeof(HeaderRegistroEstado); }
 
 // Constantes para os estados (para inicializao e hashing)
@@ -306,6 +1025,15 @@ int funcao_hash_estado(const char *estado) {
 
 // --- FUNES DE MANIPULAO DO ARQUIVO INVERTIDO ---
 
+void iniciar_header_registro_estado(HeaderRegistroEstado *h) {
+    memset(h, 0, tamanho_header_registro_estado());
+    for (int i = 0; i < QTD_ESTADOS; i++) {
+        strcpy(h->tabela_hash[i].estado, SIGLAS_ESTADOS[i]);
+        h->tabela_hash[i].inicio = 0;
+        h->tabela_hash[i].qtd = 0; // Vetor vazio
+    }
+}
+
 FILE *abrir_arquivo_registro_estado(const char *nome, HeaderRegistroEstado *h) {
     FILE *fp = fopen(nome, "rb+");
 
@@ -317,11 +1045,7 @@ FILE *abrir_arquivo_registro_estado(const char *nome, HeaderRegistroEstado *h) {
         }
 
         // Inicializa o cabealho
-        h->qtd_nos = 0;
-        for (int i = 0; i < QTD_ESTADOS; i++) {
-            strcpy(h->tabela_hash[i].estado, SIGLAS_ESTADOS[i]);
-            h->tabela_hash[i].pont_lista = -1; // Lista vazia
-        }
+        iniciar_header_registro_estado(h);
 
         fwrite(h, tamanho_header_registro_estado(), 1, fp);
         fflush(fp);
@@ -333,75 +1057,111 @@ FILE *abrir_arquivo_registro_estado(const char *nome, HeaderRegistroEstado *h) {
     return fp;
 }
 
-// Funo principal: Insere um novo ndice de registro na lista encadeada do Estado
-void inserir_indice_no_registro_estado(FILE *fp_reg_est, HeaderRegistroEstado *h_reg_est, const char *estado, int indice_participante) {
-
-    int hash_index = funcao_hash_estado(estado);
-
-    if (hash_index == -1) {
-        fprintf(stderr, "ERRO: Sigla de estado '%s' nao reconhecida e nao inserida no indice invertido.\n", estado);
-        return;
-    }
-
-    // 1. Cria o novo n
-    NoRegistro novo_no;
-    novo_no.indice_registro = indice_participante;
+// L `qtd` ndices do Estado a partir da posio `pos` do seu vetor, com uma nica leitura sequencial.
+// Retorna quantos ndices foram lidos.
+int ler_indices_estado(FILE *fp_reg_est, HeaderRegistroEstado *h_reg_est, int hash_index, int pos, int qtd, int *destino) {
+    EntradaHashEstado *e = &h_reg_est->tabela_hash[hash_index];
+    if (pos < 0 || pos >= e->qtd) return 0;
+    qtd = MIN(qtd, e->qtd - pos);
 
-    // 2. Obtm a posio da cabea da lista atual para o estado
-    int p_lista_atual = h_reg_est->tabela_hash[hash_index].pont_lista;
+    long offset = tamanho_header_registro_estado() + ((long)e->inicio + pos) * (long)sizeof(int);
+    return (int)(pool_ler(fp_reg_est, POOL_ESTADO, offset, destino, (size_t)qtd * sizeof(int)) / sizeof(int));
+}
 
-    // O novo n  inserido SEMPRE no INCIO da lista (O(1))
-    novo_no.prox = p_lista_atual;
+// --- Construo do Arquivo Invertido (usada pelo READ) ---
 
-    // 3. Salva o novo n no FINAL do arquivo (O(1) para escrita em 'append')
-    fseek(fp_reg_est, 0, SEEK_END);
-    fwrite(&novo_no, tamanho_no_registro(), 1, fp_reg_est);
-    int p_novo_no = (ftell(fp_reg_est) / tamanho_no_registro()) - 1;
-    // Posio no arquivo: tamanho_header_registro_estado() + indice_no * tamanho_no_registro()
-    // Calcula o ndice real do novo n
-    int indice_novo_no = h_reg_est->qtd_nos;
-    h_reg_est->qtd_nos++;
+// Os ndices novos de cada Estado so acumulados em memria e o arquivo  regravado
+// uma nica vez no fim, com os vetores antigos seguidos dos novos.
+typedef struct {
+    int *indices;
+    int qtd;
+    int capacidade;
+} VetorIndicesEstado;
 
-    // Reposiciona o novo n no arquivo (offset: header + indice * size)
-    long offset_novo_no = tamanho_header_registro_estado() + indice_novo_no * tamanho_no_registro();
-    fseek(fp_reg_est, offset_novo_no, SEEK_SET);
-    fwrite(&novo_no, tamanho_no_registro(), 1, fp_reg_est);
+typedef struct {
+    VetorIndicesEstado estados[QTD_ESTADOS];
+} RegistrosPorEstado;
 
-    // 4. Atualiza o Cabealho: A cabea da lista agora  o novo n
-    h_reg_est->tabela_hash[hash_index].pont_lista = indice_novo_no;
+#define INDICES_POR_COPIA_ESTADO 65536
 
-    // 5. Salva o Cabealho atualizado
-    fseek(fp_reg_est, 0, SEEK_SET);
-    fwrite(h_reg_est, tamanho_header_registro_estado(), 1, fp_reg_est);
-    fflush(fp_reg_est);
+void registros_estado_inicializar(RegistrosPorEstado *r) {
+    memset(r, 0, sizeof(RegistrosPorEstado));
 }
 
-// Busca e retorna um n da lista encadeada por ndice
-NoRegistro *buscar_no_registro(FILE *fp_reg_est, int indice) {
-    if (indice < 0) return NULL;
+void registros_estado_liberar(RegistrosPorEstado *r) {
+    for (int i = 0; i < QTD_ESTADOS; i++) {
+        free(r->estados[i].indices);
+    }
+    memset(r, 0, sizeof(RegistrosPorEstado));
+}
 
-    NoRegistro *no = (NoRegistro *)malloc(tamanho_no_registro());
-    if (!no) { perror("Erro de alocacao NoRegistro"); return NULL; }
+// Adiciona o participante ao vetor do Estado. Os ndices chegam em ordem crescente
+void registros_estado_adicionar(RegistrosPorEstado *r, const char *estado, int indice_participante) {
+    int hash_index = funcao_hash_estado(estado);
 
-    long offset = tamanho_header_registro_estado() + indice * tamanho_no_registro();
-    if (fseek(fp_reg_est, offset, SEEK_SET) != 0) {
-        free(no);
-        return NULL;
+    if (hash_index == -1) {
+        fprintf(stderr, "ERRO: Sigla de estado '%s' nao reconhecida e nao inserida no indice invertido.\n", estado);
+        return;
     }
 
-    if (fread(no, tamanho_no_registro(), 1, fp_reg_est) != 1) {
-        free(no);
-        return NULL;
+    VetorIndicesEstado *v = &r->estados[hash_index];
+    if (v->qtd == v->capacidade) {
+        v->capacidade = v->capacidade ? v->capacidade * 2 : 1024;
+        v->indices = (int *)realloc(v->indices, (size_t)v->capacidade * sizeof(int));
+        if (!v->indices) { perror("Erro de alocacao do indice por Estado"); exit(1); }
     }
-
-    return no;
+    v->indices[v->qtd++] = indice_participante;
+}
+
+// Regrava o arquivo invertido: para cada Estado, o vetor que j estava em `fp_antigo` e depois os novos.
+// Escreve em `<nome>.tmp`, que quem chama pe no lugar com trocar_arquivo_tmp; o arquivo anterior fica intacto at l.
+int registros_estado_gravar(RegistrosPorEstado *r, FILE *fp_antigo, HeaderRegistroEstado *h_antigo, const char *nome, HeaderRegistroEstado *h_novo) {
+    char nome_tmp[TAM_CAMINHO];
+    montar_caminho(nome_tmp, sizeof(nome_tmp), "%s.tmp", nome);
+    FILE *fp = fopen(nome_tmp, "wb");
+    if (!fp) {
+        perror("Erro ao criar arquivo temporario do indice por Estado");
+        return 1;
+    }
+
+    HeaderRegistroEstado h;
+    iniciar_header_registro_estado(&h);
+    fwrite(&h, tamanho_header_registro_estado(), 1, fp);
+
+    int *bloco = (int *)malloc(INDICES_POR_COPIA_ESTADO * sizeof(int));
+    if (!bloco) { perror("Erro de alocacao do indice por Estado"); exit(1); }
+
+    for (int i = 0; i < QTD_ESTADOS; i++) {
+        h.tabela_hash[i].inicio = h.qtd_nos;
+
+        // Vetor antigo, copiado em blocos
+        int qtd_antiga = h_antigo->tabela_hash[i].qtd;
+        for (int pos = 0; pos < qtd_antiga; pos += INDICES_POR_COPIA_ESTADO) {
+            int lidos = ler_indices_estado(fp_antigo, h_antigo, i, pos, INDICES_POR_COPIA_ESTADO, bloco);
+            fwrite(bloco, sizeof(int), lidos, fp);
+        }
+
+        fwrite(r->estados[i].indices, sizeof(int), r->estados[i].qtd, fp);
+        h.tabela_hash[i].qtd = qtd_antiga + r->estados[i].qtd;
+        h.qtd_nos += h.tabela_hash[i].qtd;
+    }
+    free(bloco);
+
+    // Cabealho por ltimo, depois dos vetores
+    gravar_cabecalho(fp, &h, tamanho_header_registro_estado());
+    if (fclose(fp) != 0) {
+        perror("Erro ao gravar o arquivo temporario do indice por Estado");
+        return 1;
+    }
+    *h_novo = h;
+    return 0;
 }
 
 /************************************************ RVORE B+ ************************************************/
 
 // Entrada de dados no n folha (chave  a nota, valor  o ndice do registro no arquivo binrio)
 typedef struct {
-    float nota; // Chave (key) da B+ Tree: a nota do participante
+    Nota nota; // Chave (key) da B+ Tree: a nota do participante
     int indice_registro; // Ponteiro para o registro completo no "participantes.bin"
 } EntradaIndiceNota;
 
@@ -418,7 +1178,7 @@ typedef struct {
 typedef struct No {
     int ppai; // Posio no arquivo de ndice do n pai
     int m; // Quantidade de chaves (mx ORDEM-1)
-    float s[ORDEM - 1]; // Chaves (keys), agora floats
+    Nota s[ORDEM - 1]; // Chaves (keys): notas
     int p[ORDEM]; // Ponteiros para filhos (posies no arquivo de ndice ou dados)
     int flag_aponta_folha; // 1 se aponta para NoDados, 0 se aponta para No
 } No;
@@ -431,15 +1191,8 @@ typedef struct {
     int pont_ultima_folha; // Posio da ltima folha
 } Metadados;
 
-// Estrutura de Informao de Busca
-typedef struct Info {
-    int p_f_indice; // Posio do n no arquivo de ndice (pai)
-    int p_f_dados; // Posio do n de dados (folha)
-    int pos_vetor_dados; // Posio que a chave est ou deveria estar no vetor de dados
-    int encontrou; // 1 se achou uma entrada com a mesma chave (para B+ simples, isso  raro/opcional), ou 0 se achou o local de insero
-} Info;
-
-long tamanho_participante() { return sizeof(Participante); }
+long tamanho_participante() { return sizeof(RegistroCompacto); }
+long tamanho_respostas() { return sizeof(RespostasCompactas); }
 long tamanho_header() { return sizeof(HeaderParticipantes); }
 long tamanho_localizacao() { return sizeof(Localizacao); }
 long tamanho_header_localizacao() { return sizeof(HeaderLocalizacao); }
@@ -449,10 +1202,8 @@ long tamanho_no() { return sizeof(No); }
 long tamanho_no_dados() { return sizeof(NoDados); }
 long tamanho_metadados() { return sizeof(Metadados); }
 
-// Cria um n de ndice (No) vazio
-No *cria_no() {
-    No *n = (No *)malloc(tamanho_no());
-    if (!n) { perror("Erro ao alocar No"); exit(1); }
+// Deixa o n de ndice vazio
+void iniciar_no(No *n) {
     n->ppai = -1;
     n->m = 0;
     n->flag_aponta_folha = 0;
@@ -461,13 +1212,10 @@ No *cria_no() {
         n->p[i] = -1;
     }
     n->p[ORDEM - 1] = -1;
-    return n;
 }
 
-// Cria um n de dados (NoDados) vazio
-NoDados *cria_no_dados() {
-    NoDados *nd = (NoDados *)malloc(tamanho_no_dados());
-    if (!nd) { perror("Erro ao alocar NoDados"); exit(1); }
+// Deixa o n de dados vazio
+void iniciar_no_dados(NoDados *nd) {
     nd->ppai = -1;
     nd->m = 0;
     nd->prox = -1;
@@ -476,483 +1224,1022 @@ NoDados *cria_no_dados() {
         nd->s[i].nota = -1.0;
         nd->s[i].indice_registro = -1;
     }
-    return nd;
 }
 
-// Leitura/Escrita genrica de structs
-Metadados *le_metadados(FILE *f) {
-    Metadados *md = (Metadados *)malloc(tamanho_metadados());
-    if (fseek(f, 0, SEEK_SET) != 0) return NULL;
-    if (fread(md, tamanho_metadados(), 1, f) != 1) { free(md); return NULL; }
-    return md;
+// Leitura/Escrita genrica de structs.
+// As leituras usam um buffer do chamador e retornam o prprio buffer (NULL se a leitura falhar).
+Metadados *le_metadados_em(FILE *f, Metadados *destino) {
+    if (pool_ler(f, POOL_BMAIS, 0, destino, tamanho_metadados()) != (size_t)tamanho_metadados()) return NULL;
+    return destino;
 }
 
 void salva_metadados(Metadados *md, FILE *f) {
-    fseek(f, 0, SEEK_SET);
-    fwrite(md, tamanho_metadados(), 1, f);
-    fflush(f);
+    pool_escrever(f, POOL_BMAIS, 0, md, tamanho_metadados());
 }
 
-No *buscar_no(int pos, FILE *f) {
+No *buscar_no_em(int pos, FILE *f, No *destino) {
     if (pos == -1) return NULL;
-    No *n = cria_no();
-    if (fseek(f, tamanho_no() * pos, SEEK_SET) != 0) { free(n); return NULL; }
-    if (fread(n, tamanho_no(), 1, f) != 1) { free(n); return NULL; }
-    return n;
+    if (pool_ler(f, POOL_BMAIS, tamanho_no() * pos, destino, tamanho_no()) != (size_t)tamanho_no()) return NULL;
+    return destino;
 }
 
 void salva_no(No *n, FILE *f, int pos) {
-    if (pos == -1) {
-        fseek(f, 0, SEEK_END);
-    } else {
-        fseek(f, tamanho_no() * pos, SEEK_SET);
-    }
-    fwrite(n, tamanho_no(), 1, f);
-    fflush(f);
+    long offset = (pos == -1) ? pool_fim_arquivo(f) : tamanho_no() * pos;
+    pool_escrever(f, POOL_BMAIS, offset, n, tamanho_no());
 }
 
-NoDados *buscar_no_dados(int pos, FILE *f) {
+NoDados *buscar_no_dados_em(int pos, FILE *f, NoDados *destino) {
     if (pos == -1) return NULL;
-    NoDados *nd = cria_no_dados();
-    if (fseek(f, tamanho_no_dados() * pos, SEEK_SET) != 0) { free(nd); return NULL; }
-    if (fread(nd, tamanho_no_dados(), 1, f) != 1) { free(nd); return NULL; }
-    return nd;
+    if (pool_ler(f, POOL_BMAIS, tamanho_no_dados() * pos, destino, tamanho_no_dados()) != (size_t)tamanho_no_dados()) return NULL;
+    return destino;
 }
 
 void salva_no_dados(NoDados *nd, FILE *f, int pos) {
-    if (pos == -1) {
-        fseek(f, 0, SEEK_END);
-    } else {
-        fseek(f, tamanho_no_dados() * pos, SEEK_SET);
-    }
-    fwrite(nd, tamanho_no_dados(), 1, f);
-    fflush(f);
+    long offset = (pos == -1) ? pool_fim_arquivo(f) : tamanho_no_dados() * pos;
+    pool_escrever(f, POOL_BMAIS, offset, nd, tamanho_no_dados());
 }
 
-// Funo para iniciar o arquivo de metadados
+// Funo para iniciar o arquivo de metadados. Vai direto ao disco: um arquivo de metadados vazio
+// (READ morto antes de o pool grav-lo) no  uma rvore vazia, e sim uma rvore ilegvel
 void iniciar_arquivo_metadados(FILE *f) {
     Metadados md = { .pont_raiz = -1, .flag_raiz_folha = 1, .pont_primeira_folha = -1, .pont_ultima_folha = -1 };
     salva_metadados(&md, f);
+    sincronizar_arquivo_pool(f);
 }
 
-// Atualiza o ponteiro raiz no metadados
-void atualiza_arquivo_metadados(FILE *f_metadados, int nova_raiz_pos, int is_folha) {
-    Metadados *md = le_metadados(f_metadados);
-    md->pont_raiz = nova_raiz_pos;
-    md->flag_raiz_folha = is_folha;
-    salva_metadados(md, f_metadados);
-    free(md);
-}
+/************************************************ ORDENAO EXTERNA ************************************************/
 
-// Insere uma chave e ponteiros em um n de ndice (mantendo a ordenao)
-void inserir_chave_em_no(No *no, float chave, int p_esq, int p_dir) {
-    int i = no->m - 1;
-    while (i >= 0 && no->s[i] > chave) {
-        no->s[i + 1] = no->s[i];
-        no->p[i + 2] = no->p[i + 1]; // Desloca ponteiro a direita
-        i--;
-    }
-    no->s[i + 1] = chave;
+// Ordenao com memria limitada: os elementos so acumulados em um buffer de at memoria_max bytes;
+// quando o buffer enche ele  ordenado e despejado em um arquivo temporrio (run). No final as runs
+// so intercaladas (k-way merge) em quantas passadas forem necessrias at sobrarem no mximo
+// 'grau_merge' runs, e a ltima intercalao  lida em fluxo por ordext_proximo, sem gerar outro arquivo.
+// Serve para qualquer tipo de elemento de tamanho fixo (mesmo contrato do qsort).
 
-    // Ajusta o ponteiro esquerdo/anterior
-    if (p_esq != -1) {
-        no->p[i + 1] = p_esq;
-    }
-    // Ajusta o ponteiro direito/posterior
-    no->p[i + 2] = p_dir;
+#define TAM_BLOCO_ORDENACAO (256 * 1024) // Buffer de leitura/escrita de cada run durante o merge
+#define MAX_GRAU_MERGE 256
 
-    no->m++;
-}
+long MEMORIA_ORDENACAO_MB = 256; // Limite de memria de toda a ordenao da importao (CONFIG MEMORIA)
 
-// Insere uma entrada em um n de dados (mantendo a ordenao)
-NoDados *inserir_entrada_em_no_dado(NoDados *nd, EntradaIndiceNota entrada) {
-    int i = nd->m - 1;
-    while (i >= 0 && nd->s[i].nota > entrada.nota) {
-        nd->s[i + 1] = nd->s[i];
-        i--;
-    }
-    nd->s[i + 1] = entrada;
-    nd->m++;
-    return nd;
-}
+typedef struct {
+    FILE *f;
+    char *atual; // Elemento corrente desta run (vlido se ativa == 1)
+    int ativa;
+} RunOrdenacao;
 
-// Atualiza o ppai de um n de dados (folha)
-void atualiza_pai_de_no_dado(FILE *f_dados, int p_f_dados, int ppai) {
-    NoDados *nd = buscar_no_dados(p_f_dados, f_dados);
-    if (!nd) return;
-    nd->ppai = ppai;
-    salva_no_dados(nd, f_dados, p_f_dados);
-    free(nd);
+typedef struct {
+    char prefixo[TAM_CAMINHO]; // Caminho das runs, sem o "_<id>.tmp"
+    size_t tam_elemento;
+    int (*compara)(const void *, const void *);
+    size_t memoria_max;
+
+    // Gerao das runs
+    char *buffer;
+    long qtd_buffer;
+    long capacidade_buffer;
+    long total_elementos;
+
+    // Runs despejadas em disco (ids dos arquivos temporrios)
+    int *runs;
+    int qtd_runs;
+    int capacidade_runs;
+    int proximo_id_run;
+    int qtd_runs_geradas;
+    int passes_merge;
+
+    // Leitura do resultado
+    int em_memoria;      // 1 se nunca despejou: o resultado  o prprio buffer ordenado
+    long pos_leitura;
+    RunOrdenacao *leitura;
+    int qtd_leitura;
+    int *heap;           // ndices de 'leitura', heap de mnimo pelo elemento atual
+    int tam_heap;
+} OrdenacaoExterna;
+
+void nome_run_ordenacao(OrdenacaoExterna *o, int id, char *nome) {
+    montar_caminho(nome, TAM_CAMINHO, "%s_%d.tmp", o->prefixo, id);
 }
 
-// Atualiza o ppai de um n de ndice
-void atualiza_pai_de_no(FILE *f_indice, int p_f_indice, int ppai) {
-    No *no = buscar_no(p_f_indice, f_indice);
-    if (!no) return;
-    no->ppai = ppai;
-    salva_no(no, f_indice, p_f_indice);
-    free(no);
+void ordext_inicializar(OrdenacaoExterna *o, const char *prefixo, size_t tam_elemento, int (*compara)(const void *, const void *), size_t memoria_max) {
+    memset(o, 0, sizeof(OrdenacaoExterna));
+    montar_caminho(o->prefixo, sizeof(o->prefixo), "%s", prefixo);
+    o->tam_elemento = tam_elemento;
+    o->compara = compara;
+    o->memoria_max = MAX(memoria_max, 2 * TAM_BLOCO_ORDENACAO);
 }
 
-// retorna informaes sobre a busca (posio da folha onde deve estar ou ser inserido)
-Info *busca(float x, FILE *f_metadados, FILE *f_indice, FILE *f_dados) {
+// Ordena o buffer atual e grava como uma nova run
+void ordext_despejar_buffer(OrdenacaoExterna *o) {
+    if (o->qtd_buffer == 0) return;
 
-    Info *info = (Info *)malloc(sizeof(Info));
-    info->p_f_indice = -1;
-    info->p_f_dados = -1;
-    info->pos_vetor_dados = -1;
-    info->encontrou = 0;
+    qsort(o->buffer, o->qtd_buffer, o->tam_elemento, o->compara);
 
-    Metadados *md = le_metadados(f_metadados);
-    int p_atual;
+    char nome[TAM_CAMINHO];
+    int id = o->proximo_id_run++;
+    nome_run_ordenacao(o, id, nome);
+    FILE *f = fopen(nome, "wb");
+    if (!f) { perror("Erro ao criar run da ordenacao externa"); exit(1); }
+    if (fwrite(o->buffer, o->tam_elemento, o->qtd_buffer, f) != (size_t)o->qtd_buffer) {
+        perror("Erro ao gravar run da ordenacao externa");
+        exit(1);
+    }
+    fclose(f);
 
-    if (md->pont_raiz == -1) {
-        free(md);
-        return info; // rvore vazia
+    if (o->qtd_runs == o->capacidade_runs) {
+        o->capacidade_runs = o->capacidade_runs ? o->capacidade_runs * 2 : 16;
+        o->runs = (int *)realloc(o->runs, o->capacidade_runs * sizeof(int));
+        if (!o->runs) { perror("Erro ao alocar runs"); exit(1); }
     }
+    o->runs[o->qtd_runs++] = id;
+    o->qtd_runs_geradas++;
+    o->qtd_buffer = 0;
+}
 
-    if (md->flag_raiz_folha == 1) {
-        p_atual = md->pont_raiz;
-        info->p_f_dados = p_atual;
-        info->p_f_indice = -1;
-        free(md);
-    } else {
-        p_atual = md->pont_raiz;
-        info->p_f_indice = p_atual;
-        free(md);
+void ordext_adicionar(OrdenacaoExterna *o, const void *elemento) {
+    if (o->buffer == NULL) {
+        // O buffer cresce sob demanda at o limite, para importaes pequenas no reservarem tudo
+        o->capacidade_buffer = MIN((long)(o->memoria_max / o->tam_elemento), 4096L);
+        o->buffer = (char *)malloc(o->capacidade_buffer * o->tam_elemento);
+        if (!o->buffer) { perror("Erro ao alocar buffer da ordenacao"); exit(1); }
+    }
+    if (o->qtd_buffer == o->capacidade_buffer) {
+        long limite = o->memoria_max / o->tam_elemento;
+        if (o->capacidade_buffer < limite) {
+            long nova = MIN(o->capacidade_buffer * 2, limite);
+            char *novo = (char *)realloc(o->buffer, nova * o->tam_elemento);
+            if (!novo) { perror("Erro ao alocar buffer da ordenacao"); exit(1); }
+            o->buffer = novo;
+            o->capacidade_buffer = nova;
+        } else {
+            ordext_despejar_buffer(o);
+        }
+    }
+    memcpy(o->buffer + o->qtd_buffer * o->tam_elemento, elemento, o->tam_elemento);
+    o->qtd_buffer++;
+    o->total_elementos++;
+}
 
-        while (p_atual != -1) {
-            No *pag = buscar_no(p_atual, f_indice);
-            if (!pag) { p_atual = -1; break; }
+// --- Heap de mnimo das runs abertas ---
 
-            info->p_f_indice = p_atual;
+// Em caso de empate vence a run mais antiga, o que mantm a ordenao estvel
+int ordext_menor(OrdenacaoExterna *o, int a, int b) {
+    int c = o->compara(o->leitura[a].atual, o->leitura[b].atual);
+    return c < 0 || (c == 0 && a < b);
+}
 
-            int proximo_p = -1;
-            int i;
-            for (i = 0; i < pag->m; i++) {
-                if (x < pag->s[i]) {
-                    proximo_p = pag->p[i];
-                    break;
-                }
-            }
-            if (proximo_p == -1) {
-                proximo_p = pag->p[pag->m];
-            }
+void ordext_desce_heap(OrdenacaoExterna *o, int i) {
+    while (1) {
+        int menor = i, esq = 2 * i + 1, dir = 2 * i + 2;
+        if (esq < o->tam_heap && ordext_menor(o, o->heap[esq], o->heap[menor])) menor = esq;
+        if (dir < o->tam_heap && ordext_menor(o, o->heap[dir], o->heap[menor])) menor = dir;
+        if (menor == i) return;
+        int tmp = o->heap[i]; o->heap[i] = o->heap[menor]; o->heap[menor] = tmp;
+        i = menor;
+    }
+}
 
-            if (pag->flag_aponta_folha) {
-                info->p_f_dados = proximo_p;
-                free(pag);
-                break;
-            }
+// Abre as runs [inicio, inicio + qtd) da lista para intercalao
+void ordext_abrir_merge(OrdenacaoExterna *o, int inicio, int qtd, size_t tam_bloco) {
+    o->leitura = (RunOrdenacao *)malloc(qtd * sizeof(RunOrdenacao));
+    o->heap = (int *)malloc(qtd * sizeof(int));
+    if (!o->leitura || !o->heap) { perror("Erro ao alocar merge"); exit(1); }
+    o->qtd_leitura = qtd;
+    o->tam_heap = 0;
+
+    for (int i = 0; i < qtd; i++) {
+        char nome[TAM_CAMINHO];
+        nome_run_ordenacao(o, o->runs[inicio + i], nome);
+        RunOrdenacao *r = &o->leitura[i];
+        r->f = fopen(nome, "rb");
+        if (!r->f) { perror("Erro ao abrir run da ordenacao externa"); exit(1); }
+        setvbuf(r->f, NULL, _IOFBF, tam_bloco);
+        r->atual = (char *)malloc(o->tam_elemento);
+        r->ativa = (fread(r->atual, o->tam_elemento, 1, r->f) == 1);
+        if (r->ativa) o->heap[o->tam_heap++] = i;
+    }
+    for (int i = o->tam_heap / 2 - 1; i >= 0; i--) {
+        ordext_desce_heap(o, i);
+    }
+}
 
-            p_atual = proximo_p;
-            free(pag);
-        }
+// Retira o menor elemento das runs abertas. Retorna 0 quando todas acabaram.
+int ordext_proximo_merge(OrdenacaoExterna *o, void *destino) {
+    if (o->tam_heap == 0) return 0;
+    RunOrdenacao *r = &o->leitura[o->heap[0]];
+    memcpy(destino, r->atual, o->tam_elemento);
+    if (fread(r->atual, o->tam_elemento, 1, r->f) != 1) {
+        r->ativa = 0;
+        o->heap[0] = o->heap[--o->tam_heap];
     }
+    ordext_desce_heap(o, 0);
+    return 1;
+}
+
+// Fecha e apaga as runs abertas
+void ordext_fechar_merge(OrdenacaoExterna *o, int inicio) {
+    for (int i = 0; i < o->qtd_leitura; i++) {
+        char nome[TAM_CAMINHO];
+        nome_run_ordenacao(o, o->runs[inicio + i], nome);
+        fclose(o->leitura[i].f);
+        free(o->leitura[i].atual);
+        remove(nome);
+    }
+    free(o->leitura);
+    free(o->heap);
+    o->leitura = NULL;
+    o->heap = NULL;
+    o->qtd_leitura = 0;
+    o->tam_heap = 0;
+}
 
-    // Busca no n de dados (folha)
-    if (info->p_f_dados != -1) {
-        NoDados *pag_dados = buscar_no_dados(info->p_f_dados, f_dados);
-        if (!pag_dados) return info;
+// Encerra a fase de insero e deixa o resultado pronto para ordext_proximo
+void ordext_finalizar(OrdenacaoExterna *o) {
+    if (o->qtd_runs == 0) {
+        // Coube tudo na memria: nenhum arquivo temporrio
+        o->em_memoria = 1;
+        if (o->qtd_buffer > 0) qsort(o->buffer, o->qtd_buffer, o->tam_elemento, o->compara);
+        o->pos_leitura = 0;
+        return;
+    }
 
-        int i;
-        for (i = 0; i < pag_dados->m; i++) {
-            if (fabsf(pag_dados->s[i].nota - x) < 0.0001f) {
-                info->encontrou = 1;
-                info->pos_vetor_dados = i;
-                free(pag_dados);
-                return info;
-            } else if (pag_dados->s[i].nota > x) {
-                info->pos_vetor_dados = i;
-                info->encontrou = 0;
-                free(pag_dados);
-                return info;
+    ordext_despejar_buffer(o);
+    free(o->buffer);
+    o->buffer = NULL;
+
+    // Cada run aberta usa um bloco de leitura; o grau do merge  o que cabe no limite de memria
+    int grau = (int)(o->memoria_max / TAM_BLOCO_ORDENACAO) - 1;
+    grau = MAX(2, MIN(grau, MAX_GRAU_MERGE));
+
+    // Passadas intermedirias: intercala grupos de 'grau' runs em runs maiores
+    char *elemento = (char *)malloc(o->tam_elemento);
+    while (o->qtd_runs > grau) {
+        int *novas = (int *)malloc(((o->qtd_runs + grau - 1) / grau) * sizeof(int));
+        int qtd_novas = 0;
+        for (int inicio = 0; inicio < o->qtd_runs; inicio += grau) {
+            int qtd = MIN(grau, o->qtd_runs - inicio);
+            if (qtd == 1) {
+                novas[qtd_novas++] = o->runs[inicio];
+                continue;
+            }
+            char nome[TAM_CAMINHO];
+            int id = o->proximo_id_run++;
+            nome_run_ordenacao(o, id, nome);
+            FILE *saida = fopen(nome, "wb");
+            if (!saida) { perror("Erro ao criar run da ordenacao externa"); exit(1); }
+            setvbuf(saida, NULL, _IOFBF, TAM_BLOCO_ORDENACAO);
+
+            ordext_abrir_merge(o, inicio, qtd, TAM_BLOCO_ORDENACAO);
+            while (ordext_proximo_merge(o, elemento)) {
+                fwrite(elemento, o->tam_elemento, 1, saida);
             }
+            ordext_fechar_merge(o, inicio);
+            fclose(saida);
+            novas[qtd_novas++] = id;
         }
-        info->pos_vetor_dados = pag_dados->m;
-        info->encontrou = 0;
-        free(pag_dados);
-        return info;
+        free(o->runs);
+        o->runs = novas;
+        o->qtd_runs = qtd_novas;
+        o->capacidade_runs = qtd_novas;
+        o->passes_merge++;
     }
+    free(elemento);
 
-    return info;
+    // Passada final: fica aberta e  consumida em fluxo
+    ordext_abrir_merge(o, 0, o->qtd_runs, TAM_BLOCO_ORDENACAO);
+    o->passes_merge++;
 }
 
-// Insere chave no arquivo de ndice e d um pai para os ns esquerdo e direito (Propagao de Split)
-void inserir_em_arquivo_de_indice(float chave, int p_pai_original, int flag_aponta_folha, int p_filho_esq, int p_filho_dir, FILE *f_metadados, FILE *f_indice, FILE *f_dados) {
+// Copia o prximo elemento em ordem para 'destino'. Retorna 0 no fim.
+int ordext_proximo(OrdenacaoExterna *o, void *destino) {
+    if (o->em_memoria) {
+        if (o->pos_leitura >= o->qtd_buffer) return 0;
+        memcpy(destino, o->buffer + o->pos_leitura * o->tam_elemento, o->tam_elemento);
+        o->pos_leitura++;
+        return 1;
+    }
+    return ordext_proximo_merge(o, destino);
+}
 
-    Metadados *md = le_metadados(f_metadados);
+// Libera a memria e apaga os arquivos temporrios que ainda existirem
+void ordext_liberar(OrdenacaoExterna *o) {
+    if (o->leitura) {
+        ordext_fechar_merge(o, 0); // J apaga as runs da passada final
+        o->qtd_runs = 0;
+    }
+    for (int i = 0; i < o->qtd_runs; i++) {
+        char nome[TAM_CAMINHO];
+        nome_run_ordenacao(o, o->runs[i], nome);
+        remove(nome);
+    }
+    free(o->buffer);
+    free(o->runs);
+    o->buffer = NULL;
+    o->runs = NULL;
+    o->qtd_runs = 0;
+}
 
-    if (p_pai_original == -1) { // Criao de uma nova raiz (apenas se for o primeiro split)
-        No *nova_raiz = cria_no();
-        inserir_chave_em_no(nova_raiz, chave, p_filho_esq, p_filho_dir);
-        nova_raiz->flag_aponta_folha = flag_aponta_folha;
+/************************************************ CARGA EM LOTE DA RVORE B+ ************************************************/
 
-        salva_no(nova_raiz, f_indice, -1);
-        int nova_raiz_pos = (ftell(f_indice) / tamanho_no()) - 1;
+// Ordena por nota e, em caso de empate, pelo ndice do registro (mesma ordem que a insero um a um produziria)
+int compara_entrada_nota(const void *a, const void *b) {
+    const EntradaIndiceNota *ea = (const EntradaIndiceNota *)a;
+    const EntradaIndiceNota *eb = (const EntradaIndiceNota *)b;
+    if (ea->nota < eb->nota) return -1;
+    if (ea->nota > eb->nota) return 1;
+    return (ea->indice_registro > eb->indice_registro) - (ea->indice_registro < eb->indice_registro);
+}
 
-        atualiza_arquivo_metadados(f_metadados, nova_raiz_pos, 0);
+// Retorna 1 se a rvore ainda no tem raiz
+int arvore_bmais_vazia(FILE *f_metadados) {
+    Metadados md;
+    return !le_metadados_em(f_metadados, &md) || md.pont_raiz == -1;
+}
 
-        // Atualiza os pais dos filhos
-        if (flag_aponta_folha) {
-            atualiza_pai_de_no_dado(f_dados, p_filho_esq, nova_raiz_pos);
-            atualiza_pai_de_no_dado(f_dados, p_filho_dir, nova_raiz_pos);
-        } else {
-            atualiza_pai_de_no(f_indice, p_filho_esq, nova_raiz_pos);
-            atualiza_pai_de_no(f_indice, p_filho_dir, nova_raiz_pos);
-        }
+// Fonte de entradas j ordenadas para a construo em lote
+typedef struct {
+    long total; // Quantas entradas a fonte vai fornecer
+    int (*proximo)(void *estado, EntradaIndiceNota *destino); // Retorna 0 quando acabar
+    void *estado;
+} FonteEntradasNota;
 
-        free(nova_raiz);
-        free(md);
-        return;
-    }
+int fonte_ordenacao_proximo(void *estado, EntradaIndiceNota *destino) {
+    return ordext_proximo((OrdenacaoExterna *)estado, destino);
+}
 
-    // N pai existe e pode ter espao
-    No *no_pai = buscar_no(p_pai_original, f_indice);
+// Fonte que l uma OrdenacaoExterna j finalizada
+FonteEntradasNota fonte_de_ordenacao(OrdenacaoExterna *ord) {
+    FonteEntradasNota f = { .total = ord->total_elementos, .proximo = fonte_ordenacao_proximo, .estado = ord };
+    return f;
+}
 
-    if (no_pai->m < ORDEM - 1) { // O n tem espao
-        inserir_chave_em_no(no_pai, chave, p_filho_esq, p_filho_dir);
-        salva_no(no_pai, f_indice, p_pai_original);
+// Percorre as folhas de uma rvore existente pela lista encadeada: da primeira  ltima (prox)
+// ou, decrescente, da ltima  primeira (ant)
+typedef struct {
+    FILE *f_dados;
+    NoDados nd;
+    int pos_folha;   // -1 quando acabaram as folhas
+    int i;           // Entradas da folha atual j entregues
+    int decrescente;
+} LeitorFolhasBmais;
+
+void leitor_folhas_iniciar(LeitorFolhasBmais *l, FILE *f_metadados, FILE *f_dados, int decrescente) {
+    Metadados md;
+    l->f_dados = f_dados;
+    l->decrescente = decrescente;
+    l->pos_folha = -1;
+    if (le_metadados_em(f_metadados, &md)) l->pos_folha = decrescente ? md.pont_ultima_folha : md.pont_primeira_folha;
+    l->i = 0;
+    l->nd.m = 0;
+    if (l->pos_folha != -1 && !buscar_no_dados_em(l->pos_folha, f_dados, &l->nd)) l->pos_folha = -1;
+}
 
-        // Atualizao do pai do novo filho direito
-        if (no_pai->flag_aponta_folha) {
-            atualiza_pai_de_no_dado(f_dados, p_filho_dir, p_pai_original);
-        } else {
-            atualiza_pai_de_no(f_indice, p_filho_dir, p_pai_original);
-        }
+int leitor_folhas_proximo(void *estado, EntradaIndiceNota *destino) {
+    LeitorFolhasBmais *l = (LeitorFolhasBmais *)estado;
+    while (l->pos_folha != -1 && l->i >= l->nd.m) {
+        l->pos_folha = l->decrescente ? l->nd.ant : l->nd.prox;
+        l->i = 0;
+        if (l->pos_folha == -1) break;
+        if (!buscar_no_dados_em(l->pos_folha, l->f_dados, &l->nd)) l->pos_folha = -1;
+    }
+    if (l->pos_folha == -1) return 0;
+    *destino = l->nd.s[l->decrescente ? l->nd.m - 1 - l->i : l->i];
+    l->i++;
+    return 1;
+}
 
-        free(no_pai);
-        free(md);
-        return;
+// Intercala duas fontes ordenadas; em empate a fonte `a` (as entradas antigas) vem primeiro
+typedef struct {
+    FonteEntradasNota *a;
+    FonteEntradasNota *b;
+    EntradaIndiceNota prox_a;
+    EntradaIndiceNota prox_b;
+    int tem_a;
+    int tem_b;
+    int decrescente; // As duas fontes vm do fim para o incio
+} MesclaEntradasNota;
+
+int mescla_proximo(void *estado, EntradaIndiceNota *destino) {
+    MesclaEntradasNota *m = (MesclaEntradasNota *)estado;
+    int c = m->tem_a && m->tem_b ? compara_entrada_nota(&m->prox_a, &m->prox_b) : 0;
+    if (m->decrescente) c = -c;
+    if (m->tem_a && (!m->tem_b || c <= 0)) {
+        *destino = m->prox_a;
+        m->tem_a = m->a->proximo(m->a->estado, &m->prox_a);
+        return 1;
+    }
+    if (m->tem_b) {
+        *destino = m->prox_b;
+        m->tem_b = m->b->proximo(m->b->estado, &m->prox_b);
+        return 1;
+    }
+    return 0;
+}
 
-    } else { // N de ndice cheio (ORDEM - 1 chaves) -> Split
+FonteEntradasNota fonte_de_mescla(MesclaEntradasNota *m, FonteEntradasNota *a, FonteEntradasNota *b) {
+    m->a = a;
+    m->b = b;
+    m->decrescente = 0;
+    m->tem_a = a->proximo(a->estado, &m->prox_a);
+    m->tem_b = b->proximo(b->estado, &m->prox_b);
+    FonteEntradasNota f = { .total = a->total + b->total, .proximo = mescla_proximo, .estado = m };
+    return f;
+}
 
-        // 1. Cria arrays auxiliares para ORDEM chaves e ORDEM+1 ponteiros
-        float chaves_aux[ORDEM];
-        int ponteiros_aux[ORDEM + 1];
+// Divide os ns de um nvel em grupos de at ORDEM filhos (um n pai por grupo).
+// inicio_grupo recebe qtd_grupos + 1 posies. O ltimo grupo nunca fica com um filho s
+// (seria um n de ndice sem nenhuma chave), ento ele pega um filho emprestado do penltimo.
+int calcula_grupos_nivel(int qtd_filhos, int *inicio_grupo) {
+    int qtd_grupos = (qtd_filhos + ORDEM - 1) / ORDEM;
+    for (int g = 0; g < qtd_grupos; g++) {
+        inicio_grupo[g] = g * ORDEM;
+    }
+    inicio_grupo[qtd_grupos] = qtd_filhos;
+    if (qtd_grupos > 1 && qtd_filhos - inicio_grupo[qtd_grupos - 1] == 1) {
+        inicio_grupo[qtd_grupos - 1]--;
+    }
+    return qtd_grupos;
+}
 
-        for(int i = 0; i < ORDEM - 1; i++){
-            chaves_aux[i] = no_pai->s[i];
-            ponteiros_aux[i] = no_pai->p[i];
+// Constri a rvore B+ de baixo para cima a partir de todas as entradas de uma vez.
+// As folhas so gravadas sequencialmente e totalmente cheias (ORDEM - 1 entradas, exceto a ltima),
+// depois os nveis de ndice so montados em memria e gravados no fim.
+// As entradas vm j ordenadas (compara_entrada_nota) da fonte: uma OrdenacaoExterna finalizada
+// ou a intercalao dela com as folhas de uma rvore existente. Os arquivos de destino precisam estar vazios.
+// Os ns de ndice de cada nvel ficam contguos numa arena e vo ao disco num nico fwrite.
+void construir_bmais_em_lote(FonteEntradasNota *fonte, FILE *f_metadados, FILE *f_indice, FILE *f_dados) {
+    long qtd = fonte->total;
+    if (qtd == 0) return;
+
+    int qtd_folhas = (int)((qtd + ORDEM - 2) / (ORDEM - 1));
+
+    // 1. Os pais das folhas so os primeiros ns do arquivo de ndice (posies 0, 1, 2...),
+    //    ento o ppai de cada folha j  conhecido antes de grav-la.
+    int *inicio_grupo = (int *)malloc((qtd_folhas / ORDEM + 2) * sizeof(int));
+    int qtd_pais_folhas = (qtd_folhas > 1) ? calcula_grupos_nivel(qtd_folhas, inicio_grupo) : 0;
+
+    // 2. Grava as folhas em sequncia, guardando a primeira chave de cada uma
+    Nota *chaves_filhos = (Nota *)malloc(qtd_folhas * sizeof(Nota));
+    int *pos_filhos = (int *)malloc(qtd_folhas * sizeof(int));
+    NoDados folha;
+    NoDados *nd = &folha;
+    iniciar_no_dados(nd);
+    long proxima = 0;
+    int grupo = 0;
+
+    fseek(f_dados, 0, SEEK_SET);
+    for (int f = 0; f < qtd_folhas; f++) {
+        nd->m = 0;
+        while (nd->m < ORDEM - 1 && proxima < qtd && fonte->proximo(fonte->estado, &nd->s[nd->m])) {
+            nd->m++;
+            proxima++;
         }
-        ponteiros_aux[ORDEM - 1] = no_pai->p[ORDEM - 1];
-
-        // 2. Insere a nova chave e ponteiro (p_filho_dir) no local correto, deslocando os demais
-        int i = ORDEM - 2;
-        while (i >= 0 && chaves_aux[i] > chave) {
-            chaves_aux[i + 1] = chaves_aux[i];
-            ponteiros_aux[i + 2] = ponteiros_aux[i + 1];
-            i--;
+        for (int i = nd->m; i < ORDEM - 1; i++) {
+            nd->s[i].nota = -1.0;
+            nd->s[i].indice_registro = -1;
         }
-        chaves_aux[i + 1] = chave;
-        ponteiros_aux[i + 2] = p_filho_dir;
 
-        int j = i + 1;
-        while(j > 0 && ponteiros_aux[j] != p_filho_esq){
-            j--;
-        }
-        if(ponteiros_aux[j] != p_filho_esq){
-            ponteiros_aux[0] = p_filho_esq;
+        if (qtd_pais_folhas > 0) {
+            while (f >= inicio_grupo[grupo + 1]) grupo++;
+            nd->ppai = grupo;
         } else {
-            ponteiros_aux[j] = p_filho_esq;
+            nd->ppai = -1;
         }
+        nd->ant = f - 1;
+        nd->prox = (f + 1 < qtd_folhas) ? f + 1 : -1;
 
-
-        // 3. Define ndices e chave para subir
-        int chaves_por_no = (ORDEM - 1) / 2;
-        int indice_chave_subir = chaves_por_no;
-        float chave_subir = chaves_aux[indice_chave_subir];
-        int indice_n2_inicio = indice_chave_subir + 1;
-        int p_pai_do_pai = no_pai->ppai;
-
-        // 4. Cria os novos ns (n1 e n2)
-        No *n1 = cria_no(); n1->ppai = p_pai_do_pai; n1->flag_aponta_folha = no_pai->flag_aponta_folha;
-        No *n2 = cria_no(); n2->ppai = p_pai_do_pai; n2->flag_aponta_folha = no_pai->flag_aponta_folha;
-
-        // 5. Preenche n1 (n esquerdo)
-        n1->m = chaves_por_no;
-        for (int j = 0; j < n1->m; j++) {
-            n1->s[j] = chaves_aux[j];
-            n1->p[j] = ponteiros_aux[j];
+        fwrite(nd, tamanho_no_dados(), 1, f_dados);
+        chaves_filhos[f] = nd->s[0].nota;
+        pos_filhos[f] = f;
+    }
+    fflush(f_dados);
+
+    Metadados md = { .pont_raiz = 0, .flag_raiz_folha = 1, .pont_primeira_folha = 0, .pont_ultima_folha = qtd_folhas - 1 };
+
+    // 3. Monta os nveis de ndice, do mais baixo at a raiz
+    int qtd_filhos = qtd_folhas;
+    int filhos_sao_folhas = 1;
+    int proxima_pos_indice = 0;
+    Arena arena;
+    arena_inicializar(&arena, TAM_BLOCO_ARENA);
+    No *nos_nivel_anterior = NULL;
+
+    while (qtd_filhos > 1) {
+        int qtd_grupos = calcula_grupos_nivel(qtd_filhos, inicio_grupo);
+        No *nos_nivel = (No *)arena_alocar(&arena, (size_t)qtd_grupos * tamanho_no());
+        int base_nivel = proxima_pos_indice;
+
+        for (int g = 0; g < qtd_grupos; g++) {
+            No *n = &nos_nivel[g];
+            iniciar_no(n);
+            n->flag_aponta_folha = filhos_sao_folhas;
+            int k = 0;
+            for (int j = inicio_grupo[g]; j < inicio_grupo[g + 1]; j++, k++) {
+                n->p[k] = pos_filhos[j];
+                if (k > 0) n->s[k - 1] = chaves_filhos[j];
+                if (!filhos_sao_folhas) nos_nivel_anterior[j].ppai = base_nivel + g;
+            }
+            n->m = k - 1;
         }
-        n1->p[n1->m] = ponteiros_aux[n1->m];
 
-        // 6. Preenche n2 (n direito)
-        n2->m = (ORDEM - 1) - indice_chave_subir;
-        for (int j = 0; j < n2->m; j++) {
-            n2->s[j] = chaves_aux[indice_n2_inicio + j];
-            n2->p[j] = ponteiros_aux[indice_n2_inicio + j];
+        // Os filhos (ns de ndice do nvel anterior, em posies consecutivas) j conhecem o pai:
+        // podem ser gravados
+        if (!filhos_sao_folhas) {
+            fseek(f_indice, (long)pos_filhos[0] * tamanho_no(), SEEK_SET);
+            fwrite(nos_nivel_anterior, tamanho_no(), qtd_filhos, f_indice);
         }
-        n2->p[n2->m] = ponteiros_aux[ORDEM];
-
-        // 7. Salva n1 na posio original e n2 no fim
-        salva_no(n1, f_indice, p_pai_original);
-        salva_no(n2, f_indice, -1);
-        int n2_pos = (ftell(f_indice) / tamanho_no()) - 1;
 
-        // 8. Atualiza os pais dos filhos do n2
-        for (int j = 0; j <= n2->m; j++) {
-            if (n2->flag_aponta_folha) {
-                atualiza_pai_de_no_dado(f_dados, n2->p[j], n2_pos);
-            } else {
-                atualiza_pai_de_no(f_indice, n2->p[j], n2_pos);
-            }
+        for (int g = 0; g < qtd_grupos; g++) {
+            chaves_filhos[g] = chaves_filhos[inicio_grupo[g]];
+            pos_filhos[g] = base_nivel + g;
         }
+        proxima_pos_indice += qtd_grupos;
+        nos_nivel_anterior = nos_nivel;
+        qtd_filhos = qtd_grupos;
+        filhos_sao_folhas = 0;
+    }
 
-        free(n1);
-        free(n2);
-        free(no_pai);
-        free(md);
+    // Os nveis gravados com fwrite saem do buffer do FILE* antes da raiz e dos metadados, que vo pelo pool
+    fflush(f_indice);
 
-        // 9. Propaga a chave subida para o pai
-        inserir_em_arquivo_de_indice(chave_subir, p_pai_do_pai, 0, p_pai_original, n2_pos, f_metadados, f_indice, f_dados);
+    // 4. O ltimo nvel montado  a raiz
+    if (nos_nivel_anterior) {
+        salva_no(&nos_nivel_anterior[0], f_indice, pos_filhos[0]);
+        md.pont_raiz = pos_filhos[0];
+        md.flag_raiz_folha = 0;
     }
+    salva_metadados(&md, f_metadados);
+    arena_liberar(&arena);
+
+    free(inicio_grupo);
+    free(chaves_filhos);
+    free(pos_filhos);
 }
 
+/************************************************ NDICE LSM DAS NOTAS ************************************************/
 
-// Insere uma entrada (nota + ndice) na rvore B+
-void inserir_bmais(float nota, int indice_registro, FILE *f_metadados, FILE *f_indice, FILE *f_dados) {
+// Alternativa  rvore B+ para ingesto contnua. Cada READ grava as notas novas, j ordenadas pela
+// ordenao externa, como uma run imutvel (nota_xx_run_<id>.dat) e s acrescenta o id no manifesto
+// (nota_xx_lsm.dat); nada do que j estava no disco  relido ou reescrito. Quando h runs demais, uma
+// thread de compactao intercala as mais novas numa s. As consultas leem todas as runs intercaladas, de
+// uma verso publicada do manifesto (VersaoLsm) que a compactao no altera: ela publica outra, e as
+// runs que saram s so apagadas quando a ltima consulta que usava a verso anterior termina.
 
-    rewind(f_metadados);
-    rewind(f_indice);
-    rewind(f_dados);
+#define MOTOR_BMAIS 0
+#define MOTOR_LSM 1
+#define MAX_RUNS_LSM 32
+#define LIMITE_RUNS_LSM 4          // Acima disso a compactao  disparada no fim do READ
+#define ENTRADAS_POR_BLOCO_LSM 4096 // Entradas lidas/gravadas por vez em cada run
+#define VERSAO_MANIFESTO_LSM 1
 
-    Metadados *md = le_metadados(f_metadados);
-    EntradaIndiceNota nova_entrada = { .nota = nota, .indice_registro = indice_registro };
-    int p_ultima_folha = md->pont_ultima_folha; // Guarda a posio da ltima folha antes da insero/split
+// Motor de cada rvore de nota criada por READ (se vazia) ou REINDEX (CONFIG MOTOR)
+int MOTOR_INDICE_NOTA[5] = { MOTOR_BMAIS, MOTOR_BMAIS, MOTOR_BMAIS, MOTOR_BMAIS, MOTOR_BMAIS };
 
-    if (md->pont_raiz == -1) { // rvore vazia
-        NoDados *nd = cria_no_dados();
-        nd = inserir_entrada_em_no_dado(nd, nova_entrada);
+typedef struct {
+    int id;
+    long qtd; // Entradas da run
+} RunLsm;
 
-        salva_no_dados(nd, f_dados, 0);
-        int nd_pos = 0;
+// Runs da mais antiga para a mais nova
+typedef struct {
+    int versao;
+    int qtd_runs;
+    int proximo_id;
+    RunLsm runs[MAX_RUNS_LSM];
+} ManifestoLsm;
 
-        md->pont_raiz = nd_pos;
-        md->flag_raiz_folha = 1;
-        md->pont_primeira_folha = nd_pos; // Primeira folha
-        md->pont_ultima_folha = nd_pos;   // ltima folha
-        salva_metadados(md, f_metadados);
+// Manifesto publicado para as consultas, com contagem de referncias
+typedef struct {
+    char nome[TAM_CAMINHO]; // Prefixo das runs
+    ManifestoLsm manifesto;
+    int refs;
+    int qtd_obsoletas;
+    RunLsm obsoletas[MAX_RUNS_LSM]; // Runs que a verso seguinte no usa: apagadas junto com esta
+} VersaoLsm;
 
-        free(nd);
-        free(md);
-        return;
-    }
+typedef struct {
+    char nome[TAM_CAMINHO]; // Prefixo dos arquivos (o caminho da rvore na base)
+    ManifestoLsm manifesto; // O do disco; enquanto compacta, s a thread de compactao o usa
+    VersaoLsm *versao;      // O que as consultas leem (NULL se o ndice no usa o motor LSM)
+    pthread_t thread_compactacao;
+    int compactando; // 1 enquanto a thread de compactao no foi aguardada
+} IndiceLsm;
+
+pthread_mutex_t mutex_versoes_lsm = PTHREAD_MUTEX_INITIALIZER;
+
+void nome_manifesto_lsm(const IndiceLsm *l, char *nome) {
+    montar_caminho(nome, TAM_CAMINHO, "%s_lsm.dat", l->nome);
+}
 
-    Info *info = busca(nota, f_metadados, f_indice, f_dados);
+void nome_run_lsm(const char *prefixo, int id, char *nome) {
+    montar_caminho(nome, TAM_CAMINHO, "%s_run_%d.dat", prefixo, id);
+}
 
-    if (info->encontrou == 1) {
+// Retorna 1 se o manifesto existe (o ndice usa o motor LSM); seno deixa o manifesto zerado
+int lsm_ler_manifesto(IndiceLsm *l) {
+    char nome[TAM_CAMINHO];
+    nome_manifesto_lsm(l, nome);
+    memset(&l->manifesto, 0, sizeof(ManifestoLsm));
+    FILE *fp = fopen(nome, "rb");
+    if (!fp) return 0;
+    int lido = (fread(&l->manifesto, sizeof(ManifestoLsm), 1, fp) == 1);
+    fclose(fp);
+    if (!lido || l->manifesto.versao != VERSAO_MANIFESTO_LSM) {
+        printf("Aviso: manifesto LSM '%s' invalido; ignorado.\n", nome);
+        memset(&l->manifesto, 0, sizeof(ManifestoLsm));
+        return 0;
     }
+    return 1;
+}
 
-    int p_f_dados_original = info->p_f_dados;
-    NoDados *nd = buscar_no_dados(p_f_dados_original, f_dados);
+// Grava o manifesto em `<manifesto>.tmp`, que trocar_arquivo_tmp pe no lugar. Retorna 0 em caso de sucesso.
+int lsm_gravar_manifesto_tmp(const IndiceLsm *l) {
+    char nome[TAM_CAMINHO], nome_tmp[TAM_CAMINHO];
+    nome_manifesto_lsm(l, nome);
+    montar_caminho(nome_tmp, sizeof(nome_tmp), "%s.tmp", nome);
+    FILE *fp = fopen(nome_tmp, "wb");
+    if (!fp) {
+        perror("Erro ao gravar o manifesto do indice LSM");
+        return 1;
+    }
+    fwrite(&l->manifesto, sizeof(ManifestoLsm), 1, fp);
+    if (fclose(fp) != 0) {
+        perror("Erro ao gravar o manifesto do indice LSM");
+        return 1;
+    }
+    return 0;
+}
 
-    if (nd->m < ORDEM - 1) { // N de dados tem espao
-        nd = inserir_entrada_em_no_dado(nd, nova_entrada);
-        salva_no_dados(nd, f_dados, p_f_dados_original);
-        free(nd);
-        free(md);
-        free(info);
-        return;
-    } else { // N de dados cheio -> Split
+// Grava o manifesto (tmp + rename): a troca do conjunto de runs  atmica. Retorna 0 em caso de sucesso.
+int lsm_gravar_manifesto(const IndiceLsm *l) {
+    if (lsm_gravar_manifesto_tmp(l) != 0) return 1;
+    char nome[TAM_CAMINHO];
+    nome_manifesto_lsm(l, nome);
+    return !trocar_arquivo_tmp(nome);
+}
 
-        EntradaIndiceNota entradas_aux[ORDEM];
-        for (int i = 0; i < ORDEM - 1; i++) {
-            entradas_aux[i] = nd->s[i];
+// Grava as entradas (j ordenadas) da fonte numa run nova. Retorna quantas gravou, ou -1 em caso de erro.
+// A run s passa a valer quando entra no manifesto; se o programa cair antes, o id  reaproveitado.
+long lsm_gravar_run(const char *prefixo, int id, FonteEntradasNota *fonte) {
+    char nome[TAM_CAMINHO];
+    nome_run_lsm(prefixo, id, nome);
+    FILE *f = fopen(nome, "wb");
+    if (!f) {
+        perror("Erro ao criar run do indice LSM");
+        return -1;
+    }
+    EntradaIndiceNota *bloco = (EntradaIndiceNota *)malloc(ENTRADAS_POR_BLOCO_LSM * sizeof(EntradaIndiceNota));
+    if (!bloco) { perror("Erro ao alocar bloco do indice LSM"); exit(1); }
+
+    long qtd = 0;
+    int n = 0;
+    while (fonte->proximo(fonte->estado, &bloco[n])) {
+        qtd++;
+        if (++n == ENTRADAS_POR_BLOCO_LSM) {
+            fwrite(bloco, sizeof(EntradaIndiceNota), n, f);
+            n = 0;
         }
+    }
+    if (n > 0) fwrite(bloco, sizeof(EntradaIndiceNota), n, f);
+    free(bloco);
+
+    int erro = ferror(f);
+    if (fclose(f) != 0) erro = 1;
+    if (erro) {
+        perror("Erro ao gravar run do indice LSM");
+        remove(nome);
+        return -1;
+    }
+    return qtd;
+}
 
-        int i = ORDEM - 1;
-        while (i > 0 && entradas_aux[i - 1].nota > nova_entrada.nota) {
-            entradas_aux[i] = entradas_aux[i - 1];
-            i--;
-        }
-        entradas_aux[i] = nova_entrada;
+void lsm_remover_runs(const char *prefixo, const RunLsm *runs, int qtd) {
+    char nome[TAM_CAMINHO];
+    for (int i = 0; i < qtd; i++) {
+        nome_run_lsm(prefixo, runs[i].id, nome);
+        remove(nome);
+    }
+}
 
-        int split_index = ORDEM / 2;
+// Verso do manifesto para uma consulta (NULL se o ndice no usa o motor LSM). As runs dela continuam no
+// disco at lsm_liberar_versao, mesmo que uma compactao publique outra verso nesse meio tempo.
+VersaoLsm *lsm_adquirir_versao(IndiceLsm *l) {
+    pthread_mutex_lock(&mutex_versoes_lsm);
+    VersaoLsm *v = l->versao;
+    if (v) v->refs++;
+    pthread_mutex_unlock(&mutex_versoes_lsm);
+    return v;
+}
 
-        NoDados *nd1 = cria_no_dados();
-        NoDados *nd2 = cria_no_dados();
+void lsm_liberar_versao(VersaoLsm *v) {
+    if (!v) return;
+    pthread_mutex_lock(&mutex_versoes_lsm);
+    int refs = --v->refs;
+    pthread_mutex_unlock(&mutex_versoes_lsm);
+    if (refs > 0) return;
+    lsm_remover_runs(v->nome, v->obsoletas, v->qtd_obsoletas);
+    free(v);
+}
 
-        // 1. Preenche nd1 (N esquerdo, que ocupa a posio original)
-        for (int j = 0; j < split_index; j++) {
-            inserir_entrada_em_no_dado(nd1, entradas_aux[j]);
-        }
+// Publica o manifesto de `l` como est agora (nenhum, se o ndice deixou de ser LSM). As `qtd` runs
+// `obsoletas`, que saram do manifesto, so apagadas quando ningum mais l a verso anterior.
+void lsm_publicar_versao(IndiceLsm *l, const RunLsm *obsoletas, int qtd) {
+    VersaoLsm *nova = NULL;
+    if (l->manifesto.versao == VERSAO_MANIFESTO_LSM) {
+        nova = (VersaoLsm *)calloc(1, sizeof(VersaoLsm));
+        if (!nova) { perror("Erro ao alocar versao do indice LSM"); exit(1); }
+        memcpy(nova->nome, l->nome, sizeof(nova->nome));
+        nova->manifesto = l->manifesto;
+        nova->refs = 1;
+    }
+    pthread_mutex_lock(&mutex_versoes_lsm);
+    VersaoLsm *antiga = l->versao;
+    l->versao = nova;
+    if (antiga && qtd > 0) {
+        memcpy(antiga->obsoletas, obsoletas, qtd * sizeof(RunLsm));
+        antiga->qtd_obsoletas = qtd;
+    }
+    pthread_mutex_unlock(&mutex_versoes_lsm);
+    if (antiga) {
+        lsm_liberar_versao(antiga);
+    } else {
+        lsm_remover_runs(l->nome, obsoletas, qtd);
+    }
+}
 
-        // 2. Preenche nd2 (N direito, que  um novo n)
-        for (int j = split_index; j < ORDEM; j++) {
-            inserir_entrada_em_no_dado(nd2, entradas_aux[j]);
-        }
+// Deixa de publicar o manifesto sem apagar runs (ao fechar as rvores)
+void lsm_retirar_versao(IndiceLsm *l) {
+    pthread_mutex_lock(&mutex_versoes_lsm);
+    VersaoLsm *v = l->versao;
+    l->versao = NULL;
+    pthread_mutex_unlock(&mutex_versoes_lsm);
+    lsm_liberar_versao(v);
+}
 
-        // 3. Ajusta o encadeamento duplo da lista de folhas
+// ndice LSM novo, sem runs (o manifesto no disco  o que marca a rvore como LSM)
+int lsm_criar(IndiceLsm *l) {
+    memset(&l->manifesto, 0, sizeof(ManifestoLsm));
+    l->manifesto.versao = VERSAO_MANIFESTO_LSM;
+    if (lsm_gravar_manifesto(l) != 0) return 1;
+    lsm_publicar_versao(l, NULL, 0);
+    return 0;
+}
 
-        int p_proximo_original = nd->prox;
+// Apaga o manifesto e as runs. Retorna 1 se havia um ndice LSM.
+int lsm_remover(IndiceLsm *l) {
+    char nome[TAM_CAMINHO];
+    nome_manifesto_lsm(l, nome);
+    ManifestoLsm antigo = l->manifesto;
+    memset(&l->manifesto, 0, sizeof(ManifestoLsm));
+    lsm_publicar_versao(l, antigo.runs, antigo.qtd_runs);
+    return remove(nome) == 0;
+}
 
-        nd2->prox = p_proximo_original; // nd2 aponta para quem vinha depois do nd original
-        nd2->ant = p_f_dados_original;  // nd2 aponta para nd1 (posio original)
+long lsm_total_entradas(const ManifestoLsm *m) {
+    long total = 0;
+    for (int i = 0; i < m->qtd_runs; i++) total += m->runs[i].qtd;
+    return total;
+}
 
-        nd1->prox = -1; // Sera atualizado aps nd2 ser salvo
-        nd1->ant = nd->ant; // nd1 herda o ponteiro anterior do nd original
+// Acrescenta uma run com as entradas da fonte (a carga de um READ). O manifesto com ela fica no temporrio:
+// o READ s o pe no lugar depois de marcar o ndice como pronto no checkpoint
+int lsm_acrescentar_run(IndiceLsm *l, FonteEntradasNota *fonte) {
+    ManifestoLsm *m = &l->manifesto;
+    if (m->qtd_runs == MAX_RUNS_LSM) {
+        // A compactao deixa no mximo LIMITE_RUNS_LSM runs antes de cada READ
+        fprintf(stderr, "Erro: o indice LSM %s atingiu %d runs.\n", l->nome, MAX_RUNS_LSM);
+        return 1;
+    }
+    long qtd = lsm_gravar_run(l->nome, m->proximo_id, fonte);
+    if (qtd < 0) return 1;
+    m->runs[m->qtd_runs].id = m->proximo_id;
+    m->runs[m->qtd_runs].qtd = qtd;
+    m->qtd_runs++;
+    m->proximo_id++;
+    return lsm_gravar_manifesto_tmp(l);
+}
 
-        // 4. Salva nd1 na posio original
-        nd1->ppai = nd->ppai;
-        salva_no_dados(nd1, f_dados, p_f_dados_original);
+// REINDEX: uma nica run com todas as entradas substitui as antigas
+int lsm_substituir_runs(IndiceLsm *l, FonteEntradasNota *fonte) {
+    ManifestoLsm antigo = l->manifesto;
+    ManifestoLsm *m = &l->manifesto;
+    long qtd = lsm_gravar_run(l->nome, m->proximo_id, fonte);
+    if (qtd < 0) return 1;
+    m->versao = VERSAO_MANIFESTO_LSM;
+    m->runs[0].id = m->proximo_id;
+    m->runs[0].qtd = qtd;
+    m->qtd_runs = 1;
+    m->proximo_id++;
+    if (lsm_gravar_manifesto(l) != 0) return 1;
+    lsm_publicar_versao(l, antigo.runs, antigo.qtd_runs);
+    return 0;
+}
 
-        // 5. Salva nd2 no fim do arquivo
-        nd2->ppai = nd->ppai;
-        salva_no_dados(nd2, f_dados, -1);
-        int nd2_pos = (ftell(f_dados) / tamanho_no_dados()) - 1;
+// Cursor de uma run, lida em blocos do incio para o fim ou do fim para o incio
+typedef struct {
+    FILE *f;
+    EntradaIndiceNota *bloco;
+    long qtd;         // Entradas da run
+    long carregadas;  // Entradas j trazidas para o bloco
+    int restam_bloco; // Entradas do bloco ainda no entregues
+    int i;            // Prxima entrada do bloco
+    EntradaIndiceNota atual;
+} CursorRunLsm;
+
+int cursor_run_lsm_proximo(CursorRunLsm *c, int decrescente, EntradaIndiceNota *destino) {
+    if (c->restam_bloco == 0) {
+        long n = MIN(ENTRADAS_POR_BLOCO_LSM, c->qtd - c->carregadas);
+        if (n <= 0) return 0;
+        long inicio = decrescente ? c->qtd - c->carregadas - n : c->carregadas;
+        fseek(c->f, inicio * (long)sizeof(EntradaIndiceNota), SEEK_SET);
+        if (fread(c->bloco, sizeof(EntradaIndiceNota), n, c->f) != (size_t)n) return 0;
+        c->carregadas += n;
+        c->restam_bloco = (int)n;
+        c->i = decrescente ? (int)n - 1 : 0;
+    }
+    *destino = c->bloco[c->i];
+    c->i += decrescente ? -1 : 1;
+    c->restam_bloco--;
+    return 1;
+}
 
-        // 6. Finaliza encadeamento: Atualiza nd1->prox e o n que vem depois (p_proximo_original)
+// Intercala runs do manifesto (heap pela entrada atual de cada uma), em ordem crescente ou decrescente
+typedef struct {
+    int decrescente;
+    int qtd;
+    CursorRunLsm runs[MAX_RUNS_LSM];
+    int heap[MAX_RUNS_LSM];
+    int tam_heap;
+} LeitorLsm;
+
+// Em empate vence a run mais antiga no sentido crescente (a mais nova no decrescente)
+int leitor_lsm_antes(LeitorLsm *l, int a, int b) {
+    int c = compara_entrada_nota(&l->runs[a].atual, &l->runs[b].atual);
+    if (l->decrescente) c = -c;
+    return c < 0 || (c == 0 && (l->decrescente ? a > b : a < b));
+}
 
-        // Atualiza nd1->prox para nd2
-        nd1->prox = nd2_pos;
-        salva_no_dados(nd1, f_dados, p_f_dados_original);
+void leitor_lsm_desce_heap(LeitorLsm *l, int i) {
+    while (1) {
+        int menor = i, esq = 2 * i + 1, dir = 2 * i + 2;
+        if (esq < l->tam_heap && leitor_lsm_antes(l, l->heap[esq], l->heap[menor])) menor = esq;
+        if (dir < l->tam_heap && leitor_lsm_antes(l, l->heap[dir], l->heap[menor])) menor = dir;
+        if (menor == i) return;
+        int tmp = l->heap[i]; l->heap[i] = l->heap[menor]; l->heap[menor] = tmp;
+        i = menor;
+    }
+}
 
-        // Atualiza o ponteiro 'ant' do n que vem depois (se ele existir)
-        if (p_proximo_original != -1) {
-            NoDados *nd_proximo = buscar_no_dados(p_proximo_original, f_dados);
-            if (nd_proximo) {
-                nd_proximo->ant = nd2_pos;
-                salva_no_dados(nd_proximo, f_dados, p_proximo_original);
-                free(nd_proximo);
-            }
+// Abre as runs [primeira, primeira + qtd) do manifesto `m`, cujas runs tm o prefixo `prefixo`.
+// Retorna 0 em caso de sucesso.
+int leitor_lsm_abrir(LeitorLsm *l, const char *prefixo, const ManifestoLsm *m, int primeira, int qtd, int decrescente) {
+    l->decrescente = decrescente;
+    l->qtd = 0;
+    l->tam_heap = 0;
+    for (int r = primeira; r < primeira + qtd; r++) {
+        char nome[TAM_CAMINHO];
+        nome_run_lsm(prefixo, m->runs[r].id, nome);
+        CursorRunLsm *c = &l->runs[l->qtd];
+        memset(c, 0, sizeof(CursorRunLsm));
+        c->f = fopen(nome, "rb");
+        if (!c->f) {
+            perror("Erro ao abrir run do indice LSM");
+            return 1;
         }
+        c->bloco = (EntradaIndiceNota *)malloc(ENTRADAS_POR_BLOCO_LSM * sizeof(EntradaIndiceNota));
+        if (!c->bloco) { perror("Erro ao alocar bloco do indice LSM"); exit(1); }
+        c->qtd = m->runs[r].qtd;
+        if (cursor_run_lsm_proximo(c, decrescente, &c->atual)) l->heap[l->tam_heap++] = l->qtd;
+        l->qtd++;
+    }
+    for (int i = l->tam_heap / 2 - 1; i >= 0; i--) {
+        leitor_lsm_desce_heap(l, i);
+    }
+    return 0;
+}
 
-        // 7. Atualiza o ponteiro da LTIMA folha nos metadados, se nd2 se tornou a nova ltima folha
-        if (p_f_dados_original == p_ultima_folha) {
-             Metadados *md_temp = le_metadados(f_metadados);
-             md_temp->pont_ultima_folha = nd2_pos;
-             salva_metadados(md_temp, f_metadados);
-             free(md_temp);
-        }
+// Prxima entrada na ordem do leitor (mesma assinatura de FonteEntradasNota.proximo)
+int leitor_lsm_proximo(void *estado, EntradaIndiceNota *destino) {
+    LeitorLsm *l = (LeitorLsm *)estado;
+    if (l->tam_heap == 0) return 0;
+    CursorRunLsm *c = &l->runs[l->heap[0]];
+    *destino = c->atual;
+    if (!cursor_run_lsm_proximo(c, l->decrescente, &c->atual)) {
+        l->heap[0] = l->heap[--l->tam_heap];
+    }
+    leitor_lsm_desce_heap(l, 0);
+    return 1;
+}
+
+void leitor_lsm_fechar(LeitorLsm *l) {
+    for (int i = 0; i < l->qtd; i++) {
+        fclose(l->runs[i].f);
+        free(l->runs[i].bloco);
+    }
+    l->qtd = 0;
+    l->tam_heap = 0;
+}
 
+// Escolhe as runs a compactar: as mais novas (pelo menos 2), enquanto a run anterior no passar do dobro
+// do que j foi juntado, para no reescrever a run grande e antiga a cada READ pequeno.
+// Retorna a primeira run a intercalar, ou -1 se ainda no h runs demais.
+int lsm_escolher_compactacao(const ManifestoLsm *m) {
+    if (m->qtd_runs <= LIMITE_RUNS_LSM) return -1;
+    int primeira = m->qtd_runs - 1;
+    long soma = m->runs[primeira].qtd;
+    while (primeira > 0 && (m->qtd_runs - primeira < 2 || m->runs[primeira - 1].qtd <= 2 * soma)) {
+        primeira--;
+        soma += m->runs[primeira].qtd;
+    }
+    return primeira;
+}
+
+// Intercala as runs [primeira, qtd_runs) numa run nova, troca o manifesto e publica a verso nova; as
+// antigas so apagadas quando a ltima consulta que ainda as l termina
+int lsm_compactar(IndiceLsm *l, int primeira) {
+    ManifestoLsm *m = &l->manifesto;
+    int qtd = m->qtd_runs - primeira;
+    LeitorLsm leitor;
+    if (leitor_lsm_abrir(&leitor, l->nome, m, primeira, qtd, 0) != 0) {
+        leitor_lsm_fechar(&leitor);
+        return 1;
+    }
+    RunLsm antigas[MAX_RUNS_LSM];
+    memcpy(antigas, &m->runs[primeira], qtd * sizeof(RunLsm));
+
+    FonteEntradasNota fonte = { .total = 0, .proximo = leitor_lsm_proximo, .estado = &leitor };
+    for (int i = 0; i < qtd; i++) fonte.total += antigas[i].qtd;
+    long gravadas = lsm_gravar_run(l->nome, m->proximo_id, &fonte);
+    leitor_lsm_fechar(&leitor);
+    if (gravadas < 0) return 1;
+
+    m->runs[primeira].id = m->proximo_id;
+    m->runs[primeira].qtd = gravadas;
+    m->qtd_runs = primeira + 1;
+    m->proximo_id++;
+    if (lsm_gravar_manifesto(l) != 0) return 1;
+    lsm_publicar_versao(l, antigas, qtd);
+    return 0;
+}
 
-        // 8. Propaga a primeira chave de nd2 para o n de ndice pai
-        inserir_em_arquivo_de_indice(nd2->s[0].nota, nd->ppai, 1, p_f_dados_original, nd2_pos, f_metadados, f_indice, f_dados);
+void *thread_compactacao_lsm(void *arg) {
+    IndiceLsm *l = (IndiceLsm *)arg;
+    int primeira;
+    while ((primeira = lsm_escolher_compactacao(&l->manifesto)) != -1) {
+        if (lsm_compactar(l, primeira) != 0) break;
+    }
+    return NULL;
+}
 
-        free(nd);
-        free(nd1);
-        free(nd2);
-        free(md);
-        free(info);
+// Dispara a compactao em segundo plano se h runs demais. At lsm_esperar_compactacao, `l->manifesto`
+// pertence  thread de compactao; as consultas seguem pela verso publicada.
+void lsm_iniciar_compactacao(IndiceLsm *l) {
+    if (l->compactando || lsm_escolher_compactacao(&l->manifesto) == -1) return;
+    if (pthread_create(&l->thread_compactacao, NULL, thread_compactacao_lsm, l) == 0) {
+        l->compactando = 1;
+    } else {
+        thread_compactacao_lsm(l); // Sem thread: compacta agora mesmo
     }
 }
 
+void lsm_esperar_compactacao(IndiceLsm *l) {
+    if (!l->compactando) return;
+    pthread_join(l->thread_compactacao, NULL);
+    l->compactando = 0;
+}
+
 /************************************************ FUNES DE ARQUIVO PRINCIPAL ************************************************/
 
 typedef struct {
-    char nome[100];
+    char nome[TAM_NOME_ARQUIVO_BASE];
     FILE *f_metadados;
     FILE *f_indice;
     FILE *f_dados;
+    int motor;      // MOTOR_BMAIS ou MOTOR_LSM (que existe se h o manifesto)
+    IndiceLsm lsm;  // S usado com MOTOR_LSM
 } ArvoreBmais;
 
 ArvoreBmais arvores[5];
-const char *nome_participantes_bin = "participantes.bin";
-const char *nome_localizacao_bin = "localizacao.bin";
-const char *nome_registro_estado_bin = "reg_por_estado.bin";
-const char *nome_gabarito_bin = "gabarito_provas.bin";
-const char *nome_trie_bin = "trie_nuseq.bin";
+
+// Diretrio da verso da base em uso. "." (arquivos direto no diretrio do programa) at o primeiro RELOAD,
+// que passa a base para diretrios base_<n> (ver VERSES DA BASE)
+char DIRETORIO_BASE[TAM_DIRETORIO_BASE] = ".";
+
+// Caminho de `nome` dentro da verso da base em uso
+void caminho_na_base(char *destino, size_t tamanho, const char *nome) {
+    if (strcmp(DIRETORIO_BASE, ".") == 0) {
+        montar_caminho(destino, tamanho, "%s", nome);
+    } else {
+        montar_caminho(destino, tamanho, "%s/%s", DIRETORIO_BASE, nome);
+    }
+}
+
+// Refeitos por definir_diretorio_base quando a base muda de diretrio
+char nome_participantes_bin[TAM_CAMINHO] = "participantes.bin";
+char nome_respostas_bin[TAM_CAMINHO] = "participantes_respostas.bin";
+char nome_localizacao_bin[TAM_CAMINHO] = "localizacao.bin";
+char nome_registro_estado_bin[TAM_CAMINHO] = "reg_por_estado.bin";
+char nome_gabarito_bin[TAM_CAMINHO] = "gabarito_provas.bin";
+char nome_trie_bin[TAM_CAMINHO] = "trie_nuseq.bin";
+char nome_extras_bin[TAM_CAMINHO] = "participantes_extra.bin";
 int REGPORPAG = 5;
 
 
@@ -966,6 +2253,7 @@ void to_lowercase(char *s) {
 
 FILE *abrir_arquivo_localizacao(const char *nome, HeaderLocalizacao *h) {
     FILE *fp = fopen(nome, "rb+");
+    preparar_buffer_transacao(fp);
 
     if (fp == NULL) {
         fp = fopen(nome, "wb+");
@@ -973,6 +2261,7 @@ FILE *abrir_arquivo_localizacao(const char *nome, HeaderLocalizacao *h) {
             perror("Erro ao criar arquivo de localizacao");
             return NULL;
         }
+        preparar_buffer_transacao(fp);
 
         h->qtd_registros = 0;
         fwrite(h, tamanho_header_localizacao(), 1, fp);
@@ -988,6 +2277,14 @@ FILE *abrir_arquivo_localizacao(const char *nome, HeaderLocalizacao *h) {
 // Salva e retorna o ndice onde a Localizacao foi salva.
 int salvar_localizacao(FILE *fp_loc, HeaderLocalizacao *h_loc, Localizacao *loc) {
     int indice_registro = h_loc->qtd_registros;
+
+    if (ESCRITA_EM_TRANSACAO) {
+        // O arquivo j est posicionado no fim; o cabealho fica em memria at o commit
+        fwrite(loc, tamanho_localizacao(), 1, fp_loc);
+        h_loc->qtd_registros++;
+        return indice_registro;
+    }
+
     long offset = tamanho_header_localizacao() + indice_registro * tamanho_localizacao();
     fseek(fp_loc, offset, SEEK_SET);
     fwrite(loc, tamanho_localizacao(), 1, fp_loc);
@@ -1000,458 +2297,3864 @@ int salvar_localizacao(FILE *fp_loc, HeaderLocalizacao *h_loc, Localizacao *loc)
     return indice_registro;
 }
 
-// Busca de Localizao por ndice
-Localizacao *buscar_localizacao_por_indice(FILE *fp_loc, int indice) {
-    Localizacao *loc = (Localizacao *)malloc(tamanho_localizacao());
-    if (!loc) { perror("Erro de alocacao Localizacao"); return NULL; }
+// Busca de Localizao por ndice, no buffer do chamador. Retorna destino, ou NULL se no existe
+Localizacao *buscar_localizacao_em(FILE *fp_loc, int indice, Localizacao *destino) {
+    if (indice < 0) return NULL; // Participante sem escola
+
+    long offset = tamanho_header_localizacao() + indice * tamanho_localizacao();
+    if (fseek(fp_loc, offset, SEEK_SET) != 0) return NULL;
+    if (fread(destino, tamanho_localizacao(), 1, fp_loc) != 1) return NULL;
+    return destino;
+}
+
+// --- FUNES DE MANIPULAO DO ARQUIVO DE GABARITO ---
+
+FILE *abrir_arquivo_gabarito(const char *nome, HeaderProva *h) {
+    FILE *fp = fopen(nome, "rb+");
+    preparar_buffer_transacao(fp);
+
+    if (fp == NULL) {
+        fp = fopen(nome, "wb+");
+        if (fp == NULL) {
+            perror("Erro ao criar arquivo de gabarito");
+            return NULL;
+        }
+        preparar_buffer_transacao(fp);
+
+        h->qtd_registros = 0;
+        fwrite(h, tamanho_header_prova(), 1, fp);
+        fflush(fp);
+
+    } else {
+        fread(h, tamanho_header_prova(), 1, fp);
+    }
+
+    return fp;
+}
+
+// Salva e retorna o ndice onde a Prova foi salva
+int salvar_gabarito(FILE *fp_gab, HeaderProva *h_gab, Prova *prova) {
+    int indice_registro = h_gab->qtd_registros;
+
+    if (ESCRITA_EM_TRANSACAO) {
+        // O arquivo j est posicionado no fim; o cabealho fica em memria at o commit
+        fwrite(prova, tamanho_prova(), 1, fp_gab);
+        h_gab->qtd_registros++;
+        return indice_registro;
+    }
+
+    long offset = tamanho_header_prova() + indice_registro * tamanho_prova();
+    fseek(fp_gab, offset, SEEK_SET);
+    fwrite(prova, tamanho_prova(), 1, fp_gab);
+
+    h_gab->qtd_registros++;
+    fseek(fp_gab, 0, SEEK_SET);
+    fwrite(h_gab, tamanho_header_prova(), 1, fp_gab);
+    fflush(fp_gab);
+
+    return indice_registro;
+}
+
+// Busca de Gabarito por ndice, no buffer do chamador. Retorna destino, ou NULL se no existe
+Prova *buscar_gabarito_em(FILE *fp_gab, int indice, Prova *destino) {
+    if (indice < 0) return NULL; // Sem prova nesta rea
+
+    long offset = tamanho_header_prova() + indice * tamanho_prova();
+    if (fseek(fp_gab, offset, SEEK_SET) != 0) return NULL;
+    if (fread(destino, tamanho_prova(), 1, fp_gab) != 1) return NULL;
+    return destino;
+}
+
+// --- FUNES DE MANIPULAO DO ARQUIVO DE COLUNAS EXTRAS ---
+
+long tamanho_header_extras() { return sizeof(HeaderExtras); }
+
+// Abre o arquivo de colunas extras. Se ele no existe e 'esquema' tem colunas, cria com esse esquema
+// a partir do participante 'primeiro_registro'. Retorna NULL (sem erro) se no h colunas extras.
+FILE *abrir_arquivo_extras(const char *nome, HeaderExtras *h, const HeaderExtras *esquema, int primeiro_registro) {
+    FILE *fp = fopen(nome, "rb+");
+    preparar_buffer_transacao(fp);
+
+    if (fp == NULL) {
+        if (!esquema || esquema->qtd_colunas == 0) return NULL;
+        fp = fopen(nome, "wb+");
+        if (fp == NULL) {
+            perror("Erro ao criar arquivo de colunas extras");
+            return NULL;
+        }
+        preparar_buffer_transacao(fp);
+
+        *h = *esquema;
+        h->qtd_registros = 0;
+        h->primeiro_registro = primeiro_registro;
+        fwrite(h, tamanho_header_extras(), 1, fp);
+        fflush(fp);
+
+    } else {
+        fread(h, tamanho_header_extras(), 1, fp);
+    }
+
+    return fp;
+}
+
+// Grava o registro de colunas extras do prximo participante
+void gravar_registro_extra(FILE *fp_extra, HeaderExtras *h, const char *registro) {
+    if (ESCRITA_EM_TRANSACAO) {
+        // O arquivo j est posicionado no fim; o cabealho fica em memria at o commit
+        fwrite(registro, h->tamanho_registro, 1, fp_extra);
+        h->qtd_registros++;
+        return;
+    }
+
+    long offset = tamanho_header_extras() + (long)h->qtd_registros * h->tamanho_registro;
+    fseek(fp_extra, offset, SEEK_SET);
+    fwrite(registro, h->tamanho_registro, 1, fp_extra);
+    h->qtd_registros++;
+    fseek(fp_extra, 0, SEEK_SET);
+    fwrite(h, tamanho_header_extras(), 1, fp_extra);
+    fflush(fp_extra);
+}
+
+// L as colunas extras do participante. Retorna 0 se ele no tem (importado antes das colunas extras)
+int ler_registro_extra(FILE *fp_extra, const HeaderExtras *h, int indice_participante, char *registro) {
+    int i = indice_participante - h->primeiro_registro;
+    if (i < 0 || i >= h->qtd_registros) return 0;
+    long offset = tamanho_header_extras() + (long)i * h->tamanho_registro;
+    if (fseek(fp_extra, offset, SEEK_SET) != 0) return 0;
+    return fread(registro, h->tamanho_registro, 1, fp_extra) == 1;
+}
+
+// Texto de uma coluna extra para exibio ("N/A" se nula)
+void formatar_coluna_extra(const ColunaExtra *c, const char *registro, char *saida, size_t tamanho) {
+    const char *valor = registro + c->offset;
+    if (c->tipo == TIPO_CAMPO_INT) {
+        int v = *(const int *)valor;
+        if (v == -1) snprintf(saida, tamanho, "N/A");
+        else snprintf(saida, tamanho, "%d", v);
+    } else if (c->tipo == TIPO_CAMPO_FLOAT) {
+        float v = *(const float *)valor;
+        if (v < 0) snprintf(saida, tamanho, "N/A");
+        else snprintf(saida, tamanho, "%.2f", v);
+    } else {
+        snprintf(saida, tamanho, "%s", valor[0] ? valor : "N/A");
+    }
+}
+
+// --- DICIONRIOS EM MEMRIA DA IMPORTAO ---
+
+// Tabela hash (endereamento aberto, sondagem linear) de cdigo -> ndice no arquivo.
+//  como a importao encontra uma escola ou prova j gravada:  carregada dos arquivos no
+// incio do READ e recebe cada registro novo logo aps salvar_localizacao / salvar_gabarito.
+typedef struct {
+    char chave[16];
+    int valor; // -1 se a posio est livre
+} EntradaDicionario;
+
+typedef struct {
+    EntradaDicionario *entradas;
+    int capacidade; // Sempre potncia de 2
+    int qtd;
+} DicionarioCodigo;
+
+unsigned int hash_codigo(const char *chave) {
+    unsigned int h = 2166136261u; // FNV-1a
+    for (int i = 0; chave[i] != '\0'; i++) {
+        h ^= (unsigned char)chave[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void dicionario_inicializar(DicionarioCodigo *d, int capacidade) {
+    d->capacidade = 64;
+    while (d->capacidade < capacidade * 2) d->capacidade *= 2;
+    d->qtd = 0;
+    d->entradas = (EntradaDicionario *)malloc(d->capacidade * sizeof(EntradaDicionario));
+    if (!d->entradas) { perror("Erro ao alocar DicionarioCodigo"); exit(1); }
+    for (int i = 0; i < d->capacidade; i++) {
+        d->entradas[i].valor = -1;
+    }
+}
+
+void dicionario_liberar(DicionarioCodigo *d) {
+    free(d->entradas);
+    d->entradas = NULL;
+    d->capacidade = 0;
+    d->qtd = 0;
+}
+
+// Retorna o ndice associado ao cdigo ou -1
+int dicionario_buscar(DicionarioCodigo *d, const char *chave) {
+    unsigned int mascara = d->capacidade - 1;
+    unsigned int i = hash_codigo(chave) & mascara;
+    while (d->entradas[i].valor != -1) {
+        if (strcmp(d->entradas[i].chave, chave) == 0) {
+            return d->entradas[i].valor;
+        }
+        i = (i + 1) & mascara;
+    }
+    return -1;
+}
+
+void dicionario_inserir(DicionarioCodigo *d, const char *chave, int valor) {
+    // Mantm a ocupao abaixo de 50% (dobra e reinsere tudo)
+    if ((d->qtd + 1) * 2 > d->capacidade) {
+        DicionarioCodigo maior;
+        dicionario_inicializar(&maior, d->capacidade);
+        for (int i = 0; i < d->capacidade; i++) {
+            if (d->entradas[i].valor != -1) {
+                dicionario_inserir(&maior, d->entradas[i].chave, d->entradas[i].valor);
+            }
+        }
+        dicionario_liberar(d);
+        *d = maior;
+    }
+
+    unsigned int mascara = d->capacidade - 1;
+    unsigned int i = hash_codigo(chave) & mascara;
+    while (d->entradas[i].valor != -1) {
+        if (strcmp(d->entradas[i].chave, chave) == 0) {
+            d->entradas[i].valor = valor;
+            return;
+        }
+        i = (i + 1) & mascara;
+    }
+    strncpy(d->entradas[i].chave, chave, sizeof(d->entradas[i].chave) - 1);
+    d->entradas[i].chave[sizeof(d->entradas[i].chave) - 1] = '\0';
+    d->entradas[i].valor = valor;
+    d->qtd++;
+}
+
+// Carrega todos os cod_esc j gravados em localizacao.bin (uma leitura sequencial)
+void dicionario_carregar_localizacoes(DicionarioCodigo *d, FILE *fp_loc, HeaderLocalizacao *h_loc) {
+    dicionario_inicializar(d, h_loc->qtd_registros);
+    Localizacao temp_loc;
+    fseek(fp_loc, tamanho_header_localizacao(), SEEK_SET);
+    for (int i = 0; i < h_loc->qtd_registros; i++) {
+        if (fread(&temp_loc, tamanho_localizacao(), 1, fp_loc) != 1) break;
+        if (dicionario_buscar(d, temp_loc.cod_esc) == -1) {
+            dicionario_inserir(d, temp_loc.cod_esc, i);
+        }
+    }
+}
+
+// Carrega todos os cod_prova j gravados em gabarito_provas.bin (uma leitura sequencial)
+void dicionario_carregar_gabaritos(DicionarioCodigo *d, FILE *fp_gab, HeaderProva *h_gab) {
+    dicionario_inicializar(d, h_gab->qtd_registros);
+    Prova temp_prova;
+    fseek(fp_gab, tamanho_header_prova(), SEEK_SET);
+    for (int i = 0; i < h_gab->qtd_registros; i++) {
+        if (fread(&temp_prova, tamanho_prova(), 1, fp_gab) != 1) break;
+        if (dicionario_buscar(d, temp_prova.cod_prova) == -1) {
+            dicionario_inserir(d, temp_prova.cod_prova, i);
+        }
+    }
+}
+
+// --- FUNES DE MANIPULAO DO ARQUIVO DE PARTICIPANTE ---
+
+FILE *abrir_arquivo_participantes(const char *nome, HeaderParticipantes *h) {
+    FILE *fp = fopen(nome, "rb+");
+    preparar_buffer_transacao(fp);
+
+    if (fp == NULL) {
+        fp = fopen(nome, "wb+");
+        if (fp == NULL) {
+            perror("Erro ao criar arquivo de participantes");
+            return NULL;
+        }
+        preparar_buffer_transacao(fp);
+
+        h->qtd_registros = 0;
+        h->formato = FORMATO_PARTICIPANTES;
+        fwrite(h, tamanho_header(), 1, fp);
+        fflush(fp);
+
+    } else {
+        fread(h, tamanho_header(), 1, fp);
+    }
+
+    return fp;
+}
+
+// Separa as colunas do participante nos registros dos dois arquivos
+void separar_participante(const Participante *p, RegistroParticipante *r, RespostasParticipante *resp) {
+    memset(r, 0, sizeof(RegistroParticipante));
+    memcpy(r->nu_seq, p->nu_seq, sizeof(r->nu_seq));
+    r->ano = p->ano;
+    r->indice_localizacao = p->indice_localizacao;
+    r->indice_gabarito_cn = p->indice_gabarito_cn;
+    r->indice_gabarito_ch = p->indice_gabarito_ch;
+    r->indice_gabarito_lc = p->indice_gabarito_lc;
+    r->indice_gabarito_mt = p->indice_gabarito_mt;
+    r->nota_cn = NOTA_DE_FLOAT(p->nota_cn);
+    r->nota_ch = NOTA_DE_FLOAT(p->nota_ch);
+    r->nota_lc = NOTA_DE_FLOAT(p->nota_lc);
+    r->nota_mt = NOTA_DE_FLOAT(p->nota_mt);
+    r->ling_est = p->ling_est;
+    r->nota_red = NOTA_DE_FLOAT(p->nota_red);
+    memcpy(resp->resp_cn, p->resp_cn, sizeof(resp->resp_cn));
+    memcpy(resp->resp_ch, p->resp_ch, sizeof(resp->resp_ch));
+    memcpy(resp->resp_lc, p->resp_lc, sizeof(resp->resp_lc));
+    memcpy(resp->resp_mt, p->resp_mt, sizeof(resp->resp_mt));
+}
+
+// Mdia das 5 notas, como mostrada por SHOW, FIND, FILTER e LIST
+float media_participante(const RegistroParticipante *p) {
+    return (NOTA_PARA_FLOAT(p->nota_cn) + NOTA_PARA_FLOAT(p->nota_ch) + NOTA_PARA_FLOAT(p->nota_lc) +
+            NOTA_PARA_FLOAT(p->nota_mt) + NOTA_PARA_FLOAT(p->nota_red)) / 5;
+}
+
+// --- FORMATO COMPACTO ---
+
+// Caractere de cada cdigo de 3 bits das respostas
+const char ALFABETO_RESPOSTAS[8] = {'A', 'B', 'C', 'D', 'E', '*', '.', '9'};
+
+// Cdigo + 1 de cada caractere de resposta (0: fora do alfabeto)
+const uint8_t CODIGO_RESPOSTA[256] = {
+    ['A'] = 1, ['B'] = 2, ['C'] = 3, ['D'] = 4, ['E'] = 5, ['*'] = 6, ['.'] = 7, ['9'] = 8
+};
+
+// 1 se o formato compacto representa o participante sem perda: nu_seq s com dgitos, ano, ling_est
+// (e as notas, com NOTA_PONTO_FIXO) nas faixas dos campos estreitos e respostas s com caracteres do alfabeto
+int participante_compactavel(const Participante *p) {
+    int n = 0;
+    for (; p->nu_seq[n] != '\0'; n++) {
+        if (p->nu_seq[n] < '0' || p->nu_seq[n] > '9') return 0;
+    }
+    if (n == 0 || n >= (int)sizeof(p->nu_seq)) return 0;
+    if (p->ano < INT16_MIN || p->ano > INT16_MAX || p->ling_est < INT8_MIN || p->ling_est > INT8_MAX) return 0;
+#if NOTA_PONTO_FIXO
+    const float notas[5] = {p->nota_cn, p->nota_ch, p->nota_lc, p->nota_mt, p->nota_red};
+    for (int i = 0; i < 5; i++) {
+        if (notas[i] < INT16_MIN / 10.0f || notas[i] > INT16_MAX / 10.0f) return 0;
+    }
+#endif
+
+    const char *respostas[4] = {p->resp_cn, p->resp_ch, p->resp_lc, p->resp_mt};
+    for (int a = 0; a < 4; a++) {
+        for (const char *c = respostas[a]; *c; c++) {
+            if (!CODIGO_RESPOSTA[(unsigned char)*c]) return 0;
+        }
+    }
+    return 1;
+}
+
+void compactar_registro(const RegistroParticipante *r, RegistroCompacto *c) {
+    memset(c, 0, sizeof(RegistroCompacto));
+    int n = 0;
+    uint64_t valor = 0;
+    for (; r->nu_seq[n] != '\0'; n++) valor = valor * 10 + (uint64_t)(r->nu_seq[n] - '0');
+    c->nu_seq = (valor << 4) | (uint64_t)n;
+    c->nota_cn = r->nota_cn;
+    c->nota_ch = r->nota_ch;
+    c->nota_lc = r->nota_lc;
+    c->nota_mt = r->nota_mt;
+    c->nota_red = r->nota_red;
+    c->indice_localizacao = r->indice_localizacao;
+    c->indice_gabarito_cn = r->indice_gabarito_cn;
+    c->indice_gabarito_ch = r->indice_gabarito_ch;
+    c->indice_gabarito_lc = r->indice_gabarito_lc;
+    c->indice_gabarito_mt = r->indice_gabarito_mt;
+    c->ano = (int16_t)r->ano;
+    c->ling_est = (int8_t)r->ling_est;
+}
+
+void descompactar_registro(const RegistroCompacto *c, RegistroParticipante *r) {
+    int n = (int)(c->nu_seq & 15);
+    uint64_t valor = c->nu_seq >> 4;
+    if (n >= (int)sizeof(r->nu_seq)) n = sizeof(r->nu_seq) - 1;
+    r->nu_seq[n] = '\0';
+    for (int i = n - 1; i >= 0; i--) {
+        r->nu_seq[i] = (char)('0' + valor % 10);
+        valor /= 10;
+    }
+    r->ano = c->ano;
+    r->indice_localizacao = c->indice_localizacao;
+    r->indice_gabarito_cn = c->indice_gabarito_cn;
+    r->indice_gabarito_ch = c->indice_gabarito_ch;
+    r->indice_gabarito_lc = c->indice_gabarito_lc;
+    r->indice_gabarito_mt = c->indice_gabarito_mt;
+    r->nota_cn = c->nota_cn;
+    r->nota_ch = c->nota_ch;
+    r->nota_lc = c->nota_lc;
+    r->nota_mt = c->nota_mt;
+    r->ling_est = c->ling_est;
+    r->nota_red = c->nota_red;
+}
+
+// Empacota os itens de uma rea, 3 bits cada, do bit menos significativo do primeiro byte em diante
+void compactar_area_respostas(const char *resp, uint8_t *qtd_itens, uint8_t *itens) {
+    memset(itens, 0, BYTES_ITENS_RESPOSTA);
+    uint32_t acumulado = 0;
+    int bits = 0, byte = 0, n = 0;
+    for (; resp[n] != '\0' && n < MAX_ITENS_RESPOSTA; n++) {
+        acumulado |= (uint32_t)((CODIGO_RESPOSTA[(unsigned char)resp[n]] - 1) & 7) << bits;
+        bits += 3;
+        if (bits >= 8) {
+            itens[byte++] = (uint8_t)acumulado;
+            acumulado >>= 8;
+            bits -= 8;
+        }
+    }
+    if (bits > 0) itens[byte] = (uint8_t)acumulado;
+    *qtd_itens = (uint8_t)n;
+}
+
+void descompactar_area_respostas(uint8_t qtd_itens, const uint8_t *itens, char *resp) {
+    int n = MIN(qtd_itens, MAX_ITENS_RESPOSTA);
+    uint32_t acumulado = 0;
+    int bits = 0, byte = 0;
+    for (int i = 0; i < n; i++) {
+        if (bits < 3) {
+            acumulado |= (uint32_t)itens[byte++] << bits;
+            bits += 8;
+        }
+        resp[i] = ALFABETO_RESPOSTAS[acumulado & 7];
+        acumulado >>= 3;
+        bits -= 3;
+    }
+    resp[n] = '\0';
+}
+
+void compactar_respostas(const RespostasParticipante *r, RespostasCompactas *c) {
+    compactar_area_respostas(r->resp_cn, &c->qtd_itens[0], c->itens[0]);
+    compactar_area_respostas(r->resp_ch, &c->qtd_itens[1], c->itens[1]);
+    compactar_area_respostas(r->resp_lc, &c->qtd_itens[2], c->itens[2]);
+    compactar_area_respostas(r->resp_mt, &c->qtd_itens[3], c->itens[3]);
+}
+
+void descompactar_respostas(const RespostasCompactas *c, RespostasParticipante *r) {
+    descompactar_area_respostas(c->qtd_itens[0], c->itens[0], r->resp_cn);
+    descompactar_area_respostas(c->qtd_itens[1], c->itens[1], r->resp_ch);
+    descompactar_area_respostas(c->qtd_itens[2], c->itens[2], r->resp_lc);
+    descompactar_area_respostas(c->qtd_itens[3], c->itens[3], r->resp_mt);
+}
+
+// Registro de participantes.bin no formato em colunas (FORMATO_PARTICIPANTES_COLUNAS)
+typedef struct {
+    char nu_seq[15];
+    int ano;
+    int indice_localizacao;
+    int indice_gabarito_cn;
+    int indice_gabarito_ch;
+    int indice_gabarito_lc;
+    int indice_gabarito_mt;
+    float nota_cn;
+    float nota_ch;
+    float nota_lc;
+    float nota_mt;
+    int ling_est;
+    float nota_red;
+} RegistroColunas;
+
+// L o prximo participante de uma base num formato anterior ao compacto: no formato em colunas de
+// fp e fp_respostas, no formato em linhas s de fp. As respostas j podem estar no formato compacto,
+// se uma converso foi interrompida entre as duas trocas de arquivo. Retorna 1 se leu
+int ler_participante_formato_anterior(FILE *fp, FILE *fp_respostas, int formato, int formato_respostas, Participante *p) {
+    if (formato != FORMATO_PARTICIPANTES_COLUNAS) return fread(p, sizeof(Participante), 1, fp) == 1;
+
+    RegistroColunas r;
+    RespostasParticipante resp;
+    if (!fp_respostas || fread(&r, sizeof(RegistroColunas), 1, fp) != 1) return 0;
+    if (formato_respostas >= FORMATO_PARTICIPANTES_COMPACTO) {
+        RespostasCompactas compactas;
+        if (fread(&compactas, sizeof(RespostasCompactas), 1, fp_respostas) != 1) return 0;
+        descompactar_respostas(&compactas, &resp);
+    } else if (fread(&resp, sizeof(RespostasParticipante), 1, fp_respostas) != 1) {
+        return 0;
+    }
+
+    memset(p, 0, sizeof(Participante));
+    memcpy(p->nu_seq, r.nu_seq, sizeof(p->nu_seq));
+    p->ano = r.ano;
+    p->indice_localizacao = r.indice_localizacao;
+    p->indice_gabarito_cn = r.indice_gabarito_cn;
+    p->indice_gabarito_ch = r.indice_gabarito_ch;
+    p->indice_gabarito_lc = r.indice_gabarito_lc;
+    p->indice_gabarito_mt = r.indice_gabarito_mt;
+    p->nota_cn = r.nota_cn;
+    p->nota_ch = r.nota_ch;
+    p->nota_lc = r.nota_lc;
+    p->nota_mt = r.nota_mt;
+    p->ling_est = r.ling_est;
+    p->nota_red = r.nota_red;
+    memcpy(p->resp_cn, resp.resp_cn, sizeof(p->resp_cn));
+    memcpy(p->resp_ch, resp.resp_ch, sizeof(p->resp_ch));
+    memcpy(p->resp_lc, resp.resp_lc, sizeof(p->resp_lc));
+    memcpy(p->resp_mt, resp.resp_mt, sizeof(p->resp_mt));
+    return 1;
+}
+
+// Converte participantes.bin (e participantes_respostas.bin, no formato em colunas) para o formato compacto,
+// gravando os dois arquivos ao lado e trocando-os com rename. Registros alm do cabealho (de um READ
+// interrompido) so descartados. Retorna 1 se converteu, 0 se no havia o que converter e -1 em caso de erro
+// (inclusive uma base compacta gravada com o outro modo de NOTA_PONTO_FIXO, que no  convertida)
+int converter_participantes_para_compacto() {
+    FILE *fp = fopen(nome_participantes_bin, "rb");
+    if (!fp) return 0;
+    HeaderParticipantes h;
+    memset(&h, 0, sizeof(h));
+    size_t lidos = fread(&h, 1, tamanho_header(), fp);
+    int formato = (lidos == (size_t)tamanho_header()) ? h.formato : 0;
+    if (formato == FORMATO_PARTICIPANTES) {
+        fclose(fp);
+        return 0;
+    }
+    if (formato == FORMATO_PARTICIPANTES_COMPACTO || formato == FORMATO_PARTICIPANTES_COMPACTO_FIXO) {
+        fclose(fp);
+        printf("Erro: a base em '%s' foi gravada com as notas em %s; use o programa compilado %s NOTA_PONTO_FIXO.\n",
+               nome_participantes_bin, formato == FORMATO_PARTICIPANTES_COMPACTO_FIXO ? "ponto fixo" : "float",
+               formato == FORMATO_PARTICIPANTES_COMPACTO_FIXO ? "com" : "sem");
+        return -1;
+    }
+    int qtd = lidos >= sizeof(int) ? h.qtd_registros : 0;
+    printf("Convertendo '%s' para o formato compacto (%d participantes)...\n", nome_participantes_bin, qtd);
+
+    FILE *fp_respostas_antigo = NULL;
+    HeaderParticipantes h_respostas;
+    memset(&h_respostas, 0, sizeof(h_respostas));
+    if (formato == FORMATO_PARTICIPANTES_COLUNAS) {
+        fp_respostas_antigo = fopen(nome_respostas_bin, "rb");
+        if (fp_respostas_antigo) fread(&h_respostas, tamanho_header(), 1, fp_respostas_antigo);
+    } else {
+        fseek(fp, sizeof(int), SEEK_SET); // No formato em linhas o cabealho  s qtd_registros
+    }
+
+    char nome_tmp[TAM_CAMINHO], nome_tmp_respostas[TAM_CAMINHO];
+    montar_caminho(nome_tmp, sizeof(nome_tmp), "%s.tmp", nome_participantes_bin);
+    montar_caminho(nome_tmp_respostas, sizeof(nome_tmp_respostas), "%s.tmp", nome_respostas_bin);
+    FILE *fp_reg = fopen(nome_tmp, "wb");
+    FILE *fp_resp = fopen(nome_tmp_respostas, "wb");
+    HeaderParticipantes novo = { .qtd_registros = qtd, .formato = FORMATO_PARTICIPANTES };
+    int ok = fp_reg && fp_resp;
+    if (ok) {
+        fwrite(&novo, tamanho_header(), 1, fp_reg);
+        fwrite(&novo, tamanho_header(), 1, fp_resp);
+    }
+
+    Participante p;
+    RegistroParticipante r;
+    RespostasParticipante resp;
+    RegistroCompacto rc;
+    RespostasCompactas respc;
+    for (int i = 0; ok && i < qtd; i++) {
+        if (!ler_participante_formato_anterior(fp, fp_respostas_antigo, formato, h_respostas.formato, &p)) {
+            ok = 0;
+            break;
+        }
+        if (!participante_compactavel(&p)) {
+            printf("Participante %d (NU_SEQ '%.14s') tem valores que o formato compacto nao representa.\n", i, p.nu_seq);
+            ok = 0;
+            break;
+        }
+        separar_participante(&p, &r, &resp);
+        compactar_registro(&r, &rc);
+        compactar_respostas(&resp, &respc);
+        ok = fwrite(&rc, tamanho_participante(), 1, fp_reg) == 1 && fwrite(&respc, tamanho_respostas(), 1, fp_resp) == 1;
+    }
+    fclose(fp);
+    if (fp_respostas_antigo) fclose(fp_respostas_antigo);
+    if (fp_reg && fclose(fp_reg) != 0) ok = 0;
+    if (fp_resp && fclose(fp_resp) != 0) ok = 0;
+    if (!ok) {
+        printf("Erro: nao foi possivel converter '%s'; a base fica como estava.\n", nome_participantes_bin);
+        remove(nome_tmp);
+        remove(nome_tmp_respostas);
+        return -1;
+    }
+
+    // Respostas primeiro: enquanto participantes.bin no  trocado a base segue no formato anterior
+#ifdef _WIN32
+    remove(nome_respostas_bin); // rename() do Windows no sobrescreve
+    remove(nome_participantes_bin);
+#endif
+    if (rename(nome_tmp_respostas, nome_respostas_bin) != 0 || rename(nome_tmp, nome_participantes_bin) != 0) {
+        perror("Erro ao substituir os arquivos de participantes");
+        return -1;
+    }
+    return 1;
+}
+
+// Abre um arquivo B+ (leitura/escrita, cria se no existir)
+FILE *abrir_arquivo_bmais(const char *nome, long tamanho_struct) {
+    FILE *f = fopen(nome, "r+b");
+    if (f == NULL) {
+        f = fopen(nome, "w+b");
+        if (f == NULL) {
+            perror("Erro ao criar arquivo B+ Tree");
+            return NULL;
+        }
+        // Inicializa o arquivo com o metadados se for o arquivo de metadados
+        if (tamanho_struct == tamanho_metadados()) {
+            iniciar_arquivo_metadados(f);
+        }
+    } else if (tamanho_struct == tamanho_metadados() && pool_fim_arquivo(f) == 0) {
+        // Criado e nunca gravado (a importao foi interrompida antes disso): a rvore est vazia
+        iniciar_arquivo_metadados(f);
+    }
+    return f;
+}
+
+// Caminho do arquivo `<nome>_<sufixo>.dat` da rvore, na verso da base em uso
+void nome_arquivo_arvore(const ArvoreBmais *a, const char *sufixo, char *destino) {
+    char nome[TAM_NOME_ARQUIVO_BASE];
+    montar_caminho(nome, sizeof(nome), "%s_%s.dat", a->nome, sufixo);
+    caminho_na_base(destino, TAM_CAMINHO, nome);
+}
+
+// Inicializa todas as 5 rvores B+
+void inicializar_arvores() {
+    char *nomes[] = {"cn", "ch", "lc", "mt", "red"};
+
+    for (int i = 0; i < 5; i++) {
+        montar_caminho(arvores[i].nome, sizeof(arvores[i].nome), "nota_%s", nomes[i]);
+
+        char nome_meta[TAM_CAMINHO], nome_idx[TAM_CAMINHO], nome_dados[TAM_CAMINHO];
+        nome_arquivo_arvore(&arvores[i], "meta", nome_meta);
+        nome_arquivo_arvore(&arvores[i], "indice", nome_idx);
+        nome_arquivo_arvore(&arvores[i], "dados", nome_dados);
+
+        arvores[i].f_metadados = abrir_arquivo_bmais(nome_meta, tamanho_metadados());
+        arvores[i].f_indice = abrir_arquivo_bmais(nome_idx, tamanho_no());
+        arvores[i].f_dados = abrir_arquivo_bmais(nome_dados, tamanho_no_dados());
+
+        if (!arvores[i].f_metadados || !arvores[i].f_indice || !arvores[i].f_dados) {
+            fprintf(stderr, "Erro ao inicializar as rvores B+.\n");
+        }
+
+        // O manifesto LSM, se existe,  quem tem as notas desta rvore
+        caminho_na_base(arvores[i].lsm.nome, sizeof(arvores[i].lsm.nome), arvores[i].nome);
+        arvores[i].lsm.compactando = 0;
+        arvores[i].motor = lsm_ler_manifesto(&arvores[i].lsm) ? MOTOR_LSM : MOTOR_BMAIS;
+        lsm_publicar_versao(&arvores[i].lsm, NULL, 0);
+    }
+}
+
+// Aguarda as compactaes LSM em andamento (antes de qualquer comando que troque os ndices; as
+// consultas no precisam, elas leem a verso publicada)
+void esperar_compactacoes_lsm() {
+    for (int i = 0; i < 5; i++) {
+        lsm_esperar_compactacao(&arvores[i].lsm);
+    }
+}
+
+// Leva ao disco as pginas da rvore que ainda esto s no pool
+void sincronizar_arvore(ArvoreBmais *a) {
+    if (a->f_dados) sincronizar_arquivo_pool(a->f_dados);
+    if (a->f_indice) sincronizar_arquivo_pool(a->f_indice);
+    if (a->f_metadados) sincronizar_arquivo_pool(a->f_metadados);
+}
+
+void sincronizar_arvores() {
+    for (int i = 0; i < 5; i++) {
+        sincronizar_arvore(&arvores[i]);
+    }
+}
+
+// Fecha todos os arquivos das rvores B+
+void fechar_arvores() {
+    esperar_compactacoes_lsm();
+    for (int i = 0; i < 5; i++) {
+        lsm_retirar_versao(&arvores[i].lsm);
+        if (arvores[i].f_metadados) fechar_arquivo_pool(arvores[i].f_metadados);
+        if (arvores[i].f_indice) fechar_arquivo_pool(arvores[i].f_indice);
+        if (arvores[i].f_dados) fechar_arquivo_pool(arvores[i].f_dados);
+    }
+}
+
+// Constri a rvore em lote a partir de `fonte` em arquivos temporrios, que trocar_arvore_bmais pe no lugar
+// dos atuais. At a troca a rvore antiga continua inteira no disco (e pode ser lida pela prpria fonte).
+int gravar_arvore_bmais_tmp(ArvoreBmais *a, FonteEntradasNota *fonte) {
+    const char *sufixos[3] = {"dados", "indice", "meta"};
+    char nomes[3][TAM_CAMINHO], nomes_tmp[3][TAM_CAMINHO];
+    for (int i = 0; i < 3; i++) {
+        nome_arquivo_arvore(a, sufixos[i], nomes[i]);
+        montar_caminho(nomes_tmp[i], sizeof(nomes_tmp[i]), "%s.tmp", nomes[i]);
+    }
+
+    FILE *f_dados_tmp = fopen(nomes_tmp[0], "w+b");
+    FILE *f_indice_tmp = fopen(nomes_tmp[1], "w+b");
+    FILE *f_meta_tmp = fopen(nomes_tmp[2], "w+b");
+    if (!f_dados_tmp || !f_indice_tmp || !f_meta_tmp) {
+        perror("Erro ao criar arquivos temporarios da Arvore B+");
+        if (f_dados_tmp) fechar_arquivo_pool(f_dados_tmp);
+        if (f_indice_tmp) fechar_arquivo_pool(f_indice_tmp);
+        if (f_meta_tmp) fechar_arquivo_pool(f_meta_tmp);
+        return 1;
+    }
+    iniciar_arquivo_metadados(f_meta_tmp);
+    construir_bmais_em_lote(fonte, f_meta_tmp, f_indice_tmp, f_dados_tmp);
+
+    int erro = fechar_arquivo_pool(f_dados_tmp) != 0;
+    erro |= fechar_arquivo_pool(f_indice_tmp) != 0;
+    erro |= fechar_arquivo_pool(f_meta_tmp) != 0;
+    if (erro) perror("Erro ao gravar arquivos temporarios da Arvore B+");
+    return erro;
+}
+
+// Pe no lugar os temporrios da rvore que existirem e reabre os arquivos dela. Metadados por ltimo:
+// at ele ser trocado, a raiz antiga  a que vale (e uma troca interrompida  concluda na retomada)
+void trocar_arvore_bmais(ArvoreBmais *a) {
+    const char *sufixos[3] = {"dados", "indice", "meta"};
+    char nomes[3][TAM_CAMINHO], nome_tmp[TAM_CAMINHO];
+    int pendentes = 0;
+    for (int i = 0; i < 3; i++) {
+        nome_arquivo_arvore(a, sufixos[i], nomes[i]);
+        montar_caminho(nome_tmp, sizeof(nome_tmp), "%s.tmp", nomes[i]);
+        pendentes += arquivo_existe(nome_tmp);
+    }
+    if (pendentes == 0) return;
+
+    fechar_arquivo_pool(a->f_dados);
+    fechar_arquivo_pool(a->f_indice);
+    fechar_arquivo_pool(a->f_metadados);
+    for (int i = 0; i < 3; i++) {
+        trocar_arquivo_tmp(nomes[i]);
+    }
+    a->f_dados = abrir_arquivo_bmais(nomes[0], tamanho_no_dados());
+    a->f_indice = abrir_arquivo_bmais(nomes[1], tamanho_no());
+    a->f_metadados = abrir_arquivo_bmais(nomes[2], tamanho_metadados());
+}
+
+// Importao sobre uma rvore que j tem dados: as folhas existentes (uma passada sequencial pela lista
+// de folhas) so intercaladas com as entradas novas j ordenadas e a rvore  reconstruda em lote nos
+// temporrios (gravar_arvore_bmais_tmp).
+int mesclar_arvore_bmais(ArvoreBmais *a, FonteEntradasNota *novas) {
+    // O total de entradas antigas  contado numa passada s pelas folhas, antes da intercalao
+    LeitorFolhasBmais leitor;
+    EntradaIndiceNota descartada;
+    long qtd_antigas = 0;
+    leitor_folhas_iniciar(&leitor, a->f_metadados, a->f_dados, 0);
+    while (leitor_folhas_proximo(&leitor, &descartada)) qtd_antigas++;
+    leitor_folhas_iniciar(&leitor, a->f_metadados, a->f_dados, 0);
+
+    FonteEntradasNota antigas = { .total = qtd_antigas, .proximo = leitor_folhas_proximo, .estado = &leitor };
+    MesclaEntradasNota mescla;
+    FonteEntradasNota fonte = fonte_de_mescla(&mescla, &antigas, novas);
+    return gravar_arvore_bmais_tmp(a, &fonte);
+}
+
+// Apaga os arquivos B+ da rvore e os recria vazios (as notas passaram para o ndice LSM)
+void esvaziar_arvore_bmais(ArvoreBmais *a) {
+    if (arvore_bmais_vazia(a->f_metadados)) return;
+    const char *sufixos[3] = {"dados", "indice", "meta"};
+    char nomes[3][TAM_CAMINHO];
+    fechar_arquivo_pool(a->f_dados);
+    fechar_arquivo_pool(a->f_indice);
+    fechar_arquivo_pool(a->f_metadados);
+    // Metadados primeiro: sem ele a rvore j  lida como vazia
+    for (int i = 2; i >= 0; i--) {
+        nome_arquivo_arvore(a, sufixos[i], nomes[i]);
+        remove(nomes[i]);
+    }
+    a->f_dados = abrir_arquivo_bmais(nomes[0], tamanho_no_dados());
+    a->f_indice = abrir_arquivo_bmais(nomes[1], tamanho_no());
+    a->f_metadados = abrir_arquivo_bmais(nomes[2], tamanho_metadados());
+}
+
+// Retorna 1 se a rvore de nota no tem nenhuma entrada, no motor que ela usa
+int indice_nota_vazio(ArvoreBmais *a) {
+    if (a->motor == MOTOR_LSM) return a->lsm.manifesto.qtd_runs == 0;
+    return arvore_bmais_vazia(a->f_metadados);
+}
+
+const char *nome_motor_indice(int motor) {
+    return motor == MOTOR_LSM ? "LSM" : "Arvore B+";
+}
+
+// Troca o motor de uma rvore vazia: cria o manifesto LSM ou o apaga (os arquivos B+ sempre existem)
+void aplicar_motor_indice_nota(ArvoreBmais *a, int motor) {
+    if (a->motor == motor) return;
+    if (motor == MOTOR_LSM) {
+        lsm_criar(&a->lsm);
+    } else {
+        lsm_remover(&a->lsm);
+    }
+    a->motor = motor;
+}
+
+// Converte o nome da nota ("cn", "ch", "lc", "mt", "red") no ndice da rvore; -1 se no reconhecido
+int indice_tipo_nota(const char *tipo_nota) {
+    const char *nomes[] = {"cn", "ch", "lc", "mt", "red"};
+    for (int i = 0; i < 5; i++) {
+        if (strcmp(tipo_nota, nomes[i]) == 0) return i;
+    }
+    return -1;
+}
+
+// Percorre as entradas de uma rvore de nota em ordem (crescente ou decrescente), qualquer que seja o motor
+typedef struct {
+    int motor;
+    LeitorFolhasBmais folhas;
+    LeitorLsm lsm;
+    VersaoLsm *versao_lsm; // Segura as runs lidas at cursor_nota_fechar
+    // Runs dos segmentos parciais de um READ em segundo plano, intercaladas com a rvore
+    int com_parciais;
+    LeitorLsm parciais;
+    FonteEntradasNota fonte_arvore;
+    FonteEntradasNota fonte_parciais;
+    MesclaEntradasNota mescla;
+} CursorNota;
+
+void cursor_nota_fechar(CursorNota *c);
+
+int cursor_nota_abrir(CursorNota *c, ArvoreBmais *a, int decrescente) {
+    c->motor = a->motor;
+    c->com_parciais = 0;
+    if (c->motor == MOTOR_LSM) {
+        c->versao_lsm = lsm_adquirir_versao(&a->lsm);
+        if (!c->versao_lsm) return 1;
+        ManifestoLsm *m = &c->versao_lsm->manifesto;
+        int erro = leitor_lsm_abrir(&c->lsm, c->versao_lsm->nome, m, 0, m->qtd_runs, decrescente);
+        if (erro) cursor_nota_fechar(c);
+        return erro;
+    }
+    leitor_folhas_iniciar(&c->folhas, a->f_metadados, a->f_dados, decrescente);
+    return 0;
+}
+
+// Prxima entrada s da rvore (mesma assinatura de FonteEntradasNota.proximo)
+int cursor_nota_proximo_arvore(void *estado, EntradaIndiceNota *destino) {
+    CursorNota *c = (CursorNota *)estado;
+    if (c->motor == MOTOR_LSM) return leitor_lsm_proximo(&c->lsm, destino);
+    return leitor_folhas_proximo(&c->folhas, destino);
+}
+
+// Junta ao cursor j aberto as runs do manifesto `m`, de prefixo `prefixo`. Retorna 0 em caso de sucesso
+// (em caso de erro o cursor  fechado)
+int cursor_nota_incluir_parciais(CursorNota *c, const char *prefixo, const ManifestoLsm *m, int decrescente) {
+    if (leitor_lsm_abrir(&c->parciais, prefixo, m, 0, m->qtd_runs, decrescente) != 0) {
+        leitor_lsm_fechar(&c->parciais);
+        cursor_nota_fechar(c);
+        return 1;
+    }
+    c->com_parciais = 1;
+    FonteEntradasNota arvore = { .total = 0, .proximo = cursor_nota_proximo_arvore, .estado = c };
+    FonteEntradasNota parciais = { .total = 0, .proximo = leitor_lsm_proximo, .estado = &c->parciais };
+    c->fonte_arvore = arvore;
+    c->fonte_parciais = parciais;
+    fonte_de_mescla(&c->mescla, &c->fonte_arvore, &c->fonte_parciais);
+    c->mescla.decrescente = decrescente;
+    return 0;
+}
+
+int cursor_nota_proximo(CursorNota *c, EntradaIndiceNota *destino) {
+    if (c->com_parciais) return mescla_proximo(&c->mescla, destino);
+    return cursor_nota_proximo_arvore(c, destino);
+}
+
+void cursor_nota_fechar(CursorNota *c) {
+    if (c->com_parciais) {
+        leitor_lsm_fechar(&c->parciais);
+        c->com_parciais = 0;
+    }
+    if (c->motor != MOTOR_LSM) return;
+    leitor_lsm_fechar(&c->lsm);
+    lsm_liberar_versao(c->versao_lsm);
+    c->versao_lsm = NULL;
+}
+
+// Grava o participante, compactado, no fim dos dois arquivos de colunas (participantes.bin e
+// participantes_respostas.bin), sem tocar nos ndices
+int gravar_participante(FILE *fp_participantes, FILE *fp_respostas, HeaderParticipantes *h, const Participante *p) {
+    int indice_registro = h->qtd_registros;
+    RegistroParticipante registro;
+    RespostasParticipante respostas;
+    RegistroCompacto r;
+    RespostasCompactas resp;
+    separar_participante(p, &registro, &respostas);
+    compactar_registro(&registro, &r);
+    compactar_respostas(&respostas, &resp);
+
+    if (ESCRITA_EM_TRANSACAO) {
+        // Os arquivos j esto posicionados no fim; o cabealho fica em memria at o commit
+        fwrite(&r, tamanho_participante(), 1, fp_participantes);
+        fwrite(&resp, tamanho_respostas(), 1, fp_respostas);
+        h->qtd_registros++;
+        return indice_registro;
+    }
+
+
+    fseek(fp_respostas, tamanho_header() + (long)indice_registro * tamanho_respostas(), SEEK_SET);
+    fwrite(&resp, tamanho_respostas(), 1, fp_respostas);
+    long offset = tamanho_header() + indice_registro * tamanho_participante();
+    fseek(fp_participantes, offset, SEEK_SET);
+    fwrite(&r, tamanho_participante(), 1, fp_participantes);
+
+    h->qtd_registros++;
+    // Respostas primeiro: o cabealho de participantes.bin  o que torna o registro visvel
+    fseek(fp_respostas, 0, SEEK_SET);
+    fwrite(h, tamanho_header(), 1, fp_respostas);
+    fflush(fp_respostas);
+    fseek(fp_participantes, 0, SEEK_SET);
+    fwrite(h, tamanho_header(), 1, fp_participantes);
+    fflush(fp_participantes);
+
+    return indice_registro;
+}
+
+// Arquivo inteiro mapeado em memria (somente leitura)
+typedef struct {
+    char *dados;
+    size_t tamanho;
+#ifndef _WIN32
+    int fd;
+#endif
+} ArquivoMapeado;
+
+// Mapeia o arquivo inteiro. Retorna 0 em caso de sucesso.
+// Sem mmap (Windows), o arquivo  lido inteiro para um buffer.
+int mapear_arquivo(const char *nome, ArquivoMapeado *m) {
+    m->dados = NULL;
+    m->tamanho = 0;
+#ifndef _WIN32
+    m->fd = open(nome, O_RDONLY);
+    if (m->fd < 0) return 1;
+    struct stat st;
+    if (fstat(m->fd, &st) != 0) {
+        close(m->fd);
+        return 1;
+    }
+    m->tamanho = (size_t)st.st_size;
+    if (m->tamanho == 0) return 0;
+    m->dados = (char *)mmap(NULL, m->tamanho, PROT_READ, MAP_PRIVATE, m->fd, 0);
+    if (m->dados == MAP_FAILED) {
+        m->dados = NULL;
+        close(m->fd);
+        return 1;
+    }
+    madvise(m->dados, m->tamanho, MADV_SEQUENTIAL);
+#else
+    FILE *f = fopen(nome, "rb");
+    if (!f) return 1;
+    fseek(f, 0, SEEK_END);
+    m->tamanho = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (m->tamanho == 0) { fclose(f); return 0; }
+    m->dados = (char *)malloc(m->tamanho);
+    if (!m->dados || fread(m->dados, 1, m->tamanho, f) != m->tamanho) {
+        free(m->dados);
+        m->dados = NULL;
+        fclose(f);
+        return 1;
+    }
+    fclose(f);
+#endif
+    return 0;
+}
+
+void desmapear_arquivo(ArquivoMapeado *m) {
+#ifndef _WIN32
+    if (m->dados) munmap(m->dados, m->tamanho);
+    close(m->fd);
+#else
+    free(m->dados);
+#endif
+    m->dados = NULL;
+    m->tamanho = 0;
+}
+
+// Dica de acesso ao mapeamento: sequencial (SHOW) ou aleatrio (leituras guiadas por um ndice)
+void aconselhar_acesso_mapeado(ArquivoMapeado *m, int sequencial) {
+#ifndef _WIN32
+    if (m->dados) madvise(m->dados, m->tamanho, sequencial ? MADV_SEQUENTIAL : MADV_RANDOM);
+#else
+    (void)m;
+    (void)sequencial;
+#endif
+}
+
+// Registro `indice` de um arquivo de registros fixos mapeado, ou NULL se est fora do mapeamento
+const void *registro_mapeado(const ArquivoMapeado *m, long tamanho_header, long tamanho_registro, int indice) {
+    if (!m->dados || indice < 0) return NULL;
+    size_t offset = (size_t)tamanho_header + (size_t)indice * (size_t)tamanho_registro;
+    if (offset + (size_t)tamanho_registro > m->tamanho) return NULL;
+    return m->dados + offset;
+}
+
+/************************************************ VERSES DE LEITURA ************************************************/
+
+// SHOW, FIND, FILTER e LIST leem sempre de uma verso da base: arquivos abertos s para leitura e os
+// cabealhos de um mesmo instante. Sem READ em segundo plano a verso  aberta na hora do comando; com
+// ele (CONFIG SEGUNDOPLANO), o READ publica a base como estava antes dele, uma verso a cada checkpoint
+// e, quando todos os ndices esto gravados, a base nova; os comandos usam a ltima publicada sem esperar
+// a importao. At o fim os ndices da base s cobrem os participantes de antes do READ: a verso de um
+// checkpoint leva tambm segmentos parciais, com ndices prprios dos participantes confirmados depois
+// disso, que LIST, FIND e FILTER juntam aos da base. Assim SHOW e as buscas veem os mesmos participantes.
+// Os arquivos que o READ troca inteiros (rvores, runs LSM, Trie, ndice por Estado) entram por rename:
+// quem ainda tem a verso anterior segue lendo os arquivos antigos. Nos que s crescem (participantes,
+// localizaes, gabaritos, colunas extras), os cabealhos copiados limitam o que  visvel.
+// Com LEITURA_MAPEADA, participantes, localizaes e gabaritos so mapeados na abertura da verso e
+// lidos por ponteiro direto no mapeamento, sem fseek/fread por registro.
+
+// 1: mmap (padro fora do Windows); 0: fseek + fread no buffer do chamador (CONFIG LEITURA)
+#ifndef _WIN32
+int LEITURA_MAPEADA = 1;
+#else
+int LEITURA_MAPEADA = 0;
+#endif
+
+#define MAX_SEGMENTOS_PARCIAIS MAX_RUNS_LSM
+
+// Participantes de um READ em segundo plano confirmados em checkpoints, [primeiro, primeiro + qtd), com os
+// ndices gravados  parte: uma run no formato LSM por rvore de nota, os NU_SEQ ordenados e os ndices
+// agrupados por Estado. No muda depois de gravado; os arquivos so apagados quando a ltima verso que o
+// usa  liberada
+typedef struct {
+    int refs;
+    int id;
+    int primeiro;
+    int qtd;
+    int qtd_nuseq; // Sem os NU_SEQ que a Trie recusa
+    int inicio_estado[QTD_ESTADOS]; // Trecho de cada Estado (posio da tabela hash) no arquivo de Estados
+    int qtd_estado[QTD_ESTADOS];
+    char prefixo[TAM_CAMINHO];
+} SegmentoParcial;
+
+// Entrada do arquivo de NU_SEQ de um segmento, ordenado por NU_SEQ e, no empate, pelo ndice do registro
+typedef struct {
+    char nu_seq[15];
+    int indice_registro;
+} EntradaNuSeq;
+
+pthread_mutex_t mutex_segmentos_parciais = PTHREAD_MUTEX_INITIALIZER;
+
+// Prefixo das runs de nota do segmento para a rvore `arvore` (como o de um IndiceLsm)
+void prefixo_notas_parcial(const SegmentoParcial *s, const char *arvore, char *destino) {
+    montar_caminho(destino, TAM_CAMINHO, "%s_%s", s->prefixo, arvore);
+}
+
+void nome_arquivo_parcial(const SegmentoParcial *s, const char *tipo, char *destino) {
+    montar_caminho(destino, TAM_CAMINHO, "%s_%s_%d.dat", s->prefixo, tipo, s->id);
+}
+
+void apagar_segmento_parcial(const SegmentoParcial *s) {
+    char nome[TAM_CAMINHO];
+    RunLsm run = { .id = s->id, .qtd = s->qtd };
+    for (int i = 0; i < 5; i++) {
+        prefixo_notas_parcial(s, arvores[i].nome, nome);
+        lsm_remover_runs(nome, &run, 1);
+    }
+    nome_arquivo_parcial(s, "nuseq", nome);
+    remove(nome);
+    nome_arquivo_parcial(s, "estado", nome);
+    remove(nome);
+}
+
+SegmentoParcial *reter_segmento_parcial(SegmentoParcial *s) {
+    pthread_mutex_lock(&mutex_segmentos_parciais);
+    s->refs++;
+    pthread_mutex_unlock(&mutex_segmentos_parciais);
+    return s;
+}
+
+void liberar_segmento_parcial(SegmentoParcial *s) {
+    if (!s) return;
+    pthread_mutex_lock(&mutex_segmentos_parciais);
+    int refs = --s->refs;
+    pthread_mutex_unlock(&mutex_segmentos_parciais);
+    if (refs == 0) {
+        apagar_segmento_parcial(s);
+        free(s);
+    }
+}
+
+typedef struct {
+    int refs; // Publicao + leitores usando a verso; fechada quando chega a 0
+    FILE *fp_participantes;
+    HeaderParticipantes header;
+    FILE *fp_respostas;
+    HeaderParticipantes header_respostas;
+    FILE *fp_loc;
+    HeaderLocalizacao header_loc;
+    FILE *fp_gab;
+    HeaderProva header_gab;
+    FILE *fp_extra; // NULL se no h colunas extras
+    HeaderExtras header_extra;
+    FILE *fp_trie;
+    HeaderTrie header_trie;
+    FILE *fp_reg_est;
+    HeaderRegistroEstado header_reg_est;
+    ArvoreBmais arvores[5]; // Motor e manifesto LSM lidos do disco; arquivos B+ prprios (sem o de ndice)
+    ArquivoMapeado mapa_participantes; // Vazios sem LEITURA_MAPEADA
+    ArquivoMapeado mapa_respostas;
+    ArquivoMapeado mapa_loc;
+    ArquivoMapeado mapa_gab;
+    // Segmentos do READ em segundo plano, do mais antigo ao mais novo, logo depois dos ndices da base
+    int qtd_parciais;
+    SegmentoParcial *parciais[MAX_SEGMENTOS_PARCIAIS];
+} VersaoLeitura;
+
+VersaoLeitura *VERSAO_PUBLICADA = NULL; // S h verso publicada durante um READ em segundo plano
+pthread_mutex_t mutex_versao_leitura = PTHREAD_MUTEX_INITIALIZER;
+
+// Abre um arquivo da base s para leitura e l o cabealho. Retorna NULL se ele no existe
+FILE *abrir_leitura_com_cabecalho(const char *nome, void *header, long tamanho) {
+    FILE *fp = fopen(nome, "rb");
+    if (fp && fread(header, tamanho, 1, fp) != 1) {
+        fclose(fp);
+        return NULL;
+    }
+    return fp;
+}
+
+// Mapeia um arquivo de registros fixos da verso. Sem LEITURA_MAPEADA (ou se o mapeamento falha) o mapa
+// fica vazio e os registros so lidos com fread
+void mapear_registros_versao(FILE *fp, const char *nome, ArquivoMapeado *m, int sequencial) {
+    m->dados = NULL;
+    m->tamanho = 0;
+#ifndef _WIN32
+    m->fd = -1;
+    if (!fp || !LEITURA_MAPEADA) return;
+    if (mapear_arquivo(nome, m) != 0) {
+        m->dados = NULL;
+        m->fd = -1;
+        return;
+    }
+    aconselhar_acesso_mapeado(m, sequencial);
+#else
+    (void)fp;
+    (void)nome;
+    (void)sequencial;
+#endif
+}
+
+void desmapear_registros_versao(ArquivoMapeado *m) {
+#ifndef _WIN32
+    if (m->fd >= 0) desmapear_arquivo(m);
+#else
+    (void)m;
+#endif
+}
+
+void fechar_versao_leitura(VersaoLeitura *v) {
+    desmapear_registros_versao(&v->mapa_participantes);
+    desmapear_registros_versao(&v->mapa_respostas);
+    desmapear_registros_versao(&v->mapa_loc);
+    desmapear_registros_versao(&v->mapa_gab);
+    if (v->fp_participantes) fclose(v->fp_participantes);
+    if (v->fp_respostas) fclose(v->fp_respostas);
+    if (v->fp_loc) fclose(v->fp_loc);
+    if (v->fp_gab) fclose(v->fp_gab);
+    if (v->fp_extra) fclose(v->fp_extra);
+    if (v->fp_trie) fechar_arquivo_pool(v->fp_trie);
+    if (v->fp_reg_est) fechar_arquivo_pool(v->fp_reg_est);
+    for (int i = 0; i < 5; i++) {
+        if (v->arvores[i].f_metadados) fechar_arquivo_pool(v->arvores[i].f_metadados);
+        if (v->arvores[i].f_dados) fechar_arquivo_pool(v->arvores[i].f_dados);
+        lsm_liberar_versao(v->arvores[i].lsm.versao);
+    }
+    for (int i = 0; i < v->qtd_parciais; i++) {
+        liberar_segmento_parcial(v->parciais[i]);
+    }
+    free(v);
+}
+
+// Abre todos os arquivos como esto agora. S deve ser chamada quando nenhum deles est sendo trocado:
+// pela thread do READ nos pontos de publicao, ou pela thread principal sem READ em segundo plano
+VersaoLeitura *abrir_versao_leitura() {
+    VersaoLeitura *v = (VersaoLeitura *)calloc(1, sizeof(VersaoLeitura));
+    if (!v) { perror("Erro ao alocar versao de leitura"); exit(1); }
+    v->refs = 1;
+    // Participantes por ltimo: o cabealho dele  o que decide quais registros so visveis
+    v->fp_loc = abrir_leitura_com_cabecalho(nome_localizacao_bin, &v->header_loc, tamanho_header_localizacao());
+    v->fp_gab = abrir_leitura_com_cabecalho(nome_gabarito_bin, &v->header_gab, tamanho_header_prova());
+    v->fp_extra = abrir_leitura_com_cabecalho(nome_extras_bin, &v->header_extra, tamanho_header_extras());
+    v->fp_respostas = abrir_leitura_com_cabecalho(nome_respostas_bin, &v->header_respostas, tamanho_header());
+    v->fp_trie = abrir_leitura_com_cabecalho(nome_trie_bin, &v->header_trie, tamanho_header_trie());
+    v->fp_reg_est = abrir_leitura_com_cabecalho(nome_registro_estado_bin, &v->header_reg_est, tamanho_header_registro_estado());
+    for (int i = 0; i < 5; i++) {
+        ArvoreBmais *a = &v->arvores[i];
+        char nome_meta[TAM_CAMINHO], nome_dados[TAM_CAMINHO];
+        montar_caminho(a->nome, sizeof(a->nome), "%s", arvores[i].nome);
+        nome_arquivo_arvore(a, "meta", nome_meta);
+        nome_arquivo_arvore(a, "dados", nome_dados);
+        a->f_metadados = fopen(nome_meta, "rb");
+        a->f_dados = fopen(nome_dados, "rb");
+        caminho_na_base(a->lsm.nome, sizeof(a->lsm.nome), a->nome);
+        // O manifesto LSM publicado, que a compactao no troca enquanto a verso o segura
+        a->lsm.versao = lsm_adquirir_versao(&arvores[i].lsm);
+        if (a->lsm.versao) a->lsm.manifesto = a->lsm.versao->manifesto;
+        a->motor = a->lsm.versao ? MOTOR_LSM : MOTOR_BMAIS;
+    }
+    v->fp_participantes = abrir_leitura_com_cabecalho(nome_participantes_bin, &v->header, tamanho_header());
+    // Mapeados depois dos cabealhos: todo registro visvel j est dentro do mapeamento
+    mapear_registros_versao(v->fp_loc, nome_localizacao_bin, &v->mapa_loc, 0);
+    mapear_registros_versao(v->fp_gab, nome_gabarito_bin, &v->mapa_gab, 0);
+    mapear_registros_versao(v->fp_participantes, nome_participantes_bin, &v->mapa_participantes, 0);
+    mapear_registros_versao(v->fp_respostas, nome_respostas_bin, &v->mapa_respostas, 0);
+    return v;
+}
+
+// Verso para um comando de leitura: a publicada, se h, ou uma aberta agora
+VersaoLeitura *adquirir_versao_leitura() {
+    pthread_mutex_lock(&mutex_versao_leitura);
+    VersaoLeitura *v = VERSAO_PUBLICADA;
+    if (v) v->refs++;
+    pthread_mutex_unlock(&mutex_versao_leitura);
+    if (v) return v;
+
+    // Sem READ em segundo plano s a compactao LSM mexe nos ndices, e ela publica um manifesto novo
+    // em vez de apagar as runs que a verso aberta agora vai ler
+    return abrir_versao_leitura();
+}
+
+void liberar_versao_leitura(VersaoLeitura *v) {
+    if (!v) return;
+    pthread_mutex_lock(&mutex_versao_leitura);
+    int refs = --v->refs;
+    pthread_mutex_unlock(&mutex_versao_leitura);
+    if (refs == 0) fechar_versao_leitura(v);
+}
+
+// Troca a verso publicada pela base como est agora (NULL retira a publicao).
+// Os leitores que ainda usam a anterior a fecham ao liber-la.
+void publicar_versao_leitura(VersaoLeitura *nova) {
+    pthread_mutex_lock(&mutex_versao_leitura);
+    VersaoLeitura *antiga = VERSAO_PUBLICADA;
+    VERSAO_PUBLICADA = nova;
+    pthread_mutex_unlock(&mutex_versao_leitura);
+    liberar_versao_leitura(antiga);
+}
+
+// Registros visveis na verso (0 se ainda no h participantes)
+int total_registros_versao(const VersaoLeitura *v) {
+    return v->fp_participantes ? v->header.qtd_registros : 0;
+}
+
+// Cursor da rvore de nota `indice` da verso, com as runs dos segmentos parciais intercaladas
+int cursor_nota_abrir_versao(CursorNota *c, VersaoLeitura *v, int indice, int decrescente) {
+    if (cursor_nota_abrir(c, &v->arvores[indice], decrescente) != 0) return 1;
+    if (v->qtd_parciais == 0) return 0;
+    ManifestoLsm m;
+    memset(&m, 0, sizeof(m));
+    m.qtd_runs = v->qtd_parciais;
+    for (int i = 0; i < v->qtd_parciais; i++) {
+        m.runs[i].id = v->parciais[i]->id;
+        m.runs[i].qtd = v->parciais[i]->qtd;
+    }
+    char prefixo[TAM_CAMINHO];
+    prefixo_notas_parcial(v->parciais[0], v->arvores[indice].nome, prefixo);
+    return cursor_nota_incluir_parciais(c, prefixo, &m, decrescente);
+}
+
+// ndice do participante de NU_SEQ `nu_seq` nos segmentos parciais, ou -1. Como na Trie, um NU_SEQ
+// repetido fica com o ltimo participante: os segmentos so vistos do mais novo para o mais antigo
+int buscar_nuseq_parciais(const VersaoLeitura *v, const char *nu_seq) {
+    for (int i = v->qtd_parciais - 1; i >= 0; i--) {
+        const SegmentoParcial *s = v->parciais[i];
+        char nome[TAM_CAMINHO];
+        nome_arquivo_parcial(s, "nuseq", nome);
+        FILE *f = fopen(nome, "rb");
+        if (!f) continue;
+        // Busca binria pela primeira entrada maior que `nu_seq`; a anterior  a ltima igual, se houver
+        EntradaNuSeq e;
+        int ini = 0, fim = s->qtd_nuseq;
+        while (ini < fim) {
+            int meio = ini + (fim - ini) / 2;
+            if (fseek(f, (long)meio * (long)sizeof(EntradaNuSeq), SEEK_SET) != 0 || fread(&e, sizeof(e), 1, f) != 1) break;
+            if (strcmp(e.nu_seq, nu_seq) <= 0) {
+                ini = meio + 1;
+            } else {
+                fim = meio;
+            }
+        }
+        int achado = -1;
+        if (ini == fim && ini > 0 && fseek(f, (long)(ini - 1) * (long)sizeof(EntradaNuSeq), SEEK_SET) == 0 &&
+            fread(&e, sizeof(e), 1, f) == 1 && strcmp(e.nu_seq, nu_seq) == 0) {
+            achado = e.indice_registro;
+        }
+        fclose(f);
+        if (achado != -1) return achado;
+    }
+    return -1;
+}
+
+// Participantes do Estado na verso: os do ndice da base seguidos dos de cada segmento parcial
+int total_estado_versao(const VersaoLeitura *v, int hash_index) {
+    int total = v->fp_reg_est ? v->header_reg_est.tabela_hash[hash_index].qtd : 0;
+    for (int i = 0; i < v->qtd_parciais; i++) {
+        total += v->parciais[i]->qtd_estado[hash_index];
+    }
+    return total;
+}
+
+// L `qtd` ndices do Estado a partir da posio `pos` dessa sequncia. Retorna quantos leu
+int ler_indices_estado_versao(VersaoLeitura *v, int hash_index, int pos, int qtd, int *destino) {
+    int lidos = 0;
+    int qtd_base = v->fp_reg_est ? v->header_reg_est.tabela_hash[hash_index].qtd : 0;
+    if (pos < qtd_base) {
+        int n = MIN(qtd, qtd_base - pos);
+        lidos = ler_indices_estado(v->fp_reg_est, &v->header_reg_est, hash_index, pos, n, destino);
+        if (lidos < n) return lidos;
+        pos = 0;
+    } else {
+        pos -= qtd_base;
+    }
+    for (int i = 0; i < v->qtd_parciais && lidos < qtd; i++) {
+        const SegmentoParcial *s = v->parciais[i];
+        if (pos >= s->qtd_estado[hash_index]) {
+            pos -= s->qtd_estado[hash_index];
+            continue;
+        }
+        int n = MIN(qtd - lidos, s->qtd_estado[hash_index] - pos);
+        char nome[TAM_CAMINHO];
+        nome_arquivo_parcial(s, "estado", nome);
+        FILE *f = fopen(nome, "rb");
+        if (!f) break;
+        size_t lidos_segmento = 0;
+        if (fseek(f, (long)(s->inicio_estado[hash_index] + pos) * (long)sizeof(int), SEEK_SET) == 0) {
+            lidos_segmento = fread(destino + lidos, sizeof(int), n, f);
+        }
+        fclose(f);
+        lidos += (int)lidos_segmento;
+        if ((int)lidos_segmento < n) break;
+        pos = 0;
+    }
+    return lidos;
+}
+
+// L e decodifica as colunas de participantes.bin do participante de ndice `indice` no buffer do chamador.
+// Retorna destino, ou NULL se no existe
+RegistroParticipante *ler_participante_em(FILE *fp_participantes, int indice, RegistroParticipante *destino) {
+    RegistroCompacto c;
+    long offset = tamanho_header() + indice * tamanho_participante();
+    if (fseek(fp_participantes, offset, SEEK_SET) != 0) return NULL;
+    if (fread(&c, tamanho_participante(), 1, fp_participantes) != 1) return NULL;
+    descompactar_registro(&c, destino);
+    return destino;
+}
+
+// O mesmo para as respostas (participantes_respostas.bin)
+RespostasParticipante *ler_respostas_em(FILE *fp_respostas, int indice, RespostasParticipante *destino) {
+    if (!fp_respostas) return NULL;
+    RespostasCompactas c;
+    long offset = tamanho_header() + (long)indice * tamanho_respostas();
+    if (fseek(fp_respostas, offset, SEEK_SET) != 0) return NULL;
+    if (fread(&c, tamanho_respostas(), 1, fp_respostas) != 1) return NULL;
+    descompactar_respostas(&c, destino);
+    return destino;
+}
+
+// Participantes e respostas so sempre decodificados em destino (do mapeamento da verso ou, sem ele, do
+// arquivo). Localizao e gabarito devolvem um ponteiro direto no mapeamento, que vale enquanto a verso
+// no  liberada, ou o registro lido em destino.
+const RegistroParticipante *ler_participante_versao(VersaoLeitura *v, int indice, RegistroParticipante *destino) {
+    const RegistroCompacto *c = registro_mapeado(&v->mapa_participantes, tamanho_header(), tamanho_participante(), indice);
+    if (!c) return ler_participante_em(v->fp_participantes, indice, destino);
+    descompactar_registro(c, destino);
+    return destino;
+}
+
+// Respostas em branco para um registro que no est em participantes_respostas.bin
+const RespostasParticipante RESPOSTAS_AUSENTES = {"", "", "", ""};
+
+// Nunca NULL: sem o registro devolve RESPOSTAS_AUSENTES
+const RespostasParticipante *ler_respostas_versao(VersaoLeitura *v, int indice, RespostasParticipante *destino) {
+    const RespostasCompactas *c = registro_mapeado(&v->mapa_respostas, tamanho_header(), tamanho_respostas(), indice);
+    if (c) {
+        descompactar_respostas(c, destino);
+        return destino;
+    }
+    const RespostasParticipante *r = ler_respostas_em(v->fp_respostas, indice, destino);
+    return r ? r : &RESPOSTAS_AUSENTES;
+}
+
+const Localizacao *buscar_localizacao_versao(VersaoLeitura *v, int indice, Localizacao *destino) {
+    const Localizacao *loc = registro_mapeado(&v->mapa_loc, tamanho_header_localizacao(), tamanho_localizacao(), indice);
+    return loc ? loc : buscar_localizacao_em(v->fp_loc, indice, destino);
+}
+
+const Prova *buscar_gabarito_versao(VersaoLeitura *v, int indice, Prova *destino) {
+    const Prova *prova = registro_mapeado(&v->mapa_gab, tamanho_header_prova(), tamanho_prova(), indice);
+    return prova ? prova : buscar_gabarito_em(v->fp_gab, indice, destino);
+}
+
+/************************************************ LEITURA DO CSV ************************************************/
+
+#define MAX_COLUNAS_CSV 128 // Colunas lidas por linha; as demais so ignoradas
+
+// Campos usados do CSV de resultados. A coluna de cada um  achada pelo nome no cabealho,
+// ento tanto o RESULTADOS_2024.csv original quanto a sada do limpeza.py so aceitos.
+#define CAMPO_NU_SEQ 0
+#define CAMPO_ANO 1
+#define CAMPO_CO_ESCOLA 2
+#define CAMPO_NO_MUNICIPIO_ESC 3
+#define CAMPO_SG_UF_ESC 4
+#define CAMPO_CO_PROVA_CN 5       // CO_PROVA CN, CH, LC, MT em sequncia
+#define CAMPO_NU_NOTA_CN 9        // NOTAS CN, CH, LC, MT em sequncia
+#define CAMPO_TX_RESPOSTAS_CN 13  // RESPOSTAS CN, CH, LC, MT em sequncia
+#define CAMPO_TP_LINGUA 17
+#define CAMPO_TX_GABARITO_CN 18   // GABARITOS CN, CH, LC, MT em sequncia
+#define CAMPO_NU_NOTA_REDACAO 22
+#define QTD_CAMPOS_CSV 23
+
+// Descrio de uma coluna do CSV: nome no cabealho, tipo e onde o valor  gravado
+typedef struct {
+    const char *nome;
+    int tipo;       // TIPO_CAMPO_*
+    size_t offset;  // Posio do valor na LinhaCsv (ou no registro de colunas extras)
+    size_t tamanho; // Bytes do destino (texto: inclui o '\0')
+    double nulo;    // Valor gravado para um nmero vazio
+    int opcional;   // Pode faltar no cabealho (e fica fora das regras de CONFIG LIMPEZA)
+} DescritorCampoCsv;
+
+// Coluna de cada campo no arquivo sendo lido (-1 se ausente) e a codificao do texto
+typedef struct {
+    int coluna[QTD_CAMPOS_CSV];
+    int qtd_extras; // Colunas extras projetadas (participantes_extra.bin)
+    int coluna_extra[MAX_COLUNAS_EXTRAS];
+    DescritorCampoCsv extras[MAX_COLUNAS_EXTRAS];
+    int qtd_minima_colunas; // Uma linha com menos colunas que isso est incompleta
+    int latin1;             // 1 se o texto vem em latin1 e deve ser convertido para UTF-8
+} MapaColunasCsv;
+
+// Regras do limpeza.py aplicadas durante a leitura (CONFIG LIMPEZA): com 1, uma linha com
+// qualquer campo vazio  descartada (dropna); com 0, o campo vazio vira nulo e a linha fica
+int LIMPEZA_IMPORTACAO = 0;
+
+// Valor gravado no lugar de um campo vazio
+#define NOTA_AUSENTE -1.0f
+
+// Fatia de um campo dentro do buffer do CSV (sem cpia). tamanho == 0  um campo vazio (nulo).
+typedef struct {
+    const char *inicio;
+    int tamanho;
+} CampoCsv;
+
+// Posio corrente da leitura dentro do CSV mapeado
+typedef struct {
+    const char *pos;
+    const char *fim;
+} LeitorCsv;
+
+// Marca com 0x80 os bytes da palavra iguais ao byte repetido em 'padrao'.
+// S o bit mais baixo marcado  garantido (basta para achar o primeiro delimitador).
+#define BYTES_REPETIDOS(b) (0x0101010101010101ULL * (unsigned char)(b))
+static inline uint64_t marca_bytes_iguais(uint64_t palavra, uint64_t padrao) {
+    uint64_t x = palavra ^ padrao;
+    return (x - 0x0101010101010101ULL) & ~x & 0x8080808080808080ULL;
+}
+
+// Procura o prximo ';' ou '\n' a partir de p, testando 8 bytes por vez
+const char *proximo_delimitador_csv(const char *p, const char *fim) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (p + 8 <= fim) {
+        uint64_t palavra;
+        memcpy(&palavra, p, 8);
+        uint64_t marcas = marca_bytes_iguais(palavra, BYTES_REPETIDOS(';')) | marca_bytes_iguais(palavra, BYTES_REPETIDOS('\n'));
+        if (marcas) {
+            return p + (__builtin_ctzll(marcas) >> 3);
+        }
+        p += 8;
+    }
+#endif
+    while (p < fim && *p != ';' && *p != '\n') p++;
+    return p;
+}
+
+// Separa a prxima linha em campos. Retorna a quantidade de campos, ou -1 no fim do arquivo.
+// Ao chegar em max_campos o resto da linha  pulado sem ser separado (e o retorno  max_campos).
+int proxima_linha_csv(LeitorCsv *l, CampoCsv *campos, int max_campos) {
+    if (l->pos >= l->fim) return -1;
+
+    int qtd = 0;
+    const char *p = l->pos;
+    while (1) {
+        const char *d = proximo_delimitador_csv(p, l->fim);
+        if (qtd < max_campos) {
+            campos[qtd].inicio = p;
+            campos[qtd].tamanho = (int)(d - p);
+        }
+        qtd++;
+        if (d >= l->fim || *d == '\n') {
+            l->pos = (d >= l->fim) ? l->fim : d + 1;
+            break;
+        }
+        if (qtd == max_campos) {
+            // Nenhuma coluna depois desta  usada: vai direto ao fim da linha
+            const char *nl = memchr(d + 1, '\n', l->fim - (d + 1));
+            l->pos = nl ? nl + 1 : l->fim;
+            return qtd;
+        }
+        p = d + 1;
+    }
+
+    // Fim de linha no formato Windows (\r\n)
+    int ultimo = MIN(qtd, max_campos) - 1;
+    if (ultimo >= 0 && ultimo == qtd - 1 && campos[ultimo].tamanho > 0 && campos[ultimo].inicio[campos[ultimo].tamanho - 1] == '\r') {
+        campos[ultimo].tamanho--;
+    }
+    return qtd;
+}
+
+// Copia o campo para um char[] de tamanho fixo (trunca se for maior)
+void copiar_campo_csv(char *destino, size_t tamanho_destino, CampoCsv c) {
+    size_t n = MIN((size_t)c.tamanho, tamanho_destino - 1);
+    memcpy(destino, c.inicio, n);
+    destino[n] = '\0';
+}
+
+// Converte nmeros como "436.8" ou "2024" sem strtod (caminho rpido do formato do ENEM).
+// Outros formatos (sinal, expoente...) caem no strtod. Retorna 0 se o campo no  um nmero.
+int converter_decimal_csv(CampoCsv c, double *valor) {
+    const char *s = c.inicio;
+    int n = c.tamanho, i = 0;
+    long inteiro = 0, fracao = 0, divisor = 1;
+
+    while (i < n && s[i] >= '0' && s[i] <= '9' && i < 15) {
+        inteiro = inteiro * 10 + (s[i] - '0');
+        i++;
+    }
+    int digitos = i;
+    if (i < n && s[i] == '.') {
+        i++;
+        while (i < n && s[i] >= '0' && s[i] <= '9' && divisor < 100000000L) {
+            fracao = fracao * 10 + (s[i] - '0');
+            divisor *= 10;
+            i++;
+            digitos++;
+        }
+    }
+    if (i == n && digitos > 0) {
+        *valor = (double)inteiro + (double)fracao / divisor;
+        return 1;
+    }
+
+    char buffer[64];
+    if (n == 0 || n >= (int)sizeof(buffer)) return 0;
+    memcpy(buffer, s, n);
+    buffer[n] = '\0';
+    char *endptr;
+    *valor = strtod(buffer, &endptr);
+    return endptr == buffer + n;
+}
+
+// Uma linha do CSV j interpretada: o participante e os campos das tabelas separadas
+typedef struct {
+    Participante p;
+    char cod_esc[15];
+    char cidade[40];
+    char estado[20];
+    char cod_prova[4][15]; // CN, CH, LC, MT ("" se vazio)
+    char gabarito[4][60];
+    char extra[TAM_MAX_REGISTRO_EXTRA]; // Registro de colunas extras (s as projetadas)
+} LinhaCsv;
+
+// Destino de um campo dentro da LinhaCsv
+#define CAMPO_LINHA(membro) offsetof(LinhaCsv, membro), sizeof(((LinhaCsv *)0)->membro)
+
+// Esquema dos campos do Participante e das tabelas separadas (mesma ordem dos CAMPO_*)
+const DescritorCampoCsv ESQUEMA_CSV[QTD_CAMPOS_CSV] = {
+    { "NU_SEQUENCIAL",    TIPO_CAMPO_CODIGO,    CAMPO_LINHA(p.nu_seq),      0, 0 },
+    { "NU_ANO",           TIPO_CAMPO_INT,       CAMPO_LINHA(p.ano),         0, 1 }, // A sada do limpeza.py no tem
+    { "CO_ESCOLA",        TIPO_CAMPO_CODIGO,    CAMPO_LINHA(cod_esc),       0, 0 },
+    { "NO_MUNICIPIO_ESC", TIPO_CAMPO_TEXTO,     CAMPO_LINHA(cidade),        0, 0 },
+    { "SG_UF_ESC",        TIPO_CAMPO_TEXTO,     CAMPO_LINHA(estado),        0, 0 },
+    { "CO_PROVA_CN",      TIPO_CAMPO_COD_PROVA, CAMPO_LINHA(cod_prova[0]),  0, 0 },
+    { "CO_PROVA_CH",      TIPO_CAMPO_COD_PROVA, CAMPO_LINHA(cod_prova[1]),  0, 0 },
+    { "CO_PROVA_LC",      TIPO_CAMPO_COD_PROVA, CAMPO_LINHA(cod_prova[2]),  0, 0 },
+    { "CO_PROVA_MT",      TIPO_CAMPO_COD_PROVA, CAMPO_LINHA(cod_prova[3]),  0, 0 },
+    { "NU_NOTA_CN",       TIPO_CAMPO_FLOAT,     CAMPO_LINHA(p.nota_cn),     NOTA_AUSENTE, 0 },
+    { "NU_NOTA_CH",       TIPO_CAMPO_FLOAT,     CAMPO_LINHA(p.nota_ch),     NOTA_AUSENTE, 0 },
+    { "NU_NOTA_LC",       TIPO_CAMPO_FLOAT,     CAMPO_LINHA(p.nota_lc),     NOTA_AUSENTE, 0 },
+    { "NU_NOTA_MT",       TIPO_CAMPO_FLOAT,     CAMPO_LINHA(p.nota_mt),     NOTA_AUSENTE, 0 },
+    { "TX_RESPOSTAS_CN",  TIPO_CAMPO_CODIGO,    CAMPO_LINHA(p.resp_cn),     0, 0 },
+    { "TX_RESPOSTAS_CH",  TIPO_CAMPO_CODIGO,    CAMPO_LINHA(p.resp_ch),     0, 0 },
+    { "TX_RESPOSTAS_LC",  TIPO_CAMPO_CODIGO,    CAMPO_LINHA(p.resp_lc),     0, 0 },
+    { "TX_RESPOSTAS_MT",  TIPO_CAMPO_CODIGO,    CAMPO_LINHA(p.resp_mt),     0, 0 },
+    { "TP_LINGUA",        TIPO_CAMPO_INT,       CAMPO_LINHA(p.ling_est),    -1, 0 },
+    { "TX_GABARITO_CN",   TIPO_CAMPO_CODIGO,    CAMPO_LINHA(gabarito[0]),   0, 0 },
+    { "TX_GABARITO_CH",   TIPO_CAMPO_CODIGO,    CAMPO_LINHA(gabarito[1]),   0, 0 },
+    { "TX_GABARITO_LC",   TIPO_CAMPO_CODIGO,    CAMPO_LINHA(gabarito[2]),   0, 0 },
+    { "TX_GABARITO_MT",   TIPO_CAMPO_CODIGO,    CAMPO_LINHA(gabarito[3]),   0, 0 },
+    { "NU_NOTA_REDACAO",  TIPO_CAMPO_FLOAT,     CAMPO_LINHA(p.nota_red),    NOTA_AUSENTE, 0 },
+};
+
+// Colunas do CSV que podem ser projetadas como colunas extras (CONFIG COLUNAS).
+// O offset  definido na projeo; nmeros vazios viram -1
+const DescritorCampoCsv CATALOGO_COLUNAS_EXTRAS[] = {
+    { "CO_MUNICIPIO_ESC",       TIPO_CAMPO_INT,   0, sizeof(int),   -1, 1 },
+    { "CO_UF_ESC",              TIPO_CAMPO_INT,   0, sizeof(int),   -1, 1 },
+    { "TP_DEPENDENCIA_ADM_ESC", TIPO_CAMPO_INT,   0, sizeof(int),   -1, 1 },
+    { "TP_LOCALIZACAO_ESC",     TIPO_CAMPO_INT,   0, sizeof(int),   -1, 1 },
+    { "TP_SIT_FUNC_ESC",        TIPO_CAMPO_INT,   0, sizeof(int),   -1, 1 },
+    { "CO_MUNICIPIO_PROVA",     TIPO_CAMPO_INT,   0, sizeof(int),   -1, 1 },
+    { "NO_MUNICIPIO_PROVA",     TIPO_CAMPO_TEXTO, 0, 40,            0,  1 },
+    { "CO_UF_PROVA",            TIPO_CAMPO_INT,   0, sizeof(int),   -1, 1 },
+    { "SG_UF_PROVA",            TIPO_CAMPO_TEXTO, 0, 3,             0,  1 },
+    { "TP_PRESENCA_CN",         TIPO_CAMPO_INT,   0, sizeof(int),   -1, 1 },
+    { "TP_PRESENCA_CH",         TIPO_CAMPO_INT,   0, sizeof(int),   -1, 1 },
+    { "TP_PRESENCA_LC",         TIPO_CAMPO_INT,   0, sizeof(int),   -1, 1 },
+    { "TP_PRESENCA_MT",         TIPO_CAMPO_INT,   0, sizeof(int),   -1, 1 },
+    { "TP_STATUS_REDACAO",      TIPO_CAMPO_INT,   0, sizeof(int),   -1, 1 },
+    { "NU_NOTA_COMP1",          TIPO_CAMPO_FLOAT, 0, sizeof(float), -1, 1 },
+    { "NU_NOTA_COMP2",          TIPO_CAMPO_FLOAT, 0, sizeof(float), -1, 1 },
+    { "NU_NOTA_COMP3",          TIPO_CAMPO_FLOAT, 0, sizeof(float), -1, 1 },
+    { "NU_NOTA_COMP4",          TIPO_CAMPO_FLOAT, 0, sizeof(float), -1, 1 },
+    { "NU_NOTA_COMP5",          TIPO_CAMPO_FLOAT, 0, sizeof(float), -1, 1 },
+};
+#define QTD_CATALOGO_COLUNAS_EXTRAS ((int)(sizeof(CATALOGO_COLUNAS_EXTRAS) / sizeof(CATALOGO_COLUNAS_EXTRAS[0])))
+
+// Colunas extras escolhidas em CONFIG COLUNAS, usadas quando participantes_extra.bin ainda no existe
+HeaderExtras ESQUEMA_EXTRAS;
+
+// Acrescenta a coluna do catlogo ao esquema, alinhando nmeros em 4 bytes.
+// Retorna 0, 1 se o nome no est no catlogo ou 2 se a coluna j foi escolhida
+int adicionar_coluna_extra(HeaderExtras *esquema, const char *nome) {
+    const DescritorCampoCsv *d = NULL;
+    for (int i = 0; i < QTD_CATALOGO_COLUNAS_EXTRAS; i++) {
+        if (strcmp(CATALOGO_COLUNAS_EXTRAS[i].nome, nome) == 0) d = &CATALOGO_COLUNAS_EXTRAS[i];
+    }
+    if (!d) return 1;
+    for (int i = 0; i < esquema->qtd_colunas; i++) {
+        if (strcmp(esquema->colunas[i].nome, nome) == 0) return 2;
+    }
+
+    ColunaExtra *c = &esquema->colunas[esquema->qtd_colunas++];
+    memset(c, 0, sizeof(ColunaExtra));
+    snprintf(c->nome, sizeof(c->nome), "%s", d->nome);
+    c->tipo = d->tipo;
+    c->tamanho = (int)d->tamanho;
+    c->offset = esquema->tamanho_registro;
+    if (d->tipo == TIPO_CAMPO_INT || d->tipo == TIPO_CAMPO_FLOAT) c->offset = (c->offset + 3) & ~3;
+    esquema->tamanho_registro = c->offset + c->tamanho;
+    return 0;
+}
+
+// Motivos de rejeio de uma linha
+#define LINHA_OK 0
+#define LINHA_COLUNAS_FALTANDO 1
+#define LINHA_SEM_NU_SEQ 2
+#define LINHA_NUMERO_INVALIDO 3
+#define LINHA_CAMPO_VAZIO 4 // S com CONFIG LIMPEZA
+#define LINHA_FORA_DO_FORMATO 5 // Valor que o formato compacto no representa (ver participante_compactavel)
+#define QTD_MOTIVOS_REJEICAO 6
+
+// Nomes usados no resumo da importao (posio = cdigo do motivo)
+const char *NOMES_MOTIVOS_REJEICAO[QTD_MOTIVOS_REJEICAO] = {
+    "ok", "colunas_faltando", "sem_nu_seq", "numero_invalido", "campo_vazio", "fora_do_formato"
+};
+
+// Coluna do cabealho com o nome dado (-1 se no h)
+int procurar_coluna_csv(CampoCsv *cabecalho, int qtd_colunas, const char *nome) {
+    size_t tam_nome = strlen(nome);
+    for (int j = 0; j < MIN(qtd_colunas, MAX_COLUNAS_CSV); j++) {
+        CampoCsv h = cabecalho[j];
+        // Aceita o nome entre aspas ou com espaos em volta
+        while (h.tamanho > 0 && (*h.inicio == ' ' || *h.inicio == '"')) { h.inicio++; h.tamanho--; }
+        while (h.tamanho > 0 && (h.inicio[h.tamanho - 1] == ' ' || h.inicio[h.tamanho - 1] == '"')) h.tamanho--;
+        if ((size_t)h.tamanho == tam_nome && memcmp(h.inicio, nome, tam_nome) == 0) return j;
+    }
+    return -1;
+}
+
+// Monta o mapa a partir da linha de cabealho. Retorna 0, ou 1 se falta uma coluna obrigatria
+// (todas menos NU_ANO, que a sada do limpeza.py no tem). Uma coluna extra ausente s fica nula.
+int montar_mapa_colunas_csv(CampoCsv *cabecalho, int qtd_colunas, int latin1, const HeaderExtras *extras, MapaColunasCsv *mapa) {
+    mapa->latin1 = latin1;
+    mapa->qtd_minima_colunas = 0;
+    for (int c = 0; c < QTD_CAMPOS_CSV; c++) {
+        mapa->coluna[c] = procurar_coluna_csv(cabecalho, qtd_colunas, ESQUEMA_CSV[c].nome);
+        if (mapa->coluna[c] == -1 && !ESQUEMA_CSV[c].opcional) {
+            printf("ERRO: Coluna obrigatoria '%s' nao encontrada no cabecalho do CSV.\n", ESQUEMA_CSV[c].nome);
+            return 1;
+        }
+        mapa->qtd_minima_colunas = MAX(mapa->qtd_minima_colunas, mapa->coluna[c] + 1);
+    }
+
+    mapa->qtd_extras = extras ? extras->qtd_colunas : 0;
+    for (int e = 0; e < mapa->qtd_extras; e++) {
+        const ColunaExtra *c = &extras->colunas[e];
+        DescritorCampoCsv d = { c->nome, c->tipo, (size_t)c->offset, (size_t)c->tamanho, -1, 1 };
+        mapa->extras[e] = d;
+        mapa->coluna_extra[e] = procurar_coluna_csv(cabecalho, qtd_colunas, c->nome);
+        if (mapa->coluna_extra[e] == -1) {
+            printf("Aviso: a coluna extra '%s' nao esta no CSV; fica nula.\n", c->nome);
+        }
+        mapa->qtd_minima_colunas = MAX(mapa->qtd_minima_colunas, mapa->coluna_extra[e] + 1);
+    }
+    return 0;
+}
+
+// Campo nulo segundo o limpeza.py: vazio, s espaos, "NA" ou "NaN"
+int campo_nulo_csv(CampoCsv c) {
+    int i = 0;
+    while (i < c.tamanho && c.inicio[i] == ' ') i++;
+    if (i == c.tamanho) return 1;
+    if (c.tamanho == 2 && memcmp(c.inicio, "NA", 2) == 0) return 1;
+    if (c.tamanho == 3 && memcmp(c.inicio, "NaN", 3) == 0) return 1;
+    return 0;
+}
+
+// Copia um campo de texto para UTF-8: converte de latin1 se preciso e nunca corta um caractere no meio
+void copiar_texto_csv(char *destino, size_t tamanho_destino, CampoCsv c, int latin1) {
+    size_t n = 0;
+    if (latin1) {
+        for (int i = 0; i < c.tamanho; i++) {
+            unsigned char b = (unsigned char)c.inicio[i];
+            if (b < 0x80) {
+                if (n + 1 >= tamanho_destino) break;
+                destino[n++] = (char)b;
+            } else {
+                if (n + 2 >= tamanho_destino) break;
+                destino[n++] = (char)(0xC0 | (b >> 6));
+                destino[n++] = (char)(0x80 | (b & 0x3F));
+            }
+        }
+    } else {
+        n = MIN((size_t)c.tamanho, tamanho_destino - 1);
+        if (n < (size_t)c.tamanho) {
+            // Volta at o incio do caractere UTF-8 que ficaria cortado
+            while (n > 0 && ((unsigned char)c.inicio[n] & 0xC0) == 0x80) n--;
+        }
+        memcpy(destino, c.inicio, n);
+    }
+    destino[n] = '\0';
+}
+
+// Converte um campo numrico opcional: vazio vira 'padrao'. Retorna 0 se o texto no  nmero.
+int converter_campo_numerico(CampoCsv c, double padrao, double *valor) {
+    if (c.tamanho == 0) {
+        *valor = padrao;
+        return 1;
+    }
+    return converter_decimal_csv(c, valor);
+}
+
+// Valor da coluna indicada (-1 = ausente no CSV), com os nulos normalizados para tamanho 0
+CampoCsv campo_projetado_csv(CampoCsv *colunas, int coluna) {
+    CampoCsv c = { "", 0 };
+    if (coluna == -1) return c;
+    c = colunas[coluna];
+    if (c.tamanho > 0 && campo_nulo_csv(c)) c.tamanho = 0;
+    return c;
+}
+
+// Converte o campo conforme o tipo do descritor e grava em registro + offset.
+// Retorna 0 se um campo numrico no  nmero.
+int gravar_campo_csv(const DescritorCampoCsv *d, CampoCsv c, int latin1, char *registro) {
+    char *destino = registro + d->offset;
+    double valor;
+    switch (d->tipo) {
+    case TIPO_CAMPO_COD_PROVA:
+        // O cdigo da prova pode vir como "1420" ou "1420.0": guarda s a parte inteira
+        for (int k = 0; k < c.tamanho; k++) {
+            if (c.inicio[k] == '.') { c.tamanho = k; break; }
+        }
+        copiar_campo_csv(destino, d->tamanho, c);
+        break;
+    case TIPO_CAMPO_TEXTO:
+        copiar_texto_csv(destino, d->tamanho, c, latin1);
+        break;
+    case TIPO_CAMPO_INT:
+        if (!converter_campo_numerico(c, d->nulo, &valor)) return 0;
+        *(int *)destino = (int)valor;
+        break;
+    case TIPO_CAMPO_FLOAT:
+        if (!converter_campo_numerico(c, d->nulo, &valor)) return 0;
+        *(float *)destino = (float)valor;
+        break;
+    default:
+        copiar_campo_csv(destino, d->tamanho, c);
+    }
+    return 1;
+}
+
+// Preenche a LinhaCsv a partir das colunas indicadas pelo mapa. Campos vazios viram nulos (NOTA_AUSENTE, -1 ou "")
+// em vez de rejeitar a linha; s o NU_SEQ  obrigatrio, a no ser com CONFIG LIMPEZA.
+// S as colunas do esquema e as extras projetadas so convertidas.
+int interpretar_linha_csv(CampoCsv *colunas, int qtd_colunas, const MapaColunasCsv *mapa, LinhaCsv *l) {
+    if (qtd_colunas < mapa->qtd_minima_colunas) return LINHA_COLUNAS_FALTANDO;
+
+    CampoCsv campos[QTD_CAMPOS_CSV];
+    for (int c = 0; c < QTD_CAMPOS_CSV; c++) {
+        campos[c] = campo_projetado_csv(colunas, mapa->coluna[c]);
+        if (campos[c].tamanho == 0 && LIMPEZA_IMPORTACAO && !ESQUEMA_CSV[c].opcional) return LINHA_CAMPO_VAZIO;
+    }
+    if (campos[CAMPO_NU_SEQ].tamanho == 0) return LINHA_SEM_NU_SEQ;
+
+    memset(l, 0, sizeof(LinhaCsv));
+    for (int c = 0; c < QTD_CAMPOS_CSV; c++) {
+        if (!gravar_campo_csv(&ESQUEMA_CSV[c], campos[c], mapa->latin1, (char *)l)) return LINHA_NUMERO_INVALIDO;
+    }
+
+    // Uma coluna extra que no  nmero fica nula em vez de rejeitar a linha
+    for (int e = 0; e < mapa->qtd_extras; e++) {
+        CampoCsv c = campo_projetado_csv(colunas, mapa->coluna_extra[e]);
+        if (!gravar_campo_csv(&mapa->extras[e], c, mapa->latin1, l->extra)) {
+            CampoCsv vazio = { "", 0 };
+            gravar_campo_csv(&mapa->extras[e], vazio, mapa->latin1, l->extra);
+        }
+    }
+
+    Participante *p = &l->p;
+    if (!participante_compactavel(p)) return LINHA_FORA_DO_FORMATO;
+    p->indice_localizacao = -1;
+    p->indice_gabarito_cn = -1;
+    p->indice_gabarito_ch = -1;
+    p->indice_gabarito_lc = -1;
+    p->indice_gabarito_mt = -1;
+    return LINHA_OK;
+}
+
+/************************************************ DESCOMPRESSO DO CSV ************************************************/
+
+// Um CSV comprimido (gzip ou zstd, reconhecido pelos bytes mgicos) no  mapeado: o descompressor roda
+// como processo filho (gzip -dc / zstd -dc) e uma thread l a sada dele em blocos terminados em fim de
+// linha. Os blocos passam por um conjunto fixo de buffers; quando todos esto com o parser, a thread
+// para de ler, ento a memria usada  limitada e o CSV descomprimido nunca vai para o disco.
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+#define TAM_BLOCO_DESCOMPRESSAO (4 * 1024 * 1024)
+
+#define COMPRESSAO_NENHUMA 0
+#define COMPRESSAO_GZIP 1
+#define COMPRESSAO_ZSTD 2
+
+// Um trecho de linhas completas dentro de um dos buffers
+typedef struct {
+    int buffer;
+    const char *inicio;
+    size_t tamanho;
+} BlocoCsv;
+
+typedef struct {
+    FILE *pipe;
+    pthread_t thread;
+
+    int qtd_buffers;
+    char **buffers;        // Cada um com 2 * TAM_BLOCO_DESCOMPRESSAO bytes (resto da linha anterior + bloco novo)
+    BlocoCsv *prontos;     // Fila circular, na ordem do arquivo
+    int inicio_prontos;
+    int qtd_prontos;
+    int *livres;           // Pilha de buffers livres
+    int qtd_livres;
+    int fim;               // A thread terminou de ler
+
+    size_t bytes_descomprimidos;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_pronto;
+    pthread_cond_t cond_livre;
+} LeitorDescompressao;
+
+// Reconhece o formato pelos primeiros bytes do arquivo
+int tipo_compressao_csv(const char *nome) {
+    unsigned char magico[4] = {0};
+    FILE *f = fopen(nome, "rb");
+    if (!f) return COMPRESSAO_NENHUMA;
+    size_t lidos = fread(magico, 1, 4, f);
+    fclose(f);
+    if (lidos >= 2 && magico[0] == 0x1F && magico[1] == 0x8B) return COMPRESSAO_GZIP;
+    if (lidos == 4 && magico[0] == 0x28 && magico[1] == 0xB5 && magico[2] == 0x2F && magico[3] == 0xFD) return COMPRESSAO_ZSTD;
+    return COMPRESSAO_NENHUMA;
+}
+
+void *thread_descompressao(void *arg) {
+    LeitorDescompressao *d = (LeitorDescompressao *)arg;
+    char *resto = (char *)malloc(TAM_BLOCO_DESCOMPRESSAO);
+    size_t tam_resto = 0;
+    if (!resto) { perror("Erro ao alocar buffer de descompressao"); exit(1); }
+
+    while (1) {
+        pthread_mutex_lock(&d->mutex);
+        while (d->qtd_livres == 0) {
+            pthread_cond_wait(&d->cond_livre, &d->mutex);
+        }
+        int b = d->livres[--d->qtd_livres];
+        pthread_mutex_unlock(&d->mutex);
+
+        // O bloco comea com o pedao de linha que sobrou do anterior
+        char *buf = d->buffers[b];
+        memcpy(buf, resto, tam_resto);
+        size_t tam = tam_resto;
+        size_t lidos;
+        while (tam < tam_resto + TAM_BLOCO_DESCOMPRESSAO && (lidos = fread(buf + tam, 1, tam_resto + TAM_BLOCO_DESCOMPRESSAO - tam, d->pipe)) > 0) {
+            tam += lidos;
+        }
+        int acabou = (tam < tam_resto + TAM_BLOCO_DESCOMPRESSAO);
+        d->bytes_descomprimidos += tam - tam_resto;
+
+        // Corta no ltimo fim de linha; o resto vai para o prximo bloco
+        size_t corte = tam;
+        if (!acabou) {
+            while (corte > 0 && buf[corte - 1] != '\n') corte--;
+            if (corte == 0 || tam - corte > TAM_BLOCO_DESCOMPRESSAO) corte = tam; // Linha maior que um bloco: no corta
+        }
+        tam_resto = tam - corte;
+        memcpy(resto, buf + corte, tam_resto);
+
+        pthread_mutex_lock(&d->mutex);
+        if (corte > 0) {
+            BlocoCsv *bloco = &d->prontos[(d->inicio_prontos + d->qtd_prontos) % d->qtd_buffers];
+            bloco->buffer = b;
+            bloco->inicio = buf;
+            bloco->tamanho = corte;
+            d->qtd_prontos++;
+        } else {
+            d->livres[d->qtd_livres++] = b;
+        }
+        if (acabou) d->fim = 1;
+        pthread_cond_broadcast(&d->cond_pronto);
+        pthread_mutex_unlock(&d->mutex);
+
+        if (acabou) break;
+    }
+    free(resto);
+    return NULL;
+}
+
+// Inicia o descompressor para o arquivo. Retorna 0 em caso de sucesso.
+int descompressao_iniciar(LeitorDescompressao *d, const char *nome, int tipo, int qtd_buffers) {
+    // Nome entre aspas simples para o shell; uma aspa simples no nome vira '\''
+    char comando[600];
+    size_t n = (size_t)snprintf(comando, sizeof(comando), "%s -dc -- '", tipo == COMPRESSAO_GZIP ? "gzip" : "zstd -q");
+    for (const char *c = nome; *c && n + 6 < sizeof(comando); c++) {
+        if (*c == '\'') {
+            memcpy(comando + n, "'\\''", 4);
+            n += 4;
+        } else {
+            comando[n++] = *c;
+        }
+    }
+    comando[n++] = '\'';
+    comando[n] = '\0';
+
+    memset(d, 0, sizeof(LeitorDescompressao));
+    d->pipe = popen(comando, "r");
+    if (!d->pipe) {
+        perror("Erro ao iniciar o descompressor");
+        return 1;
+    }
+
+    d->qtd_buffers = qtd_buffers;
+    d->buffers = (char **)malloc(qtd_buffers * sizeof(char *));
+    d->prontos = (BlocoCsv *)malloc(qtd_buffers * sizeof(BlocoCsv));
+    d->livres = (int *)malloc(qtd_buffers * sizeof(int));
+    if (!d->buffers || !d->prontos || !d->livres) { perror("Erro ao alocar buffers de descompressao"); exit(1); }
+    for (int i = 0; i < qtd_buffers; i++) {
+        d->buffers[i] = (char *)malloc(2 * TAM_BLOCO_DESCOMPRESSAO);
+        if (!d->buffers[i]) { perror("Erro ao alocar buffers de descompressao"); exit(1); }
+        d->livres[d->qtd_livres++] = i;
+    }
+
+    pthread_mutex_init(&d->mutex, NULL);
+    pthread_cond_init(&d->cond_pronto, NULL);
+    pthread_cond_init(&d->cond_livre, NULL);
+    pthread_create(&d->thread, NULL, thread_descompressao, d);
+    return 0;
+}
+
+// Prximo bloco na ordem do arquivo. Retorna 0 quando a descompresso acabou.
+int descompressao_proximo_bloco(LeitorDescompressao *d, BlocoCsv *bloco) {
+    pthread_mutex_lock(&d->mutex);
+    while (d->qtd_prontos == 0 && !d->fim) {
+        pthread_cond_wait(&d->cond_pronto, &d->mutex);
+    }
+    int tem = (d->qtd_prontos > 0);
+    if (tem) {
+        *bloco = d->prontos[d->inicio_prontos];
+        d->inicio_prontos = (d->inicio_prontos + 1) % d->qtd_buffers;
+        d->qtd_prontos--;
+    }
+    pthread_mutex_unlock(&d->mutex);
+    return tem;
+}
+
+// Devolve o buffer do bloco (as linhas j foram copiadas para o LoteCsv)
+void descompressao_liberar_bloco(LeitorDescompressao *d, BlocoCsv *bloco) {
+    pthread_mutex_lock(&d->mutex);
+    d->livres[d->qtd_livres++] = bloco->buffer;
+    pthread_cond_signal(&d->cond_livre);
+    pthread_mutex_unlock(&d->mutex);
+}
+
+// Espera a thread e o processo descompressor. Retorna o status do descompressor (0 = ok)
+int descompressao_finalizar(LeitorDescompressao *d) {
+    pthread_join(d->thread, NULL);
+    int status = pclose(d->pipe);
+    for (int i = 0; i < d->qtd_buffers; i++) {
+        free(d->buffers[i]);
+    }
+    free(d->buffers);
+    free(d->prontos);
+    free(d->livres);
+    pthread_mutex_destroy(&d->mutex);
+    pthread_cond_destroy(&d->cond_pronto);
+    pthread_cond_destroy(&d->cond_livre);
+    return status;
+}
+
+/************************************************ LEITURA PARALELA DO CSV ************************************************/
+
+// O CSV (j mapeado)  dividido em blocos de TAM_BLOCO_CSV bytes alinhados em fim de linha;
+// um CSV comprimido chega em blocos j alinhados, na ordem em que o descompressor os entrega.
+// Um conjunto de threads interpreta os blocos em lotes de LinhaCsv; a thread que chamou o READ
+// consome os lotes estritamente na ordem do arquivo, ento a numerao de indice_registro
+//  a mesma da leitura sequencial. No mximo 'janela' lotes ficam em memria ao mesmo tempo.
+
+#define TAM_BLOCO_CSV (4 * 1024 * 1024)
+
+// Relgio de parede em segundos, para medir as etapas da importao
+double relogio_segundos() {
+#ifndef _WIN32
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+int THREADS_IMPORTACAO = 0; // 0 = uma por ncleo disponvel (CONFIG THREADS)
+
+typedef struct {
+    LinhaCsv *linhas;
+    int qtd;
+    int capacidade;
+    int rejeitadas[QTD_MOTIVOS_REJEICAO]; // Por motivo (LINHA_*)
+    size_t bytes;                // Tamanho do bloco no CSV
+    double segundos;             // Tempo gasto pela thread para interpretar o bloco
+    int pronto; // 1 quando o bloco j foi interpretado e aguarda o commit
+} LoteCsv;
+
+typedef struct {
+    const char *dados; // Incio dos dados (depois do cabealho)
+    size_t tamanho;
+    const MapaColunasCsv *mapa;
+    LeitorDescompressao *fonte; // CSV comprimido (NULL = arquivo mapeado em 'dados')
+    BlocoCsv primeiro;          // Restante do bloco que tinha o cabealho (bloco 0 da fonte)
+    long proximo_fonte;         // Prximo bloco a ser retirado da fonte, para manter a ordem
+    pthread_cond_t cond_fonte;
+    long qtd_blocos;     // Com fonte s  conhecido no fim do arquivo (at l, LONG_MAX)
+    long proximo_bloco;  // Prximo bloco a ser pego por uma thread
+    long proximo_commit; // Prximo bloco que o commit vai consumir
+    int janela;
+    LoteCsv *lotes;      // O bloco k usa lotes[k % janela]
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_pronto;
+    pthread_cond_t cond_livre;
+} LeitorParalelo;
+
+int obter_qtd_threads_importacao() {
+    if (THREADS_IMPORTACAO > 0) return THREADS_IMPORTACAO;
+#ifdef _SC_NPROCESSORS_ONLN
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > 0) return (int)MIN(n, 64);
+#endif
+    return 1;
+}
+
+// Primeira posio >= pos que comea uma linha
+size_t inicio_de_linha(const char *dados, size_t tamanho, size_t pos) {
+    if (pos == 0) return 0;
+    const char *nl = memchr(dados + pos - 1, '\n', tamanho - (pos - 1));
+    return nl ? (size_t)(nl - dados) + 1 : tamanho;
+}
+
+// Interpreta as linhas completas entre ini e fim no lote indicado
+void interpretar_trecho_csv(const char *ini, const char *fim, const MapaColunasCsv *mapa, LoteCsv *lote) {
+    LeitorCsv leitor = { .pos = ini, .fim = fim };
+    CampoCsv campos[MAX_COLUNAS_CSV];
+    int qtd_campos;
+
+    double inicio = relogio_segundos();
+    lote->qtd = 0;
+    memset(lote->rejeitadas, 0, sizeof(lote->rejeitadas));
+    lote->bytes = (size_t)(fim - ini);
+    while ((qtd_campos = proxima_linha_csv(&leitor, campos, mapa->qtd_minima_colunas)) != -1) {
+        if (qtd_campos == 1 && campos[0].tamanho == 0) continue; // Linha em branco
+        if (lote->qtd == lote->capacidade) {
+            lote->capacidade = lote->capacidade ? lote->capacidade * 2 : 1024;
+            lote->linhas = (LinhaCsv *)realloc(lote->linhas, lote->capacidade * sizeof(LinhaCsv));
+            if (!lote->linhas) { perror("Erro ao alocar LoteCsv"); exit(1); }
+        }
+        int motivo = interpretar_linha_csv(campos, qtd_campos, mapa, &lote->linhas[lote->qtd]);
+        if (motivo == LINHA_OK) {
+            lote->qtd++;
+        } else {
+            lote->rejeitadas[motivo]++;
+        }
+    }
+    lote->segundos = relogio_segundos() - inicio;
+}
+
+// Interpreta todas as linhas do bloco k do arquivo mapeado no lote indicado
+void interpretar_bloco_csv(LeitorParalelo *lp, long k, LoteCsv *lote) {
+    size_t a = (size_t)k * TAM_BLOCO_CSV;
+    size_t b = MIN(a + TAM_BLOCO_CSV, lp->tamanho);
+    size_t ini = inicio_de_linha(lp->dados, lp->tamanho, a);
+    size_t fim = (b >= lp->tamanho) ? lp->tamanho : inicio_de_linha(lp->dados, lp->tamanho, b);
+    interpretar_trecho_csv(lp->dados + ini, lp->dados + MAX(ini, fim), lp->mapa, lote);
+}
+
+// Retira da fonte o bloco k. As threads retiram em ordem de k, ento o bloco k do descompressor
+// vai para o lote k. Retorna 0 se o arquivo acabou antes do bloco k.
+int retirar_bloco_fonte(LeitorParalelo *lp, long k, BlocoCsv *bloco) {
+    pthread_mutex_lock(&lp->mutex);
+    while (lp->proximo_fonte != k) {
+        pthread_cond_wait(&lp->cond_fonte, &lp->mutex);
+    }
+    pthread_mutex_unlock(&lp->mutex);
+
+    // S esta thread mexe na fonte agora; as outras esperam a vez dela
+    int tem = 1;
+    if (k == 0) {
+        *bloco = lp->primeiro;
+    } else {
+        tem = descompressao_proximo_bloco(lp->fonte, bloco);
+    }
+
+    pthread_mutex_lock(&lp->mutex);
+    lp->proximo_fonte++;
+    if (!tem && k < lp->qtd_blocos) {
+        lp->qtd_blocos = k;
+        pthread_cond_broadcast(&lp->cond_pronto);
+        pthread_cond_broadcast(&lp->cond_livre);
+    }
+    pthread_cond_broadcast(&lp->cond_fonte);
+    pthread_mutex_unlock(&lp->mutex);
+    return tem;
+}
+
+void *thread_leitura_csv(void *arg) {
+    LeitorParalelo *lp = (LeitorParalelo *)arg;
+    while (1) {
+        pthread_mutex_lock(&lp->mutex);
+        // S pega um bloco novo se o lote dele j foi liberado pelo commit
+        while (lp->proximo_bloco < lp->qtd_blocos && lp->proximo_bloco >= lp->proximo_commit + lp->janela) {
+            pthread_cond_wait(&lp->cond_livre, &lp->mutex);
+        }
+        if (lp->proximo_bloco >= lp->qtd_blocos) {
+            pthread_mutex_unlock(&lp->mutex);
+            return NULL;
+        }
+        long k = lp->proximo_bloco++;
+        pthread_mutex_unlock(&lp->mutex);
+
+        LoteCsv *lote = &lp->lotes[k % lp->janela];
+        if (lp->fonte) {
+            BlocoCsv bloco;
+            if (!retirar_bloco_fonte(lp, k, &bloco)) return NULL;
+            interpretar_trecho_csv(bloco.inicio, bloco.inicio + bloco.tamanho, lp->mapa, lote);
+            descompressao_liberar_bloco(lp->fonte, &bloco);
+        } else {
+            interpretar_bloco_csv(lp, k, lote);
+        }
+
+        pthread_mutex_lock(&lp->mutex);
+        lote->pronto = 1;
+        pthread_cond_broadcast(&lp->cond_pronto);
+        pthread_mutex_unlock(&lp->mutex);
+    }
+}
+
+void leitor_paralelo_inicializar(LeitorParalelo *lp, const char *dados, size_t tamanho, const MapaColunasCsv *mapa, int qtd_threads) {
+    lp->dados = dados;
+    lp->tamanho = tamanho;
+    lp->mapa = mapa;
+    lp->fonte = NULL;
+    lp->proximo_fonte = 0;
+    lp->qtd_blocos = (long)((tamanho + TAM_BLOCO_CSV - 1) / TAM_BLOCO_CSV);
+    lp->proximo_bloco = 0;
+    lp->proximo_commit = 0;
+    lp->janela = 2 * qtd_threads;
+    lp->lotes = (LoteCsv *)calloc(lp->janela, sizeof(LoteCsv));
+    if (!lp->lotes) { perror("Erro ao alocar lotes do CSV"); exit(1); }
+    pthread_mutex_init(&lp->mutex, NULL);
+    pthread_cond_init(&lp->cond_pronto, NULL);
+    pthread_cond_init(&lp->cond_livre, NULL);
+    pthread_cond_init(&lp->cond_fonte, NULL);
+}
+
+// L do descompressor em vez do arquivo mapeado; 'primeiro'  o resto do bloco do cabealho
+void leitor_paralelo_usar_fonte(LeitorParalelo *lp, LeitorDescompressao *fonte, BlocoCsv primeiro) {
+    lp->fonte = fonte;
+    lp->primeiro = primeiro;
+    lp->qtd_blocos = LONG_MAX;
+}
+
+// Espera o prximo lote em ordem. Retorna NULL quando no h mais blocos.
+LoteCsv *leitor_paralelo_proximo_lote(LeitorParalelo *lp) {
+    LoteCsv *lote = &lp->lotes[lp->proximo_commit % lp->janela];
+    pthread_mutex_lock(&lp->mutex);
+    while (!lote->pronto && lp->proximo_commit < lp->qtd_blocos) {
+        pthread_cond_wait(&lp->cond_pronto, &lp->mutex);
+    }
+    int fim = !lote->pronto;
+    pthread_mutex_unlock(&lp->mutex);
+    return fim ? NULL : lote;
+}
+
+// Devolve o lote consumido para as threads de leitura
+void leitor_paralelo_liberar_lote(LeitorParalelo *lp, LoteCsv *lote) {
+    pthread_mutex_lock(&lp->mutex);
+    lote->pronto = 0;
+    lp->proximo_commit++;
+    pthread_cond_broadcast(&lp->cond_livre);
+    pthread_mutex_unlock(&lp->mutex);
+}
+
+void leitor_paralelo_destruir(LeitorParalelo *lp) {
+    for (int i = 0; i < lp->janela; i++) {
+        free(lp->lotes[i].linhas);
+    }
+    free(lp->lotes);
+    pthread_mutex_destroy(&lp->mutex);
+    pthread_cond_destroy(&lp->cond_pronto);
+    pthread_cond_destroy(&lp->cond_livre);
+    pthread_cond_destroy(&lp->cond_fonte);
+}
+
+/************************************************ CONSTRUO PARALELA DOS NDICES ************************************************/
+
+// As 5 rvores B+, a Trie e o ndice por Estado so independentes. Com CONSTRUCAO_PARALELA_INDICES
+// cada um tem sua thread construtora, e todas leem o mesmo fluxo de tuplas (indice_registro + chaves)
+// publicado pela thread que grava os participantes. Cada construtor anda no seu ritmo; o produtor
+// s espera quando o construtor mais lento est CAPACIDADE_FLUXO_INDICES tuplas atrs.
+
+#define CAPACIDADE_FLUXO_INDICES 65536
+#define LOTE_FLUXO_INDICES 1024 // Tuplas publicadas de uma vez (menos disputa pelo mutex)
+#define QTD_CONSTRUTORES 7      // 0-4: rvores B+ (mesma ordem de arvores[]), 5: Trie, 6: Estado
+#define CONSTRUTOR_TRIE 5
+#define CONSTRUTOR_ESTADO 6
+
+int CONSTRUCAO_PARALELA_INDICES = 1; // CONFIG PARALELO
+
+// Chaves de um participante para todos os ndices
+typedef struct {
+    int indice_registro;
+    Nota notas[5]; // CN, CH, LC, MT, RED
+    char nu_seq[15];
+    char estado[20]; // "" se o participante no tem escola
+} TuplaIndice;
+
+typedef struct {
+    TuplaIndice *tuplas; // Buffer circular
+    long pendente;       // Tuplas j escritas pelo produtor
+    long publicado;      // Tuplas visveis para os construtores
+    long menor_cursor;   // ltimo mnimo dos cursores visto pelo produtor
+    long cursores[QTD_CONSTRUTORES];
+    int fim;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_dados;
+    pthread_cond_t cond_espaco;
+} FluxoIndices;
+
+void fluxo_inicializar(FluxoIndices *f) {
+    memset(f, 0, sizeof(FluxoIndices));
+    f->tuplas = (TuplaIndice *)malloc(CAPACIDADE_FLUXO_INDICES * sizeof(TuplaIndice));
+    if (!f->tuplas) { perror("Erro ao alocar FluxoIndices"); exit(1); }
+    pthread_mutex_init(&f->mutex, NULL);
+    pthread_cond_init(&f->cond_dados, NULL);
+    pthread_cond_init(&f->cond_espaco, NULL);
+}
+
+void fluxo_destruir(FluxoIndices *f) {
+    free(f->tuplas);
+    pthread_mutex_destroy(&f->mutex);
+    pthread_cond_destroy(&f->cond_dados);
+    pthread_cond_destroy(&f->cond_espaco);
+}
+
+// Deve ser chamada com o mutex travado
+long fluxo_cursor_mais_lento(FluxoIndices *f) {
+    long menor = f->cursores[0];
+    for (int c = 1; c < QTD_CONSTRUTORES; c++) {
+        if (f->cursores[c] < menor) menor = f->cursores[c];
+    }
+    return menor;
+}
+
+void fluxo_publicar(FluxoIndices *f) {
+    pthread_mutex_lock(&f->mutex);
+    f->publicado = f->pendente;
+    f->menor_cursor = fluxo_cursor_mais_lento(f);
+    pthread_cond_broadcast(&f->cond_dados);
+    pthread_mutex_unlock(&f->mutex);
+}
+
+// Produtor: acrescenta uma tupla ao fluxo (espera se o buffer circular estiver cheio)
+void fluxo_adicionar(FluxoIndices *f, const TuplaIndice *t) {
+    if (f->pendente - f->menor_cursor >= CAPACIDADE_FLUXO_INDICES) {
+        pthread_mutex_lock(&f->mutex);
+        f->publicado = f->pendente;
+        pthread_cond_broadcast(&f->cond_dados);
+        while (f->pendente - fluxo_cursor_mais_lento(f) >= CAPACIDADE_FLUXO_INDICES) {
+            pthread_cond_wait(&f->cond_espaco, &f->mutex);
+        }
+        f->menor_cursor = fluxo_cursor_mais_lento(f);
+        pthread_mutex_unlock(&f->mutex);
+    }
+    f->tuplas[f->pendente % CAPACIDADE_FLUXO_INDICES] = *t;
+    f->pendente++;
+    if (f->pendente - f->publicado >= LOTE_FLUXO_INDICES) {
+        fluxo_publicar(f);
+    }
+}
+
+// Produtor: no haver mais tuplas
+void fluxo_encerrar(FluxoIndices *f) {
+    pthread_mutex_lock(&f->mutex);
+    f->publicado = f->pendente;
+    f->fim = 1;
+    pthread_cond_broadcast(&f->cond_dados);
+    pthread_mutex_unlock(&f->mutex);
+}
+
+// Construtor: espera tuplas novas. Retorna quantas esto disponveis a partir do cursor (0 = fim do fluxo).
+long fluxo_esperar(FluxoIndices *f, int construtor) {
+    pthread_mutex_lock(&f->mutex);
+    while (f->cursores[construtor] == f->publicado && !f->fim) {
+        pthread_cond_wait(&f->cond_dados, &f->mutex);
+    }
+    long disponiveis = f->publicado - f->cursores[construtor];
+    pthread_mutex_unlock(&f->mutex);
+    return disponiveis;
+}
+
+// Construtor: libera as tuplas j processadas
+void fluxo_avancar(FluxoIndices *f, int construtor, long qtd) {
+    pthread_mutex_lock(&f->mutex);
+    f->cursores[construtor] += qtd;
+    pthread_cond_broadcast(&f->cond_espaco);
+    pthread_mutex_unlock(&f->mutex);
+}
+
+/************************************************ IMPORTAO ************************************************/
+
+#define INTERVALO_PROGRESSO_SEG 5.0 // De quanto em quanto tempo o READ mostra o progresso
+char nome_resumo_importacao[TAM_CAMINHO] = "resumo_importacao.json";
+char nome_checkpoint_importacao[TAM_CAMINHO] = "importacao.ckpt";
+
+#define VERSAO_CHECKPOINT_IMPORTACAO 6
+
+// Estado de um READ em andamento, regravado (tmp + rename) a cada checkpoint e apagado no fim.
+// O arquivo de checkpoint  o ponto de confirmao: o que estiver nos arquivos alm dos cabealhos
+// guardados aqui  descartado na retomada. Os ndices s so gravados no fim, ento durante a leitura
+// continuam como estavam antes do READ e so remontados a partir dos participantes j confirmados.
+typedef struct {
+    int versao;
+    char csv[256];
+    long long tamanho_csv;  // Tamanho do arquivo (comprimido, se for o caso), para reconhecer o mesmo CSV
+    long long bytes_lidos;  // Bytes do CSV depois do cabealho j gravados (sempre num fim de linha)
+    int leitura_concluida;  // 1 = o CSV inteiro foi gravado; falta s gravar os ndices
+    int indice_pronto[QTD_CONSTRUTORES]; // ndices j gravados com os participantes desta importao
+    int registro_inicial;   // Primeiro participante desta importao
+    int linhas_lidas;
+    int linhas_rejeitadas;
+    int rejeitadas[QTD_MOTIVOS_REJEICAO];
+
+    // Cabealhos confirmados no ltimo checkpoint
+    HeaderParticipantes header;
+    HeaderLocalizacao header_loc;
+    HeaderProva header_gab;
+    HeaderExtras header_extra; // qtd_colunas == 0 se o READ no gravava colunas extras
+
+    // Cabealhos de antes do READ, para desfaz-lo (o de participantes  registro_inicial)
+    HeaderLocalizacao header_loc_inicial;
+    HeaderProva header_gab_inicial;
+    HeaderExtras header_extra_inicial;
+
+    // ndices como estavam antes do READ (ainda no devem ter mudado, exceto os prontos)
+    HeaderTrie header_trie;
+    HeaderRegistroEstado header_reg_est;
+    Metadados metadados[5];
+    int mesclar[5];
+    int motor[5];
+    int proximo_id_lsm[5]; // S muda quando o READ acrescenta a run da rvore LSM
+} CheckpointImportacao;
+
+// Contadores e tempos (em segundos) de cada etapa de um READ.
+// Cada campo tem um nico escritor: a thread principal, as threads de leitura (via LoteCsv)
+// ou a thread construtora do ndice correspondente; o resumo  montado depois dos joins.
+typedef struct {
+    double inicio;
+    double ultimo_progresso;
+    size_t bytes_total;  // Tamanho do CSV sem o cabealho
+    size_t bytes_lidos;  // Bytes dos lotes j gravados
+    int rejeitadas[QTD_MOTIVOS_REJEICAO];
+
+    double seg_interpretacao;  // Soma do tempo das threads de leitura interpretando blocos
+    double seg_espera_leitura; // Thread principal parada esperando o prximo lote
+    double seg_dimensoes;      // Deduplicao e gravao de Localizacao e Prova
+    double seg_participantes;  // Gravao em participantes.bin e participantes_respostas.bin
+    double seg_publicacao;     // Entrega das tuplas aos ndices (no modo paralelo, inclui esperar o mais lento)
+    double seg_indice[QTD_CONSTRUTORES];     // Acumulao de cada ndice durante a leitura
+    double seg_construcao[QTD_CONSTRUTORES]; // Construo/gravao de cada ndice no fim
+    double seg_total;
+} EstatisticasImportacao;
+
+// Arquivos e estruturas abertos durante um READ
+typedef struct {
+    FILE *fp_bin;
+    FILE *fp_respostas; // Mesmo cabealho do fp_bin
+    HeaderParticipantes header;
+    FILE *fp_loc;
+    HeaderLocalizacao header_loc;
+    FILE *fp_gab;
+    HeaderProva header_gab;
+    FILE *fp_extra; // NULL se no h colunas extras
+    HeaderExtras header_extra;
+    FILE *fp_reg_est;
+    HeaderRegistroEstado header_reg_est;
+    RegistrosPorEstado estados; // ndices novos de cada Estado, gravados no fim
+    FILE *fp_trie;
+    HeaderTrie header_trie;
+    TrieMemoria trie; // A Trie  montada em memria e gravada inteira no fim
+
+    // Dicionrios em memria para a deduplicao de Localizacao e Prova
+    DicionarioCodigo dic_loc;
+    DicionarioCodigo dic_gab;
+
+    // As notas de cada rvore so acumuladas numa ordenao externa e a rvore  construda em lote no fim.
+    // Se a rvore j tinha dados, as folhas existentes so intercaladas com as novas (mesclar_arvore_bmais);
+    // numa rvore LSM a carga ordenada s vira uma run nova. O limite de memria  dividido entre as 5
+    int mesclar[5];
+    OrdenacaoExterna cargas[5];
+
+    // Fluxo lido pelas threads construtoras (NULL se os ndices so atualizados em linha)
+    FluxoIndices *fluxo;
+
+    int linhas_lidas;
+    int linhas_rejeitadas;
+    EstatisticasImportacao estat;
+
+    // Os construtores marcam o prprio ndice como pronto em paralelo
+    CheckpointImportacao checkpoint;
+    pthread_mutex_t mutex_checkpoint;
+
+    // REINDEX: cada ndice  montado do zero e substitui o antigo; no h checkpoint a gravar
+    int reconstruir;
+
+    // READ em segundo plano: publica uma verso de leitura a cada checkpoint, com os participantes
+    // confirmados em segmentos parciais, e a base nova quando os ndices esto gravados. Nenhum arquivo
+    // que um leitor possa ter aberto  reescrito no lugar
+    int em_segundo_plano;
+    SegmentoParcial *parciais[MAX_SEGMENTOS_PARCIAIS]; // Os da ltima verso publicada
+    int qtd_parciais;
+    int proximo_id_parcial;
+
+    // READ que falhou: os construtores descartam o que acumularam e no gravam os ndices
+    int desfazer;
+} ContextoImportacao;
+
+void fechar_arquivos_importacao(ContextoImportacao *ctx) {
+    ESCRITA_EM_TRANSACAO = 0;
+    if (ctx->fp_trie) fechar_arquivo_pool(ctx->fp_trie);
+    if (ctx->fp_reg_est) fechar_arquivo_pool(ctx->fp_reg_est);
+    if (ctx->fp_extra) fclose(ctx->fp_extra);
+    if (ctx->fp_gab) fclose(ctx->fp_gab);
+    if (ctx->fp_loc) fclose(ctx->fp_loc);
+    if (ctx->fp_respostas) fclose(ctx->fp_respostas);
+    if (ctx->fp_bin) fclose(ctx->fp_bin);
+    pthread_mutex_destroy(&ctx->mutex_checkpoint);
+}
+
+// Abre (ou cria) todos os arquivos tocados pela importao. Retorna 0 em caso de sucesso.
+int abrir_arquivos_importacao(ContextoImportacao *ctx, const char *nome_bin) {
+    memset(ctx, 0, sizeof(ContextoImportacao));
+    pthread_mutex_init(&ctx->mutex_checkpoint, NULL);
+    ESCRITA_EM_TRANSACAO = 1;
+    ctx->fp_bin = abrir_arquivo_participantes(nome_bin, &ctx->header);
+    HeaderParticipantes header_respostas;
+    ctx->fp_respostas = abrir_arquivo_participantes(nome_respostas_bin, &header_respostas);
+    ctx->fp_loc = abrir_arquivo_localizacao(nome_localizacao_bin, &ctx->header_loc);
+    ctx->fp_gab = abrir_arquivo_gabarito(nome_gabarito_bin, &ctx->header_gab);
+    // Colunas extras: o esquema gravado no arquivo vale; o de CONFIG COLUNAS s cria o arquivo
+    ctx->fp_extra = abrir_arquivo_extras(nome_extras_bin, &ctx->header_extra, &ESQUEMA_EXTRAS, ctx->header.qtd_registros);
+    //Registro por Estado (Invertido)
+    ctx->fp_reg_est = abrir_arquivo_registro_estado(nome_registro_estado_bin, &ctx->header_reg_est);
+    //Trie para nu_seq
+    ctx->fp_trie = abrir_arquivo_trie(nome_trie_bin, &ctx->header_trie);
+
+    if (!ctx->fp_bin || !ctx->fp_respostas || !ctx->fp_loc || !ctx->fp_gab || !ctx->fp_reg_est || !ctx->fp_trie) {
+        fechar_arquivos_importacao(ctx);
+        return 1;
+    }
+    return 0;
+}
+
+// Inicia a transao: os appends partem do fim dos registros contados nos cabealhos
+// (o que um READ interrompido deixou alm deles  descartado)
+void iniciar_transacao_importacao(ContextoImportacao *ctx) {
+    truncar_arquivo(ctx->fp_bin, tamanho_header() + ctx->header.qtd_registros * tamanho_participante());
+    truncar_arquivo(ctx->fp_respostas, tamanho_header() + (long)ctx->header.qtd_registros * tamanho_respostas());
+    truncar_arquivo(ctx->fp_loc, tamanho_header_localizacao() + ctx->header_loc.qtd_registros * tamanho_localizacao());
+    truncar_arquivo(ctx->fp_gab, tamanho_header_prova() + ctx->header_gab.qtd_registros * tamanho_prova());
+    if (ctx->fp_extra) {
+        truncar_arquivo(ctx->fp_extra, tamanho_header_extras() + (long)ctx->header_extra.qtd_registros * ctx->header_extra.tamanho_registro);
+    }
+}
+
+// Checkpoint dos arquivos gravados pela thread principal (participantes e tabelas separadas)
+void checkpoint_arquivos_principais(ContextoImportacao *ctx) {
+    gravar_cabecalho(ctx->fp_loc, &ctx->header_loc, tamanho_header_localizacao());
+    gravar_cabecalho(ctx->fp_gab, &ctx->header_gab, tamanho_header_prova());
+    if (ctx->fp_extra) gravar_cabecalho(ctx->fp_extra, &ctx->header_extra, tamanho_header_extras());
+    gravar_cabecalho(ctx->fp_respostas, &ctx->header, tamanho_header());
+    // Por ltimo: um participante s conta depois que a localizao, os gabaritos e as respostas dele esto no disco
+    gravar_cabecalho(ctx->fp_bin, &ctx->header, tamanho_header());
+}
+
+// Grava o arquivo de checkpoint (tmp + rename). Retorna 0 em caso de sucesso.
+int gravar_checkpoint_importacao(const CheckpointImportacao *ck) {
+    char nome_tmp[TAM_CAMINHO];
+    montar_caminho(nome_tmp, sizeof(nome_tmp), "%s.tmp", nome_checkpoint_importacao);
+    FILE *fp = fopen(nome_tmp, "wb");
+    if (!fp) {
+        perror("Erro ao gravar o checkpoint da importacao");
+        return 1;
+    }
+    fwrite(ck, sizeof(CheckpointImportacao), 1, fp);
+    fclose(fp);
+#ifdef _WIN32
+    remove(nome_checkpoint_importacao); // rename() do Windows no sobrescreve
+#endif
+    if (rename(nome_tmp, nome_checkpoint_importacao) != 0) {
+        perror("Erro ao substituir o checkpoint da importacao");
+        return 1;
+    }
+    return 0;
+}
+
+// Retorna 1 se h um READ interrompido (checkpoint vlido em ck)
+int ler_checkpoint_importacao(CheckpointImportacao *ck) {
+    FILE *fp = fopen(nome_checkpoint_importacao, "rb");
+    if (!fp) return 0;
+    int lido = (fread(ck, sizeof(CheckpointImportacao), 1, fp) == 1);
+    fclose(fp);
+    if (!lido || ck->versao != VERSAO_CHECKPOINT_IMPORTACAO) {
+        printf("Aviso: checkpoint de importacao '%s' invalido; ignorado.\n", nome_checkpoint_importacao);
+        return 0;
+    }
+    return 1;
+}
+
+// Tamanho do arquivo em bytes (-1 se no existe)
+long long tamanho_arquivo(const char *nome) {
+    struct stat st;
+    if (stat(nome, &st) != 0) return -1;
+    return (long long)st.st_size;
+}
+
+// Ponto de falha dos testes de retomada (teste_regressao.sh): com FALHA_IMPORTACAO=<ponto>:<n> no ambiente,
+// o programa termina na hora, sem gravar mais nada (como num kill -9), na n-sima vez que passa por `ponto`
+void ponto_de_falha_importacao(const char *ponto) {
+    static int vezes = 0;
+    const char *falha = getenv("FALHA_IMPORTACAO");
+    size_t tam = strlen(ponto);
+    if (!falha || strncmp(falha, ponto, tam) != 0 || falha[tam] != ':') return;
+    if (++vezes == atoi(falha + tam + 1)) {
+        printf("FALHA_IMPORTACAO: processo encerrado em '%s'.\n", falha);
+        fflush(stdout);
+        _exit(1);
+    }
+}
+
+void publicar_checkpoint_segundo_plano(ContextoImportacao *ctx);
+
+// Checkpoint completo: cabealhos dos arquivos principais e, depois deles, o arquivo de checkpoint
+void checkpoint_importacao(ContextoImportacao *ctx) {
+    checkpoint_arquivos_principais(ctx);
+    // Os metadados guardados no checkpoint precisam estar no disco para a retomada conferi-los
+    sincronizar_arvores();
+    pthread_mutex_lock(&ctx->mutex_checkpoint);
+    CheckpointImportacao *ck = &ctx->checkpoint;
+    ck->header = ctx->header;
+    ck->header_loc = ctx->header_loc;
+    ck->header_gab = ctx->header_gab;
+    if (ctx->fp_extra) ck->header_extra = ctx->header_extra;
+    ck->bytes_lidos = (long long)ctx->estat.bytes_lidos;
+    ck->linhas_lidas = ctx->linhas_lidas;
+    ck->linhas_rejeitadas = ctx->linhas_rejeitadas;
+    memcpy(ck->rejeitadas, ctx->estat.rejeitadas, sizeof(ck->rejeitadas));
+    gravar_checkpoint_importacao(ck);
+    ponto_de_falha_importacao("checkpoint");
+    pthread_mutex_unlock(&ctx->mutex_checkpoint);
+    if (ctx->em_segundo_plano) publicar_checkpoint_segundo_plano(ctx);
+}
+
+// Commit da leitura: cabealhos no disco e o checkpoint passa a dizer que falta s gravar os ndices
+void confirmar_transacao_importacao(ContextoImportacao *ctx) {
+    ctx->checkpoint.leitura_concluida = 1;
+    checkpoint_importacao(ctx);
+}
+
+// Se j passaram CONFIG CHECKPOINT registros desde o ltimo checkpoint. Avaliado ao fim de cada lote,
+// porque s ali se conhece o byte do CSV em que a leitura pode ser retomada
+int lote_fecha_checkpoint(ContextoImportacao *ctx) {
+    return CHECKPOINT_IMPORTACAO > 0 &&
+           ctx->header.qtd_registros - ctx->checkpoint.header.qtd_registros >= CHECKPOINT_IMPORTACAO;
+}
+
+// Arquivos do ndice `construtor` que podem ser trocados por um temporrio, na ordem da troca: os da rvore
+// B+ e o manifesto LSM, ou o da Trie, ou o do ndice por Estado. Retorna quantos
+int arquivos_indice_importacao(int construtor, char nomes[4][TAM_CAMINHO]) {
+    if (construtor < 5) {
+        ArvoreBmais *a = &arvores[construtor];
+        nome_arquivo_arvore(a, "dados", nomes[0]);
+        nome_arquivo_arvore(a, "indice", nomes[1]);
+        nome_arquivo_arvore(a, "meta", nomes[2]);
+        nome_manifesto_lsm(&a->lsm, nomes[3]);
+        return 4;
+    }
+    montar_caminho(nomes[0], TAM_CAMINHO, "%s", construtor == CONSTRUTOR_TRIE ? nome_trie_bin : nome_registro_estado_bin);
+    return 1;
+}
+
+// Leva ao disco o que o ndice acabou de gravar: os temporrios que vo entrar no lugar dos arquivos, ou
+// os prprios arquivos (construo no lugar de uma rvore vazia, com as pginas que esto no pool), e a run
+// LSM nova. Com o diretrio, para que os temporrios ainda existam depois de uma queda
+void sincronizar_indice_importacao(int construtor) {
+    char nomes[4][TAM_CAMINHO];
+    int qtd = arquivos_indice_importacao(construtor, nomes);
+    if (construtor < 5) {
+        ArvoreBmais *a = &arvores[construtor];
+        sincronizar_arvore(a);
+        ManifestoLsm *m = &a->lsm.manifesto;
+        if (a->motor == MOTOR_LSM && m->qtd_runs > 0) {
+            char nome_run[TAM_CAMINHO];
+            nome_run_lsm(a->lsm.nome, m->runs[m->qtd_runs - 1].id, nome_run);
+            sincronizar_caminho_disco(nome_run);
+        }
+    }
+    for (int i = 0; i < qtd; i++) {
+        sincronizar_arquivo_ou_tmp_disco(nomes[i]);
+    }
+    sincronizar_caminho_disco(DIRETORIO_BASE);
+}
+
+// Chamada por cada construtor depois de gravar o seu ndice e antes de p-lo no lugar do anterior. O
+// checkpoint s diz que o ndice est pronto quando os arquivos dele j esto no disco; a retomada ento
+// conclui a troca (trocar_arquivos_indice) em vez de grav-lo de novo
+void marcar_indice_pronto(ContextoImportacao *ctx, int construtor) {
+    sincronizar_indice_importacao(construtor);
+    pthread_mutex_lock(&ctx->mutex_checkpoint);
+    ctx->checkpoint.indice_pronto[construtor] = 1;
+    if (!ctx->reconstruir) gravar_checkpoint_importacao(&ctx->checkpoint);
+    ponto_de_falha_importacao("indice");
+    pthread_mutex_unlock(&ctx->mutex_checkpoint);
+}
+
+// Pe no lugar os temporrios que o ndice gravou e reabre os arquivos dele
+void trocar_arquivos_indice(ContextoImportacao *ctx, int construtor) {
+    if (construtor < 5) {
+        ArvoreBmais *a = &arvores[construtor];
+        trocar_arvore_bmais(a);
+        char nome[TAM_CAMINHO];
+        nome_manifesto_lsm(&a->lsm, nome);
+        if (trocar_arquivo_tmp(nome)) {
+            a->motor = lsm_ler_manifesto(&a->lsm) ? MOTOR_LSM : MOTOR_BMAIS;
+            lsm_publicar_versao(&a->lsm, NULL, 0);
+        }
+    } else if (construtor == CONSTRUTOR_TRIE) {
+        fechar_arquivo_pool(ctx->fp_trie);
+        trocar_arquivo_tmp(nome_trie_bin);
+        ctx->fp_trie = abrir_arquivo_trie(nome_trie_bin, &ctx->header_trie);
+    } else {
+        fechar_arquivo_pool(ctx->fp_reg_est);
+        trocar_arquivo_tmp(nome_registro_estado_bin);
+        ctx->fp_reg_est = abrir_arquivo_registro_estado(nome_registro_estado_bin, &ctx->header_reg_est);
+    }
+}
+
+// Temporrios de ndices que sobraram de um REINDEX ou de uma gravao interrompida: um READ novo os apaga,
+// para que a retomada dele nunca ponha no lugar um que ele no gravou
+void descartar_temporarios_indices() {
+    for (int c = 0; c < QTD_CONSTRUTORES; c++) {
+        char nomes[4][TAM_CAMINHO], nome_tmp[TAM_CAMINHO];
+        int qtd = arquivos_indice_importacao(c, nomes);
+        for (int i = 0; i < qtd; i++) {
+            montar_caminho(nome_tmp, sizeof(nome_tmp), "%s.tmp", nomes[i]);
+            remove(nome_tmp);
+        }
+    }
+}
+
+// Retomada: conclui a troca dos ndices j prontos. Uma rvore que estava vazia e era construda no lugar
+// quando o READ parou volta a ficar vazia (os metadados dela podem j apontar para a construo incompleta)
+void concluir_indices_checkpoint(ContextoImportacao *ctx) {
+    CheckpointImportacao *ck = &ctx->checkpoint;
+    for (int c = 0; c < QTD_CONSTRUTORES; c++) {
+        if (ck->indice_pronto[c]) {
+            trocar_arquivos_indice(ctx, c);
+        } else if (c < 5 && !ck->mesclar[c] && ck->motor[c] == MOTOR_BMAIS && arvores[c].motor == MOTOR_BMAIS) {
+            iniciar_arquivo_metadados(arvores[c].f_metadados);
+        }
+    }
+}
+
+// Primeiro checkpoint de um READ novo: guarda como estavam os ndices antes de qualquer mudana
+void iniciar_checkpoint_importacao(ContextoImportacao *ctx, const char *nome_csv) {
+    CheckpointImportacao *ck = &ctx->checkpoint;
+    memset(ck, 0, sizeof(CheckpointImportacao));
+    ck->versao = VERSAO_CHECKPOINT_IMPORTACAO;
+    snprintf(ck->csv, sizeof(ck->csv), "%s", nome_csv);
+    ck->tamanho_csv = tamanho_arquivo(nome_csv);
+    ck->registro_inicial = ctx->header.qtd_registros;
+    ck->header_loc_inicial = ctx->header_loc;
+    ck->header_gab_inicial = ctx->header_gab;
+    if (ctx->fp_extra) ck->header_extra_inicial = ctx->header_extra;
+    ck->header_trie = ctx->header_trie;
+    ck->header_reg_est = ctx->header_reg_est;
+    for (int i = 0; i < 5; i++) {
+        le_metadados_em(arvores[i].f_metadados, &ck->metadados[i]);
+        ck->mesclar[i] = !indice_nota_vazio(&arvores[i]);
+        ck->motor[i] = arvores[i].motor;
+        ck->proximo_id_lsm[i] = arvores[i].lsm.manifesto.proximo_id;
+    }
+    checkpoint_importacao(ctx);
+}
+
+// Confere se os ndices ainda no gravados esto como antes do READ interrompido
+int indices_consistentes_checkpoint(ContextoImportacao *ctx) {
+    CheckpointImportacao *ck = &ctx->checkpoint;
+    if (!ck->indice_pronto[CONSTRUTOR_TRIE] && memcmp(&ck->header_trie, &ctx->header_trie, sizeof(HeaderTrie)) != 0) return 0;
+    if (!ck->indice_pronto[CONSTRUTOR_ESTADO] && memcmp(&ck->header_reg_est, &ctx->header_reg_est, sizeof(HeaderRegistroEstado)) != 0) return 0;
+    for (int i = 0; i < 5; i++) {
+        if (ck->indice_pronto[i]) continue;
+        Metadados md;
+        if (!le_metadados_em(arvores[i].f_metadados, &md) || memcmp(&md, &ck->metadados[i], sizeof(Metadados)) != 0) return 0;
+        if (arvores[i].motor != ck->motor[i] || arvores[i].lsm.manifesto.proximo_id != ck->proximo_id_lsm[i]) return 0;
+    }
+    return 1;
+}
+
+// Volta os arquivos principais ao ltimo checkpoint: regrava os cabealhos confirmados
+// e corta os registros gravados depois dele
+void restaurar_checkpoint_importacao(ContextoImportacao *ctx) {
+    CheckpointImportacao *ck = &ctx->checkpoint;
+    ctx->header = ck->header;
+    ctx->header_loc = ck->header_loc;
+    ctx->header_gab = ck->header_gab;
+    gravar_cabecalho(ctx->fp_bin, &ctx->header, tamanho_header());
+    gravar_cabecalho(ctx->fp_respostas, &ctx->header, tamanho_header());
+    gravar_cabecalho(ctx->fp_loc, &ctx->header_loc, tamanho_header_localizacao());
+    gravar_cabecalho(ctx->fp_gab, &ctx->header_gab, tamanho_header_prova());
+    if (ctx->fp_extra) {
+        if (ck->header_extra.qtd_colunas > 0) {
+            ctx->header_extra = ck->header_extra;
+        } else {
+            // Arquivo criado agora (colunas extras escolhidas depois da interrupo)
+            ctx->header_extra.primeiro_registro = ctx->header.qtd_registros;
+            ctx->header_extra.qtd_registros = 0;
+        }
+        gravar_cabecalho(ctx->fp_extra, &ctx->header_extra, tamanho_header_extras());
+    }
+    ctx->linhas_lidas = ck->linhas_lidas;
+    ctx->linhas_rejeitadas = ck->linhas_rejeitadas;
+    memcpy(ctx->estat.rejeitadas, ck->rejeitadas, sizeof(ck->rejeitadas));
+    ctx->estat.bytes_lidos = (size_t)ck->bytes_lidos;
+}
+
+// Desfaz um READ que falhou: os arquivos principais voltam a como estavam antes dele, mesmo que algum
+// checkpoint j tenha confirmado participantes. O checkpoint volta antes ao incio do READ, e uma
+// interrupo no meio daqui deixa s um READ a refazer do zero
+void desfazer_transacao_importacao(ContextoImportacao *ctx) {
+    CheckpointImportacao *ck = &ctx->checkpoint;
+    ck->header.qtd_registros = ck->registro_inicial;
+    ck->header_loc = ck->header_loc_inicial;
+    ck->header_gab = ck->header_gab_inicial;
+    ck->header_extra = ck->header_extra_inicial;
+    ck->bytes_lidos = 0;
+    ck->linhas_lidas = 0;
+    ck->linhas_rejeitadas = 0;
+    memset(ck->rejeitadas, 0, sizeof(ck->rejeitadas));
+    gravar_checkpoint_importacao(ck);
+    restaurar_checkpoint_importacao(ctx);
+    // Em segundo plano uma verso publicada num checkpoint pode ter mapeado os participantes novos: os
+    // arquivos ficam com o tamanho atual e so cortados no incio do prximo READ
+    if (!ctx->em_segundo_plano) iniciar_transacao_importacao(ctx);
+    remove(nome_checkpoint_importacao);
+}
+
+// Aplica a tupla a um dos ndices (uma das rvores B+, a Trie ou o ndice por Estado)
+void indexar_tupla(ContextoImportacao *ctx, int construtor, const TuplaIndice *t) {
+    if (ctx->checkpoint.indice_pronto[construtor]) return; // J gravado antes da interrupo
+    if (construtor < 5) {
+        EntradaIndiceNota entrada = { .nota = t->notas[construtor], .indice_registro = t->indice_registro };
+        ordext_adicionar(&ctx->cargas[construtor], &entrada);
+    } else if (construtor == CONSTRUTOR_TRIE) {
+        // Sem checkpoint: a Trie anterior segue vlida no disco at a gravao final
+        trie_memoria_inserir(&ctx->trie, t->nu_seq, t->indice_registro);
+    } else if (t->estado[0] != '\0') {
+        // Nota: O `estado`  a sigla lida do CSV (Ex: "RS"); vazio se no h escola
+        registros_estado_adicionar(&ctx->estados, t->estado, t->indice_registro);
+    }
+}
+
+// Fim da leitura: cada ndice  construdo (ou intercalado com o existente) e gravado agora. O que substitui
+// arquivos existentes  gravado em temporrios, que s entram no lugar depois de o ndice ser marcado pronto
+void finalizar_indice(ContextoImportacao *ctx, int construtor) {
+    if (ctx->checkpoint.indice_pronto[construtor]) return;
+    if (ctx->desfazer) {
+        // O ndice fica como estava; as cargas das rvores so liberadas com o contexto
+        if (construtor == CONSTRUTOR_TRIE) trie_memoria_liberar(&ctx->trie);
+        if (construtor == CONSTRUTOR_ESTADO) registros_estado_liberar(&ctx->estados);
+        return;
+    }
+    double inicio = relogio_segundos();
+    if (construtor < 5) {
+        ArvoreBmais *a = &arvores[construtor];
+        ordext_finalizar(&ctx->cargas[construtor]);
+        FonteEntradasNota novas = fonte_de_ordenacao(&ctx->cargas[construtor]);
+        if (a->motor == MOTOR_LSM) {
+            // A carga ordenada vira uma run; no REINDEX ela substitui todas (e a B+ antiga, se havia)
+            if (ctx->reconstruir) {
+                lsm_substituir_runs(&a->lsm, &novas);
+                esvaziar_arvore_bmais(a);
+            } else if (novas.total > 0) {
+                lsm_acrescentar_run(&a->lsm, &novas);
+            }
+        } else if (ctx->reconstruir) {
+            gravar_arvore_bmais_tmp(a, &novas);
+        } else if (ctx->mesclar[construtor]) {
+            if (novas.total > 0) mesclar_arvore_bmais(a, &novas);
+        } else if (ctx->em_segundo_plano) {
+            // A rvore vazia pode estar aberta numa verso publicada: a nova entra por rename
+            gravar_arvore_bmais_tmp(a, &novas);
+        } else {
+            construir_bmais_em_lote(&novas, a->f_metadados, a->f_indice, a->f_dados);
+        }
+    } else if (construtor == CONSTRUTOR_TRIE) {
+        trie_memoria_gravar(&ctx->trie, nome_trie_bin, &ctx->header_trie);
+        trie_memoria_liberar(&ctx->trie);
+    } else if (construtor == CONSTRUTOR_ESTADO) {
+        registros_estado_gravar(&ctx->estados, ctx->fp_reg_est, &ctx->header_reg_est, nome_registro_estado_bin, &ctx->header_reg_est);
+        registros_estado_liberar(&ctx->estados);
+    }
+    marcar_indice_pronto(ctx, construtor);
+    trocar_arquivos_indice(ctx, construtor);
+    if (construtor < 5) {
+        ArvoreBmais *a = &arvores[construtor];
+        if (a->motor == MOTOR_BMAIS && ctx->reconstruir) {
+            lsm_remover(&a->lsm);
+        } else if (a->motor == MOTOR_LSM && !ctx->em_segundo_plano) {
+            // Em segundo plano a compactao espera o fim do READ, que tambm mexe no manifesto
+            lsm_iniciar_compactacao(&a->lsm);
+        }
+    }
+    ctx->estat.seg_construcao[construtor] += relogio_segundos() - inicio;
+}
+
+typedef struct {
+    ContextoImportacao *ctx;
+    int construtor;
+} ArgConstrutorIndice;
+
+void *thread_construtor_indice(void *arg) {
+    ArgConstrutorIndice *a = (ArgConstrutorIndice *)arg;
+    FluxoIndices *f = a->ctx->fluxo;
+    long disponiveis;
+
+    while ((disponiveis = fluxo_esperar(f, a->construtor)) > 0) {
+        long cursor = f->cursores[a->construtor]; // S esta thread altera o prprio cursor
+        double inicio = relogio_segundos();
+        for (long i = 0; i < disponiveis; i++) {
+            indexar_tupla(a->ctx, a->construtor, &f->tuplas[(cursor + i) % CAPACIDADE_FLUXO_INDICES]);
+        }
+        a->ctx->estat.seg_indice[a->construtor] += relogio_segundos() - inicio;
+        fluxo_avancar(f, a->construtor, disponiveis);
+    }
+    finalizar_indice(a->ctx, a->construtor);
+    return NULL;
+}
+
+// Threads construtoras de um READ ou REINDEX, uma por ndice
+typedef struct {
+    FluxoIndices fluxo;
+    pthread_t threads[QTD_CONSTRUTORES];
+    ArgConstrutorIndice args[QTD_CONSTRUTORES];
+} ConstrutoresIndices;
+
+// Com CONSTRUCAO_PARALELA_INDICES inicia as threads e o fluxo; seno os ndices so atualizados em linha
+void iniciar_construtores_indices(ContextoImportacao *ctx, ConstrutoresIndices *c) {
+    if (!CONSTRUCAO_PARALELA_INDICES) return;
+    fluxo_inicializar(&c->fluxo);
+    ctx->fluxo = &c->fluxo;
+    for (int i = 0; i < QTD_CONSTRUTORES; i++) {
+        c->args[i].ctx = ctx;
+        c->args[i].construtor = i;
+        pthread_create(&c->threads[i], NULL, thread_construtor_indice, &c->args[i]);
+    }
+}
+
+// Fim das tuplas: cada ndice  construdo e gravado (pela sua thread, se houver)
+void finalizar_construtores_indices(ContextoImportacao *ctx, ConstrutoresIndices *c) {
+    if (ctx->fluxo) {
+        fluxo_encerrar(&c->fluxo);
+        for (int i = 0; i < QTD_CONSTRUTORES; i++) {
+            pthread_join(c->threads[i], NULL);
+        }
+        fluxo_destruir(&c->fluxo);
+        ctx->fluxo = NULL;
+    } else {
+        for (int i = 0; i < QTD_CONSTRUTORES; i++) {
+            finalizar_indice(ctx, i);
+        }
+    }
+}
+
+// Uma ordenao externa por rvore B+; o limite de memria  dividido entre as 5. As runs ficam no
+// diretrio da verso da base, como os ndices: um RELOAD no divide o diretrio com a sesso em uso
+// Memria de ordenao (CONFIG MEMORIA) das cargas das rvores; em segundo plano metade fica para os
+// segmentos parciais dos checkpoints
+size_t memoria_ordenacao_importacao(ContextoImportacao *ctx) {
+    size_t memoria = (size_t)(MEMORIA_ORDENACAO_MB * 1024 * 1024);
+    return ctx->em_segundo_plano ? memoria / 2 : memoria;
+}
 
-    long offset = tamanho_header_localizacao() + indice * tamanho_localizacao();
-    if (fseek(fp_loc, offset, SEEK_SET) != 0) {
-        free(loc);
-        return NULL;
+void iniciar_cargas_bmais(ContextoImportacao *ctx) {
+    for (int i = 0; i < 5; i++) {
+        char nome[TAM_NOME_ARQUIVO_BASE], prefixo[TAM_CAMINHO];
+        montar_caminho(nome, sizeof(nome), "ordext_%s", arvores[i].nome);
+        caminho_na_base(prefixo, sizeof(prefixo), nome);
+        ordext_inicializar(&ctx->cargas[i], prefixo, sizeof(EntradaIndiceNota), compara_entrada_nota, memoria_ordenacao_importacao(ctx) / 5);
     }
+}
 
-    if (fread(loc, tamanho_localizacao(), 1, fp_loc) != 1) {
-        free(loc);
-        return NULL;
+void liberar_cargas_bmais(ContextoImportacao *ctx) {
+    for (int i = 0; i < 5; i++) {
+        printf("%s: %ld entradas ordenadas em %d run(s) e %d passada(s) de merge\n",
+               arvores[i].nome, ctx->cargas[i].total_elementos, ctx->cargas[i].qtd_runs_geradas, ctx->cargas[i].passes_merge);
+    }
+    for (int i = 0; i < 5; i++) {
+        ordext_liberar(&ctx->cargas[i]);
     }
+}
 
-    return loc;
+// Entrega a tupla aos ndices: pelo fluxo das threads construtoras ou direto, em linha
+void entregar_tupla_indices(ContextoImportacao *ctx, const TuplaIndice *t) {
+    double t_anterior = relogio_segundos();
+    if (ctx->fluxo) {
+        fluxo_adicionar(ctx->fluxo, t);
+        ctx->estat.seg_publicacao += relogio_segundos() - t_anterior;
+    } else {
+        for (int c = 0; c < QTD_CONSTRUTORES; c++) {
+            indexar_tupla(ctx, c, t);
+            double t_atual = relogio_segundos();
+            ctx->estat.seg_indice[c] += t_atual - t_anterior;
+            t_anterior = t_atual;
+        }
+    }
 }
 
-// Busca Localizao por cdigo - Usado apenas durante a importao para garantir unicidade
-int buscar_indice_localizacao_por_cod_esc(FILE *fp_loc, HeaderLocalizacao *h_loc, const char *cod_esc) {
-    Localizacao temp_loc;
+#define PARTICIPANTES_POR_LEITURA 8192
 
-    // Inicia a busca aps o header
-    fseek(fp_loc, tamanho_header_localizacao(), SEEK_SET);
+typedef char SiglaEstado[20]; // Mesmo tamanho de Localizacao.estado
 
-    for (int i = 0; i < h_loc->qtd_registros; i++) {
-        if (fread(&temp_loc, tamanho_localizacao(), 1, fp_loc) != 1) {
-            return -1; // Erro
-        }
-        if (strcmp(temp_loc.cod_esc, cod_esc) == 0) {
-            return i; // Encontrou o ndice
+// Estado (SG_UF_ESC) de cada localizao, na ordem do arquivo. O chamador libera
+SiglaEstado *carregar_estados_localizacoes(ContextoImportacao *ctx) {
+    SiglaEstado *estados = (SiglaEstado *)malloc((size_t)MAX(ctx->header_loc.qtd_registros, 1) * sizeof(*estados));
+    if (!estados) { perror("Erro ao alocar estados das localizacoes"); exit(1); }
+    Localizacao loc;
+    fflush(ctx->fp_loc);
+    fseek(ctx->fp_loc, tamanho_header_localizacao(), SEEK_SET);
+    for (int i = 0; i < ctx->header_loc.qtd_registros; i++) {
+        if (fread(&loc, tamanho_localizacao(), 1, ctx->fp_loc) != 1) loc.estado[0] = '\0';
+        strcpy(estados[i], loc.estado);
+    }
+    fseek(ctx->fp_loc, 0, SEEK_END);
+    return estados;
+}
+
+// Passa para `acao` a tupla de cada participante [inicio, fim) j gravado, lidos em sequncia em blocos.
+// O Estado  o da escola (o SG_UF_ESC da linha que criou a localizao). Retorna quantos foram lidos
+int percorrer_participantes_gravados(ContextoImportacao *ctx, SiglaEstado *estados, int inicio, int fim,
+                                     void (*acao)(void *arg, const TuplaIndice *t), void *arg) {
+    RegistroCompacto *bloco = (RegistroCompacto *)malloc(PARTICIPANTES_POR_LEITURA * tamanho_participante());
+    if (!bloco) { perror("Erro ao alocar bloco de participantes"); exit(1); }
+    TuplaIndice t;
+    int i = inicio;
+    fflush(ctx->fp_bin);
+    fseek(ctx->fp_bin, tamanho_header() + (long)inicio * tamanho_participante(), SEEK_SET);
+    while (i < fim) {
+        size_t lidos = fread(bloco, tamanho_participante(), MIN(fim - i, PARTICIPANTES_POR_LEITURA), ctx->fp_bin);
+        if (lidos == 0) break;
+        for (size_t k = 0; k < lidos; k++, i++) {
+            RegistroParticipante registro;
+            RegistroParticipante *p = &registro;
+            descompactar_registro(&bloco[k], p);
+            t.indice_registro = i;
+            t.notas[0] = p->nota_cn;
+            t.notas[1] = p->nota_ch;
+            t.notas[2] = p->nota_lc;
+            t.notas[3] = p->nota_mt;
+            t.notas[4] = p->nota_red;
+            strcpy(t.nu_seq, p->nu_seq);
+            strcpy(t.estado, p->indice_localizacao >= 0 ? estados[p->indice_localizacao] : "");
+            acao(arg, &t);
         }
     }
+    fseek(ctx->fp_bin, 0, SEEK_END);
+    free(bloco);
+    return i - inicio;
+}
 
-    return -1; // No encontrou
+void entregar_tupla_indices_acao(void *arg, const TuplaIndice *t) {
+    entregar_tupla_indices((ContextoImportacao *)arg, t);
 }
 
-// --- FUNES DE MANIPULAO DO ARQUIVO DE GABARITO ---
+// Entrega aos ndices os participantes [inicio, fim) j gravados. Retorna quantos foram lidos
+int entregar_participantes_indices(ContextoImportacao *ctx, SiglaEstado *estados, int inicio, int fim) {
+    return percorrer_participantes_gravados(ctx, estados, inicio, fim, entregar_tupla_indices_acao, ctx);
+}
 
-FILE *abrir_arquivo_gabarito(const char *nome, HeaderProva *h) {
-    FILE *fp = fopen(nome, "rb+");
+// Retomada: os participantes confirmados antes da interrupo voltam a ser entregues aos ndices
+// ainda no gravados
+void reindexar_participantes_confirmados(ContextoImportacao *ctx) {
+    int inicio = ctx->checkpoint.registro_inicial;
+    int fim = ctx->header.qtd_registros;
+    if (inicio >= fim) return;
+
+    SiglaEstado *estados = carregar_estados_localizacoes(ctx);
+    printf("Reindexando %d participantes ja gravados...\n", fim - inicio);
+    entregar_participantes_indices(ctx, estados, inicio, fim);
+    free(estados);
+}
 
-    if (fp == NULL) {
-        fp = fopen(nome, "wb+");
-        if (fp == NULL) {
-            perror("Erro ao criar arquivo de gabarito");
-            return NULL;
-        }
+// Ordem do arquivo de NU_SEQ de um segmento parcial
+int compara_entrada_nuseq(const void *a, const void *b) {
+    const EntradaNuSeq *ea = (const EntradaNuSeq *)a;
+    const EntradaNuSeq *eb = (const EntradaNuSeq *)b;
+    int c = strcmp(ea->nu_seq, eb->nu_seq);
+    if (c != 0) return c;
+    return (ea->indice_registro > eb->indice_registro) - (ea->indice_registro < eb->indice_registro);
+}
 
-        h->qtd_registros = 0;
-        fwrite(h, tamanho_header_prova(), 1, fp);
-        fflush(fp);
+// ndice de um participante no arquivo de Estados de um segmento parcial, que fica agrupado por Estado
+typedef struct {
+    int estado; // Posio na tabela hash
+    int indice_registro;
+} EntradaEstadoParcial;
+
+int compara_entrada_estado_parcial(const void *a, const void *b) {
+    const EntradaEstadoParcial *ea = (const EntradaEstadoParcial *)a;
+    const EntradaEstadoParcial *eb = (const EntradaEstadoParcial *)b;
+    if (ea->estado != eb->estado) return ea->estado < eb->estado ? -1 : 1;
+    return (ea->indice_registro > eb->indice_registro) - (ea->indice_registro < eb->indice_registro);
+}
 
-    } else {
-        fread(h, tamanho_header_prova(), 1, fp);
+// As ordenaes dos ndices de um segmento parcial em construo
+typedef struct {
+    OrdenacaoExterna notas[5];
+    OrdenacaoExterna nuseq;
+    OrdenacaoExterna estados;
+} ConstrucaoSegmento;
+
+// NU_SEQ que a Trie aceita (s dgitos); os outros tambm no so achados pelo FIND depois do READ
+int nuseq_valido_trie(const char *nu_seq) {
+    for (int i = 0; nu_seq[i] != '\0'; i++) {
+        if (char_to_index(nu_seq[i]) == -1) return 0;
     }
+    return 1;
+}
 
-    return fp;
+void construcao_segmento_adicionar(void *arg, const TuplaIndice *t) {
+    ConstrucaoSegmento *c = (ConstrucaoSegmento *)arg;
+    for (int i = 0; i < 5; i++) {
+        EntradaIndiceNota e = { .nota = t->notas[i], .indice_registro = t->indice_registro };
+        ordext_adicionar(&c->notas[i], &e);
+    }
+    if (nuseq_valido_trie(t->nu_seq)) {
+        EntradaNuSeq e;
+        memset(&e, 0, sizeof(e));
+        snprintf(e.nu_seq, sizeof(e.nu_seq), "%s", t->nu_seq);
+        e.indice_registro = t->indice_registro;
+        ordext_adicionar(&c->nuseq, &e);
+    }
+    // Sem escola ou com sigla desconhecida o participante tambm fica fora do ndice por Estado
+    int hash_index = t->estado[0] != '\0' ? funcao_hash_estado(t->estado) : -1;
+    if (hash_index != -1) {
+        EntradaEstadoParcial e = { .estado = hash_index, .indice_registro = t->indice_registro };
+        ordext_adicionar(&c->estados, &e);
+    }
 }
 
-// Salva e retorna o ndice onde a Prova foi salva
-int salvar_gabarito(FILE *fp_gab, HeaderProva *h_gab, Prova *prova) {
-    int indice_registro = h_gab->qtd_registros;
-    long offset = tamanho_header_prova() + indice_registro * tamanho_prova();
-    fseek(fp_gab, offset, SEEK_SET);
-    fwrite(prova, tamanho_prova(), 1, fp_gab);
+// Grava o arquivo de NU_SEQ do segmento. Retorna 0 em caso de sucesso
+int gravar_nuseq_parcial(SegmentoParcial *s, OrdenacaoExterna *ord) {
+    char nome[TAM_CAMINHO];
+    nome_arquivo_parcial(s, "nuseq", nome);
+    FILE *f = fopen(nome, "wb");
+    if (!f) {
+        perror("Erro ao criar segmento parcial");
+        return 1;
+    }
+    ordext_finalizar(ord);
+    EntradaNuSeq e;
+    while (ordext_proximo(ord, &e)) {
+        fwrite(&e, sizeof(e), 1, f);
+        s->qtd_nuseq++;
+    }
+    int erro = ferror(f);
+    if (fclose(f) != 0) erro = 1;
+    if (erro) perror("Erro ao gravar segmento parcial");
+    return erro;
+}
 
-    h_gab->qtd_registros++;
-    fseek(fp_gab, 0, SEEK_SET);
-    fwrite(h_gab, tamanho_header_prova(), 1, fp_gab);
-    fflush(fp_gab);
+// Grava o arquivo de Estados do segmento (os ndices de cada Estado em sequncia) e o trecho de cada um.
+// Retorna 0 em caso de sucesso
+int gravar_estados_parcial(SegmentoParcial *s, OrdenacaoExterna *ord) {
+    char nome[TAM_CAMINHO];
+    nome_arquivo_parcial(s, "estado", nome);
+    FILE *f = fopen(nome, "wb");
+    if (!f) {
+        perror("Erro ao criar segmento parcial");
+        return 1;
+    }
+    ordext_finalizar(ord);
+    EntradaEstadoParcial e;
+    int pos = 0;
+    while (ordext_proximo(ord, &e)) {
+        if (s->qtd_estado[e.estado]++ == 0) s->inicio_estado[e.estado] = pos;
+        fwrite(&e.indice_registro, sizeof(int), 1, f);
+        pos++;
+    }
+    int erro = ferror(f);
+    if (fclose(f) != 0) erro = 1;
+    if (erro) perror("Erro ao gravar segmento parcial");
+    return erro;
+}
 
-    return indice_registro;
+// Grava o segmento parcial dos participantes [primeiro, fim), j confirmados num checkpoint.
+// Retorna NULL em caso de erro
+SegmentoParcial *construir_segmento_parcial(ContextoImportacao *ctx, int primeiro, int fim) {
+    SegmentoParcial *s = (SegmentoParcial *)calloc(1, sizeof(SegmentoParcial));
+    if (!s) { perror("Erro ao alocar segmento parcial"); exit(1); }
+    s->refs = 1;
+    s->id = ctx->proximo_id_parcial++;
+    s->primeiro = primeiro;
+    s->qtd = fim - primeiro;
+    caminho_na_base(s->prefixo, sizeof(s->prefixo), "parcial");
+
+    // A metade da memria de ordenao que as cargas das rvores deixam, dividida entre as 7 ordenaes
+    ConstrucaoSegmento c;
+    size_t memoria = memoria_ordenacao_importacao(ctx) / 7;
+    char nome[TAM_NOME_ARQUIVO_BASE], prefixo[TAM_CAMINHO];
+    for (int i = 0; i < 5; i++) {
+        montar_caminho(nome, sizeof(nome), "parcial_ordext_%s", arvores[i].nome);
+        caminho_na_base(prefixo, sizeof(prefixo), nome);
+        ordext_inicializar(&c.notas[i], prefixo, sizeof(EntradaIndiceNota), compara_entrada_nota, memoria);
+    }
+    caminho_na_base(prefixo, sizeof(prefixo), "parcial_ordext_nuseq");
+    ordext_inicializar(&c.nuseq, prefixo, sizeof(EntradaNuSeq), compara_entrada_nuseq, memoria);
+    caminho_na_base(prefixo, sizeof(prefixo), "parcial_ordext_estado");
+    ordext_inicializar(&c.estados, prefixo, sizeof(EntradaEstadoParcial), compara_entrada_estado_parcial, memoria);
+
+    SiglaEstado *estados = carregar_estados_localizacoes(ctx);
+    int erro = percorrer_participantes_gravados(ctx, estados, primeiro, fim, construcao_segmento_adicionar, &c) != s->qtd;
+    free(estados);
+    for (int i = 0; i < 5 && !erro; i++) {
+        ordext_finalizar(&c.notas[i]);
+        FonteEntradasNota fonte = fonte_de_ordenacao(&c.notas[i]);
+        prefixo_notas_parcial(s, arvores[i].nome, prefixo);
+        erro = lsm_gravar_run(prefixo, s->id, &fonte) != s->qtd;
+    }
+    if (!erro) erro = gravar_nuseq_parcial(s, &c.nuseq);
+    if (!erro) erro = gravar_estados_parcial(s, &c.estados);
+
+    for (int i = 0; i < 5; i++) ordext_liberar(&c.notas[i]);
+    ordext_liberar(&c.nuseq);
+    ordext_liberar(&c.estados);
+    if (erro) {
+        apagar_segmento_parcial(s);
+        free(s);
+        return NULL;
+    }
+    return s;
 }
 
-// Busca de Gabarito por ndice
-Prova *buscar_gabarito_por_indice(FILE *fp_gab, int indice) {
-    Prova *prova = (Prova *)malloc(tamanho_prova());
-    if (!prova) { perror("Erro de alocacao Prova"); return NULL; }
+// Checkpoint de um READ em segundo plano: os participantes confirmados desde o ltimo segmento ganham um
+// segmento parcial e a verso publicada passa a ser a base deste checkpoint com todos os segmentos. Os
+// segmentos seguem a regra de compactao das runs LSM (o novo absorve os anteriores que no so bem
+// maiores que ele): ficam poucos para as consultas intercalarem e cada participante  regravado poucas vezes
+void publicar_checkpoint_segundo_plano(ContextoImportacao *ctx) {
+    int fim = ctx->header.qtd_registros;
+    int inicio = ctx->checkpoint.registro_inicial;
+    if (ctx->qtd_parciais > 0) {
+        SegmentoParcial *ultimo = ctx->parciais[ctx->qtd_parciais - 1];
+        inicio = ultimo->primeiro + ultimo->qtd;
+    }
+    if (fim <= inicio) return;
 
-    long offset = tamanho_header_prova() + indice * tamanho_prova();
-    if (fseek(fp_gab, offset, SEEK_SET) != 0) {
-        free(prova);
-        return NULL;
+    // O segmento novo entra como a run mais nova de um manifesto com os atuais
+    ManifestoLsm m;
+    memset(&m, 0, sizeof(m));
+    for (int i = 0; i < ctx->qtd_parciais; i++) {
+        m.runs[i].qtd = ctx->parciais[i]->qtd;
     }
+    m.runs[ctx->qtd_parciais].qtd = fim - inicio;
+    m.qtd_runs = ctx->qtd_parciais + 1;
+    int primeira = lsm_escolher_compactacao(&m);
+    if (primeira == -1) primeira = ctx->qtd_parciais;
+
+    int primeiro = primeira < ctx->qtd_parciais ? ctx->parciais[primeira]->primeiro : inicio;
+    SegmentoParcial *s = construir_segmento_parcial(ctx, primeiro, fim);
+    if (!s) return; // A verso do checkpoint anterior continua publicada
+    for (int i = primeira; i < ctx->qtd_parciais; i++) {
+        liberar_segmento_parcial(ctx->parciais[i]);
+    }
+    ctx->parciais[primeira] = s;
+    ctx->qtd_parciais = primeira + 1;
 
-    if (fread(prova, tamanho_prova(), 1, fp_gab) != 1) {
-        free(prova);
-        return NULL;
+    VersaoLeitura *v = abrir_versao_leitura();
+    for (int i = 0; i < ctx->qtd_parciais; i++) {
+        v->parciais[i] = reter_segmento_parcial(ctx->parciais[i]);
     }
+    v->qtd_parciais = ctx->qtd_parciais;
+    publicar_versao_leitura(v);
+}
 
-    return prova;
+// Fim do READ em segundo plano: os arquivos dos segmentos ficam at as verses que os usam serem liberadas
+void liberar_segmentos_parciais(ContextoImportacao *ctx) {
+    for (int i = 0; i < ctx->qtd_parciais; i++) {
+        liberar_segmento_parcial(ctx->parciais[i]);
+    }
+    ctx->qtd_parciais = 0;
 }
 
-// Busca Gabarito por cdigo de prova - Usado apenas durante a importao para garantir unicidade
-int buscar_indice_gabarito_por_cod_prova(FILE *fp_gab, HeaderProva *h_gab, const char *cod_prova) {
-    Prova temp_prova;
+// Apaga os segmentos parciais (e as ordenaes deles) que um READ em segundo plano interrompido deixou
+void descartar_segmentos_parciais() {
+#ifndef _WIN32
+    DIR *d = opendir(DIRETORIO_BASE);
+    if (!d) return;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        if (strncmp(e->d_name, "parcial_", 8) != 0) continue;
+        char nome[TAM_CAMINHO];
+        caminho_na_base(nome, sizeof(nome), e->d_name);
+        remove(nome);
+    }
+    closedir(d);
+#endif
+}
 
-    // Inicia a busca aps o header
-    fseek(fp_gab, tamanho_header_prova(), SEEK_SET);
+// Grava uma linha j interpretada: tabelas separadas, participante e ndices
+void registrar_linha_importada(ContextoImportacao *ctx, LinhaCsv *linha) {
+    Participante p = linha->p;
+    double t_inicio = relogio_segundos();
 
-    for (int i = 0; i < h_gab->qtd_registros; i++) {
-        if (fread(&temp_prova, tamanho_prova(), 1, fp_gab) != 1) {
-            return -1; // Erro
-        }
-        // Comparao usando o cod_prova
-        if (strcmp(temp_prova.cod_prova, cod_prova) == 0) {
-            return i; // Encontrou o ndice
+    // --- 1. PROCESSAMENTO DE LOCALIZAO ---
+
+    // Sem CO_ESCOLA o participante fica sem localizao (ndice -1)
+    int indice_loc = (linha->cod_esc[0] != '\0') ? dicionario_buscar(&ctx->dic_loc, linha->cod_esc) : -1;
+
+    if (indice_loc == -1 && linha->cod_esc[0] != '\0') {
+        Localizacao nova_loc;
+        memset(&nova_loc, 0, sizeof(Localizacao));
+        strcpy(nova_loc.cod_esc, linha->cod_esc);
+        strcpy(nova_loc.cidade, linha->cidade);
+        strcpy(nova_loc.estado, linha->estado);
+        indice_loc = salvar_localizacao(ctx->fp_loc, &ctx->header_loc, &nova_loc);
+        dicionario_inserir(&ctx->dic_loc, nova_loc.cod_esc, indice_loc);
+    }
+
+    p.indice_localizacao = indice_loc;
+
+    // --- 2. PROCESSAMENTO DE GABARITO ---
+
+    // Ponteiros para os campos de ndice na struct Participante
+    int *indices_gab_ptr[] = {
+        &p.indice_gabarito_cn,
+        &p.indice_gabarito_ch,
+        &p.indice_gabarito_lc,
+        &p.indice_gabarito_mt
+    };
+
+    for (int i = 0; i < 4; i++) {
+        char *cod_prova_str = linha->cod_prova[i];
+        if (cod_prova_str[0] == '\0') continue; // Sem prova nesta rea: ndice fica -1
+
+        // Busca o ndice do gabarito para este cdigo de prova
+        int indice_gab = dicionario_buscar(&ctx->dic_gab, cod_prova_str);
+
+        if (indice_gab == -1) {
+            // Salva o novo registro (cdigo de prova individual + gabarito)
+            Prova nova_gab;
+            memset(&nova_gab, 0, sizeof(Prova));
+            strcpy(nova_gab.cod_prova, cod_prova_str);
+            strcpy(nova_gab.gabarito, linha->gabarito[i]);
+            indice_gab = salvar_gabarito(ctx->fp_gab, &ctx->header_gab, &nova_gab);
+            dicionario_inserir(&ctx->dic_gab, nova_gab.cod_prova, indice_gab);
         }
+
+        // Armazena o ndice no campo especfico do Participante
+        *indices_gab_ptr[i] = indice_gab;
+    }
+
+    double t_dimensoes = relogio_segundos();
+    ctx->estat.seg_dimensoes += t_dimensoes - t_inicio;
+
+    // --- 3. INSERIR PARTICIPANTE ---
+    int indice_registro = gravar_participante(ctx->fp_bin, ctx->fp_respostas, &ctx->header, &p);
+    if (ctx->fp_extra) {
+        gravar_registro_extra(ctx->fp_extra, &ctx->header_extra, linha->extra);
     }
 
-    return -1; // No encontrou
+    double t_participante = relogio_segundos();
+    ctx->estat.seg_participantes += t_participante - t_dimensoes;
+
+    // --- 4. NDICES (5 RVORES B+, TRIE E ESTADO) ---
+    TuplaIndice t;
+    t.indice_registro = indice_registro;
+    t.notas[0] = NOTA_DE_FLOAT(p.nota_cn);
+    t.notas[1] = NOTA_DE_FLOAT(p.nota_ch);
+    t.notas[2] = NOTA_DE_FLOAT(p.nota_lc);
+    t.notas[3] = NOTA_DE_FLOAT(p.nota_mt);
+    t.notas[4] = NOTA_DE_FLOAT(p.nota_red);
+    strcpy(t.nu_seq, p.nu_seq);
+    strcpy(t.estado, linha->estado);
+    entregar_tupla_indices(ctx, &t);
+
+    ctx->linhas_lidas++;
 }
 
-// --- FUNES DE MANIPULAO DO ARQUIVO DE PARTICIPANTE ---
+// Nome do ndice de cada construtor, para o resumo
+const char *nome_construtor_indice(int construtor) {
+    if (construtor < 5) return arvores[construtor].nome;
+    return (construtor == CONSTRUTOR_TRIE) ? "trie_nuseq" : "reg_por_estado";
+}
 
-FILE *abrir_arquivo_participantes(const char *nome, HeaderParticipantes *h) {
-    FILE *fp = fopen(nome, "rb+");
+// Mostra o progresso se j passou INTERVALO_PROGRESSO_SEG desde a ltima vez
+void mostrar_progresso_importacao(ContextoImportacao *ctx) {
+    if (ctx->em_segundo_plano) return; // O terminal  dos comandos; o menu mostra os participantes visveis
+    EstatisticasImportacao *e = &ctx->estat;
+    double agora = relogio_segundos();
+    if (agora - e->ultimo_progresso < INTERVALO_PROGRESSO_SEG) return;
+    e->ultimo_progresso = agora;
+
+    double decorrido = agora - e->inicio;
+    char porcentagem[32] = "";
+    if (e->bytes_total) snprintf(porcentagem, sizeof(porcentagem), " (%.1f%% do CSV)", 100.0 * e->bytes_lidos / e->bytes_total);
+    printf("Progresso: %d linhas%s | %.0f linhas/s | %.1f MB/s | %d rejeitadas\n",
+           ctx->linhas_lidas, porcentagem,
+           ctx->linhas_lidas / decorrido,
+           e->bytes_lidos / (1024.0 * 1024.0) / decorrido,
+           ctx->linhas_rejeitadas);
+    fflush(stdout);
+}
 
-    if (fp == NULL) {
-        fp = fopen(nome, "wb+");
-        if (fp == NULL) {
-            perror("Erro ao criar arquivo de participantes");
-            return NULL;
-        }
+// Tempos por etapa na tela e o resumo completo em JSON (nome_resumo_importacao)
+void gravar_resumo_importacao(ContextoImportacao *ctx, const char *nome_csv, int qtd_threads) {
+    EstatisticasImportacao *e = &ctx->estat;
+    double linhas_por_seg = e->seg_total > 0 ? ctx->linhas_lidas / e->seg_total : 0;
+    double mb_por_seg = e->seg_total > 0 ? e->bytes_total / (1024.0 * 1024.0) / e->seg_total : 0;
+
+    printf("Tempo total: %.2f s (%.0f linhas/s, %.1f MB/s)\n", e->seg_total, linhas_por_seg, mb_por_seg);
+    printf("Tempo por etapa (s): interpretacao do CSV %.2f (soma das threads) | espera pela leitura %.2f | "
+           "dimensoes %.2f | participantes %.2f | entrega aos indices %.2f\n",
+           e->seg_interpretacao, e->seg_espera_leitura, e->seg_dimensoes, e->seg_participantes, e->seg_publicacao);
+    for (int c = 0; c < QTD_CONSTRUTORES; c++) {
+        printf("  %s: %.2f durante a leitura + %.2f na construcao\n",
+               nome_construtor_indice(c), e->seg_indice[c], e->seg_construcao[c]);
+    }
+    for (int m = 1; m < QTD_MOTIVOS_REJEICAO; m++) {
+        if (e->rejeitadas[m] > 0) printf("  Rejeitadas por %s: %d\n", NOMES_MOTIVOS_REJEICAO[m], e->rejeitadas[m]);
+    }
 
-        h->qtd_registros = 0;
-        fwrite(h, tamanho_header(), 1, fp);
-        fflush(fp);
+    FILE *fp = fopen(nome_resumo_importacao, "w");
+    if (!fp) {
+        perror("Erro ao gravar o resumo da importacao");
+        return;
+    }
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"csv\": \"");
+    for (const char *c = nome_csv; *c; c++) {
+        if (*c == '"' || *c == '\\') fputc('\\', fp); // Escapa aspas e barras (caminhos do Windows)
+        fputc(*c, fp);
+    }
+    fprintf(fp, "\",\n");
+    fprintf(fp, "  \"threads_leitura\": %d,\n", qtd_threads);
+    fprintf(fp, "  \"limpeza\": %s,\n", LIMPEZA_IMPORTACAO ? "true" : "false");
+    fprintf(fp, "  \"indices_em_paralelo\": %s,\n", CONSTRUCAO_PARALELA_INDICES ? "true" : "false");
+    fprintf(fp, "  \"bytes\": %zu,\n", e->bytes_total);
+    fprintf(fp, "  \"linhas_validas\": %d,\n", ctx->linhas_lidas);
+    fprintf(fp, "  \"linhas_rejeitadas\": %d,\n", ctx->linhas_rejeitadas);
+    fprintf(fp, "  \"rejeitadas_por_motivo\": {");
+    for (int m = 1; m < QTD_MOTIVOS_REJEICAO; m++) {
+        fprintf(fp, "%s\"%s\": %d", m > 1 ? ", " : "", NOMES_MOTIVOS_REJEICAO[m], e->rejeitadas[m]);
+    }
+    fprintf(fp, "},\n");
+    fprintf(fp, "  \"segundos_total\": %.3f,\n", e->seg_total);
+    fprintf(fp, "  \"linhas_por_segundo\": %.1f,\n", linhas_por_seg);
+    fprintf(fp, "  \"mb_por_segundo\": %.2f,\n", mb_por_seg);
+    fprintf(fp, "  \"etapas\": {\n");
+    fprintf(fp, "    \"interpretacao_csv\": %.3f,\n", e->seg_interpretacao);
+    fprintf(fp, "    \"espera_leitura\": %.3f,\n", e->seg_espera_leitura);
+    fprintf(fp, "    \"dimensoes\": %.3f,\n", e->seg_dimensoes);
+    fprintf(fp, "    \"participantes\": %.3f,\n", e->seg_participantes);
+    fprintf(fp, "    \"entrega_indices\": %.3f\n", e->seg_publicacao);
+    fprintf(fp, "  },\n");
+    fprintf(fp, "  \"indices\": {\n");
+    for (int c = 0; c < QTD_CONSTRUTORES; c++) {
+        fprintf(fp, "    \"%s\": {\"leitura\": %.3f, \"construcao\": %.3f}%s\n",
+                nome_construtor_indice(c), e->seg_indice[c], e->seg_construcao[c], c + 1 < QTD_CONSTRUTORES ? "," : "");
+    }
+    fprintf(fp, "  },\n");
+    fprintf(fp, "  \"registros_localizacao\": %d,\n", ctx->header_loc.qtd_registros);
+    fprintf(fp, "  \"registros_gabarito\": %d,\n", ctx->header_gab.qtd_registros);
+    fprintf(fp, "  \"registros_indice_estado\": %d,\n", ctx->header_reg_est.qtd_nos);
+    fprintf(fp, "  \"nos_trie\": %d\n", ctx->header_trie.qtd_nos);
+    fprintf(fp, "}\n");
+    fclose(fp);
+    printf("Resumo da importacao gravado em %s\n", nome_resumo_importacao);
+}
+
+// Origem das linhas de um READ: o arquivo mapeado ou a sada do descompressor
+typedef struct {
+    int compressao;
+    ArquivoMapeado arquivo;
+    LeitorDescompressao descompressao;
+    BlocoCsv primeiro; // Bloco atual do descompressor, at ser entregue ao LeitorParalelo
+    int tem_primeiro;
+    LeitorCsv leitor;  // Dados depois do cabealho (no arquivo mapeado ou no primeiro bloco)
+    size_t tamanho;    // Tamanho dos dados depois do cabealho (0 se comprimido: s se sabe no fim)
+    MapaColunasCsv mapa;
+} EntradaCsv;
+
+// Fecha o CSV. Comprimido, esvazia a fila para o descompressor poder terminar e retorna o status dele
+int fechar_entrada_csv(EntradaCsv *e) {
+    if (e->compressao == COMPRESSAO_NENHUMA) {
+        desmapear_arquivo(&e->arquivo);
+        return 0;
+    }
+    BlocoCsv bloco = e->primeiro;
+    int tem = e->tem_primeiro;
+    while (tem) {
+        descompressao_liberar_bloco(&e->descompressao, &bloco);
+        tem = descompressao_proximo_bloco(&e->descompressao, &bloco);
+    }
+    e->tem_primeiro = 0;
+    return descompressao_finalizar(&e->descompressao);
+}
 
+// Abre o CSV e interpreta o cabealho. Retorna 0 em caso de sucesso.
+int abrir_entrada_csv(EntradaCsv *e, const char *nome_csv, int qtd_threads, const HeaderExtras *extras) {
+    memset(e, 0, sizeof(EntradaCsv));
+
+    // Comprimido: l a sada do descompressor; seno mapeia o arquivo
+    e->compressao = tipo_compressao_csv(nome_csv);
+    if (e->compressao != COMPRESSAO_NENHUMA) {
+        if (descompressao_iniciar(&e->descompressao, nome_csv, e->compressao, qtd_threads + 2) != 0) return 1;
+        e->tem_primeiro = descompressao_proximo_bloco(&e->descompressao, &e->primeiro);
+        e->leitor.pos = e->primeiro.inicio;
+        e->leitor.fim = e->primeiro.inicio + e->primeiro.tamanho;
     } else {
-        fread(h, tamanho_header(), 1, fp);
+        if (mapear_arquivo(nome_csv, &e->arquivo) != 0) {
+            perror("Erro ao abrir CSV de participantes");
+            return 1;
+        }
+        e->leitor.pos = e->arquivo.dados;
+        e->leitor.fim = e->arquivo.dados + e->arquivo.tamanho;
     }
+    CampoCsv campos[MAX_COLUNAS_CSV];
 
-    return fp;
+    // Com BOM (sada do limpeza.py, utf-8-sig) o texto j  UTF-8; sem BOM  o arquivo original, em latin1
+    int latin1 = 1;
+    if (e->leitor.fim - e->leitor.pos >= 3 && memcmp(e->leitor.pos, "\xEF\xBB\xBF", 3) == 0) {
+        e->leitor.pos += 3;
+        latin1 = 0;
+    }
+
+    // O cabealho diz em que coluna est cada campo
+    int qtd_colunas = proxima_linha_csv(&e->leitor, campos, MAX_COLUNAS_CSV);
+    if (qtd_colunas == -1 || montar_mapa_colunas_csv(campos, qtd_colunas, latin1, extras, &e->mapa) != 0) {
+        if (qtd_colunas == -1) printf("CSV vazio.\n");
+        fechar_entrada_csv(e);
+        return 1;
+    }
+    printf("CSV %sem %s, %d colunas%s.\n",
+           e->compressao == COMPRESSAO_GZIP ? "gzip " : e->compressao == COMPRESSAO_ZSTD ? "zstd " : "",
+           latin1 ? "latin1 (convertido para UTF-8)" : "UTF-8",
+           qtd_colunas, LIMPEZA_IMPORTACAO ? ", descartando linhas com campos vazios" : "");
+
+    if (e->compressao == COMPRESSAO_NENHUMA) e->tamanho = (size_t)(e->leitor.fim - e->leitor.pos);
+    return 0;
 }
 
-// Abre um arquivo B+ (leitura/escrita, cria se no existir)
-FILE *abrir_arquivo_bmais(const char *nome, long tamanho_struct) {
-    FILE *f = fopen(nome, "r+b");
-    if (f == NULL) {
-        f = fopen(nome, "w+b");
-        if (f == NULL) {
-            perror("Erro ao criar arquivo B+ Tree");
-            return NULL;
+// Avana a entrada at 'bytes' depois do cabealho (o ponto de um checkpoint, sempre num fim de linha).
+// Retorna 1 se o CSV acaba antes disso
+int pular_entrada_csv(EntradaCsv *e, long long bytes) {
+    while (bytes > e->leitor.fim - e->leitor.pos) {
+        if (e->compressao == COMPRESSAO_NENHUMA || !e->tem_primeiro) return 1;
+        bytes -= e->leitor.fim - e->leitor.pos;
+        descompressao_liberar_bloco(&e->descompressao, &e->primeiro);
+        e->tem_primeiro = descompressao_proximo_bloco(&e->descompressao, &e->primeiro);
+        if (!e->tem_primeiro) return 1;
+        e->leitor.pos = e->primeiro.inicio;
+        e->leitor.fim = e->primeiro.inicio + e->primeiro.tamanho;
+    }
+    e->leitor.pos += bytes;
+    return 0;
+}
+
+// Threads interpretam o CSV em paralelo; esta thread grava os lotes em ordem
+void ler_lotes_csv(ContextoImportacao *ctx, EntradaCsv *e, int qtd_threads) {
+    LeitorParalelo lp;
+    leitor_paralelo_inicializar(&lp, e->leitor.pos, (size_t)(e->leitor.fim - e->leitor.pos), &e->mapa, qtd_threads);
+    if (e->compressao != COMPRESSAO_NENHUMA) {
+        BlocoCsv primeiro = e->primeiro;
+        primeiro.tamanho -= (size_t)(e->leitor.pos - primeiro.inicio);
+        primeiro.inicio = e->leitor.pos;
+        leitor_paralelo_usar_fonte(&lp, &e->descompressao, primeiro);
+        e->tem_primeiro = 0; // Agora  das threads de leitura
+    }
+    pthread_t *threads = (pthread_t *)malloc(qtd_threads * sizeof(pthread_t));
+    for (int t = 0; t < qtd_threads; t++) {
+        pthread_create(&threads[t], NULL, thread_leitura_csv, &lp);
+    }
+
+    LoteCsv *lote;
+    double t_espera = relogio_segundos();
+    while ((lote = leitor_paralelo_proximo_lote(&lp)) != NULL) {
+        ctx->estat.seg_espera_leitura += relogio_segundos() - t_espera;
+        for (int i = 0; i < lote->qtd; i++) {
+            registrar_linha_importada(ctx, &lote->linhas[i]);
         }
-        // Inicializa o arquivo com o metadados se for o arquivo de metadados
-        if (tamanho_struct == tamanho_metadados()) {
-            iniciar_arquivo_metadados(f);
+        for (int m = 1; m < QTD_MOTIVOS_REJEICAO; m++) {
+            ctx->estat.rejeitadas[m] += lote->rejeitadas[m];
+            ctx->linhas_rejeitadas += lote->rejeitadas[m];
+        }
+        ctx->estat.seg_interpretacao += lote->segundos;
+        ctx->estat.bytes_lidos += lote->bytes;
+        leitor_paralelo_liberar_lote(&lp, lote);
+        if (lote_fecha_checkpoint(ctx)) {
+            checkpoint_importacao(ctx);
         }
+        mostrar_progresso_importacao(ctx);
+        t_espera = relogio_segundos();
     }
-    return f;
-}
 
-// Inicializa todas as 5 rvores B+
-void inicializar_arvores() {
-    char *nomes[] = {"cn", "ch", "lc", "mt", "red"};
+    for (int t = 0; t < qtd_threads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    free(threads);
+    leitor_paralelo_destruir(&lp);
+}
 
-    for (int i = 0; i < 5; i++) {
-        sprintf(arvores[i].nome, "nota_%s", nomes[i]);
+int importar_participantes_csv(char *nome_csv, const char *nome_bin, int em_segundo_plano) {
+    esperar_compactacoes_lsm();
+    ContextoImportacao ctx;
+    if (abrir_arquivos_importacao(&ctx, nome_bin) != 0) return 1;
+    ctx.em_segundo_plano = em_segundo_plano;
+    ctx.estat.inicio = ctx.estat.ultimo_progresso = relogio_segundos();
+
+    // Um READ interrompido s pode ser retomado com o mesmo CSV e com os ndices como ele os deixou
+    int retomando = ler_checkpoint_importacao(&ctx.checkpoint);
+    if (retomando && (strcmp(ctx.checkpoint.csv, nome_csv) != 0 || ctx.checkpoint.tamanho_csv != tamanho_arquivo(nome_csv))) {
+        printf("Ha um READ interrompido do arquivo '%s' (%d participantes ja gravados).\n",
+               ctx.checkpoint.csv, ctx.checkpoint.header.qtd_registros - ctx.checkpoint.registro_inicial);
+        printf("Use READ com esse mesmo arquivo para retoma-lo ou CLEAR para apagar a base.\n");
+        fechar_arquivos_importacao(&ctx);
+        return 1;
+    }
+    if (retomando) concluir_indices_checkpoint(&ctx);
+    if (retomando && !indices_consistentes_checkpoint(&ctx)) {
+        printf("ERRO: Os indices mudaram desde o READ interrompido de '%s'; use CLEAR e importe de novo.\n", ctx.checkpoint.csv);
+        fechar_arquivos_importacao(&ctx);
+        return 1;
+    }
 
-        char nome_meta[120], nome_idx[120], nome_dados[120];
-        sprintf(nome_meta, "%s_meta.dat", arvores[i].nome);
-        sprintf(nome_idx, "%s_indice.dat", arvores[i].nome);
-        sprintf(nome_dados, "%s_dados.dat", arvores[i].nome);
+    int qtd_threads = obter_qtd_threads_importacao();
+    int ler_csv = !retomando || !ctx.checkpoint.leitura_concluida;
+    EntradaCsv entrada;
+    if (ler_csv) {
+        if (abrir_entrada_csv(&entrada, nome_csv, qtd_threads, ctx.fp_extra ? &ctx.header_extra : NULL) != 0) {
+            fechar_arquivos_importacao(&ctx);
+            return 1;
+        }
+        // Comprimido, o tamanho s  conhecido no fim (o progresso mostra s os bytes lidos)
+        ctx.estat.bytes_total = entrada.tamanho;
+    }
 
-        arvores[i].f_metadados = abrir_arquivo_bmais(nome_meta, tamanho_metadados());
-        arvores[i].f_indice = abrir_arquivo_bmais(nome_idx, tamanho_no());
-        arvores[i].f_dados = abrir_arquivo_bmais(nome_dados, tamanho_no_dados());
+    if (retomando) {
+        restaurar_checkpoint_importacao(&ctx);
+        printf("Retomando o READ interrompido: %d participantes ja gravados, %.1f MB do CSV lidos.\n",
+               ctx.header.qtd_registros - ctx.checkpoint.registro_inicial, ctx.checkpoint.bytes_lidos / (1024.0 * 1024.0));
+        if (!ler_csv) {
+            printf("O CSV ja tinha sido lido por inteiro; faltam apenas os indices.\n");
+            ctx.estat.bytes_total = ctx.estat.bytes_lidos;
+        } else if (pular_entrada_csv(&entrada, ctx.checkpoint.bytes_lidos) != 0) {
+            printf("ERRO: O CSV termina antes do ponto do checkpoint.\n");
+            fechar_entrada_csv(&entrada);
+            fechar_arquivos_importacao(&ctx);
+            return 1;
+        }
+    }
 
-        if (!arvores[i].f_metadados || !arvores[i].f_indice || !arvores[i].f_dados) {
-            fprintf(stderr, "Erro ao inicializar as rvores B+.\n");
+    dicionario_carregar_localizacoes(&ctx.dic_loc, ctx.fp_loc, &ctx.header_loc);
+    dicionario_carregar_gabaritos(&ctx.dic_gab, ctx.fp_gab, &ctx.header_gab);
+    if (!ctx.checkpoint.indice_pronto[CONSTRUTOR_TRIE]) {
+        trie_memoria_carregar(&ctx.trie, ctx.fp_trie, &ctx.header_trie);
+    }
+    registros_estado_inicializar(&ctx.estados);
+    descartar_segmentos_parciais();
+    iniciar_transacao_importacao(&ctx);
+    if (!retomando) {
+        // O motor escolhido em CONFIG MOTOR vale para as rvores ainda vazias
+        for (int i = 0; i < 5; i++) {
+            if (indice_nota_vazio(&arvores[i])) aplicar_motor_indice_nota(&arvores[i], MOTOR_INDICE_NOTA[i]);
         }
+        descartar_temporarios_indices();
+        iniciar_checkpoint_importacao(&ctx, nome_csv);
     }
-}
 
-// Fecha todos os arquivos das rvores B+
-void fechar_arvores() {
+    // As rvores que j tinham dados antes do READ recebem as notas novas por intercalao
+    int qtd_mescladas = 0;
     for (int i = 0; i < 5; i++) {
-        if (arvores[i].f_metadados) fclose(arvores[i].f_metadados);
-        if (arvores[i].f_indice) fclose(arvores[i].f_indice);
-        if (arvores[i].f_dados) fclose(arvores[i].f_dados);
+        ctx.mesclar[i] = ctx.checkpoint.mesclar[i];
+        qtd_mescladas += ctx.mesclar[i];
     }
-}
+    iniciar_cargas_bmais(&ctx);
 
-int inserir_participante(FILE *fp_participantes, HeaderParticipantes *h, Participante *p) {
+    // Uma thread construtora por ndice, alimentadas pelo fluxo de tuplas
+    ConstrutoresIndices construtores;
+    iniciar_construtores_indices(&ctx, &construtores);
 
-    // 1. Inserir no arquivo de dados principal (participantes.bin)
-    int indice_registro = h->qtd_registros;
+    if (retomando) {
+        reindexar_participantes_confirmados(&ctx);
+    }
+    if (ler_csv) {
+        ler_lotes_csv(&ctx, &entrada, qtd_threads);
+        if (entrada.compressao != COMPRESSAO_NENHUMA) {
+            ctx.estat.bytes_total = ctx.estat.bytes_lidos;
+        }
+        if (fechar_entrada_csv(&entrada) != 0) {
+            // Os dados lidos podem parar no meio de uma linha: nada deste READ  confirmado
+            printf("ERRO: O descompressor terminou com erro; o CSV esta truncado ou corrompido (%zu bytes lidos).\n",
+                   entrada.descompressao.bytes_descomprimidos);
+            ctx.desfazer = 1;
+            finalizar_construtores_indices(&ctx, &construtores);
+            for (int i = 0; i < 5; i++) ordext_liberar(&ctx.cargas[i]);
+            dicionario_liberar(&ctx.dic_loc);
+            dicionario_liberar(&ctx.dic_gab);
+            desfazer_transacao_importacao(&ctx);
+            if (ctx.em_segundo_plano) publicar_versao_leitura(abrir_versao_leitura());
+            liberar_segmentos_parciais(&ctx);
+            fechar_arquivos_importacao(&ctx);
+            printf("READ desfeito; a base continua como estava antes dele.\n");
+            return 1;
+        }
+    }
+    confirmar_transacao_importacao(&ctx);
 
-    long offset = tamanho_header() + indice_registro * tamanho_participante();
-    fseek(fp_participantes, offset, SEEK_SET);
-    fwrite(p, tamanho_participante(), 1, fp_participantes);
+    if (qtd_mescladas > 0) {
+        printf("Intercalando as notas novas com as Arvores B+ existentes...\n");
+    } else {
+        printf("Construindo as 5 Arvores B+ em lote...\n");
+    }
+    finalizar_construtores_indices(&ctx, &construtores);
+    liberar_cargas_bmais(&ctx);
 
-    h->qtd_registros++;
-    fseek(fp_participantes, 0, SEEK_SET);
-    fwrite(h, tamanho_header(), 1, fp_participantes);
-    fflush(fp_participantes);
+    dicionario_liberar(&ctx.dic_loc);
+    dicionario_liberar(&ctx.dic_gab);
 
-    // 2. Inserir a entrada (Nota + ndice) nas 5 rvores B+
+    // Todos os ndices gravados: a importao no precisa mais ser retomada
+    remove(nome_checkpoint_importacao);
+    if (ctx.em_segundo_plano) publicar_versao_leitura(abrir_versao_leitura());
+    liberar_segmentos_parciais(&ctx);
 
-    // CN
-    inserir_bmais(p->nota_cn, indice_registro, arvores[0].f_metadados, arvores[0].f_indice, arvores[0].f_dados);
-    // CH
-    inserir_bmais(p->nota_ch, indice_registro, arvores[1].f_metadados, arvores[1].f_indice, arvores[1].f_dados);
-    // LC
-    inserir_bmais(p->nota_lc, indice_registro, arvores[2].f_metadados, arvores[2].f_indice, arvores[2].f_dados);
-    // MT
-    inserir_bmais(p->nota_mt, indice_registro, arvores[3].f_metadados, arvores[3].f_indice, arvores[3].f_dados);
-    // RED (Redao)
-    inserir_bmais(p->nota_red, indice_registro, arvores[4].f_metadados, arvores[4].f_indice, arvores[4].f_dados);
+    printf("Importacao concluida (%d thread(s) de leitura).\n", qtd_threads);
+    printf("Linhas validas inseridas (Participantes): %d\n", ctx.linhas_lidas);
+    printf("Linhas rejeitadas: %d\n", ctx.linhas_rejeitadas);
+    printf("Total de registros unicos de Localizacao: %d\n", ctx.header_loc.qtd_registros);
+    printf("Total de registros unicos de Gabarito de Provas: %d\n", ctx.header_gab.qtd_registros);
+    printf("Total de registros no indice invertido por Estado: %d\n", ctx.header_reg_est.qtd_nos);
+    printf("Total de nos na Arvore Trie: %d\n", ctx.header_trie.qtd_nos);
+    ctx.estat.seg_total = relogio_segundos() - ctx.estat.inicio;
+    gravar_resumo_importacao(&ctx, nome_csv, qtd_threads);
 
-    return indice_registro;
-}
+    fechar_arquivos_importacao(&ctx);
 
+    return 0;
+}
 
-int importar_participantes_csv(char *nome_csv, const char *nome_bin) {
-    HeaderParticipantes header;
-    FILE *fp_bin = abrir_arquivo_participantes(nome_bin, &header);
-    if (fp_bin == NULL) return 1;
+// READ em segundo plano (CONFIG SEGUNDOPLANO): a importao roda numa thread e a thread principal segue
+// atendendo SHOW, FIND, FILTER e LIST pela verso publicada. Os comandos que mudam a base esperam o fim.
+typedef struct {
+    pthread_t thread;
+    int ativa;     // S a thread principal altera: do incio at o READ ser recolhido
+    int concluida; // Marcada pela thread do READ (com mutex_versao_leitura)
+    char nome_csv[100];
+} ImportacaoSegundoPlano;
+
+ImportacaoSegundoPlano importacao_segundo_plano;
+int READ_EM_SEGUNDO_PLANO = 0; // CONFIG SEGUNDOPLANO
+
+void *thread_importacao_segundo_plano(void *arg) {
+    ImportacaoSegundoPlano *imp = (ImportacaoSegundoPlano *)arg;
+    importar_participantes_csv(imp->nome_csv, nome_participantes_bin, 1);
+    pthread_mutex_lock(&mutex_versao_leitura);
+    imp->concluida = 1;
+    pthread_mutex_unlock(&mutex_versao_leitura);
+    return NULL;
+}
 
-    HeaderLocalizacao header_loc;
-    FILE *fp_loc = abrir_arquivo_localizacao(nome_localizacao_bin, &header_loc);
-    if (fp_loc == NULL) {
-        fclose(fp_bin);
+// Retorna 0 se o READ foi iniciado em segundo plano; seno ele deve rodar em primeiro plano
+int iniciar_importacao_segundo_plano(const char *nome_csv) {
+    ImportacaoSegundoPlano *imp = &importacao_segundo_plano;
+    // A retomada regrava cabealhos e corta os arquivos antes do primeiro checkpoint
+    CheckpointImportacao ck;
+    if (ler_checkpoint_importacao(&ck)) {
+        printf("Ha um READ interrompido; ele roda em primeiro plano.\n");
         return 1;
     }
-
-    HeaderProva header_gab; // Cabealho do Gabarito
-    FILE *fp_gab = abrir_arquivo_gabarito(nome_gabarito_bin, &header_gab); // Arquivo de Gabarito
-    if (fp_gab == NULL) {
-        fclose(fp_loc);
-        fclose(fp_bin);
+    esperar_compactacoes_lsm();
+
+    snprintf(imp->nome_csv, sizeof(imp->nome_csv), "%s", nome_csv);
+    imp->concluida = 0;
+    // At o primeiro checkpoint com participantes novos os comandos veem a base como estava antes do READ
+    publicar_versao_leitura(abrir_versao_leitura());
+    if (pthread_create(&imp->thread, NULL, thread_importacao_segundo_plano, imp) != 0) {
+        publicar_versao_leitura(NULL);
         return 1;
     }
-    //Registro por Estado (Invertido)
-    HeaderRegistroEstado header_reg_est;
-    FILE *fp_reg_est = abrir_arquivo_registro_estado(nome_registro_estado_bin, &header_reg_est);
-    if (fp_reg_est == NULL) {
-        fclose(fp_gab);
-        fclose(fp_loc);
-        fclose(fp_bin);
-        return 1;
+    imp->ativa = 1;
+    printf("READ de '%s' iniciado em segundo plano; ate ele terminar, os comandos de consulta veem os participantes confirmados no ultimo checkpoint.\n", nome_csv);
+    return 0;
+}
+
+// Recolhe o READ em segundo plano se ele j terminou (com `esperar`, aguarda o fim).
+// Retorna 1 se ainda h um READ em andamento.
+int recolher_importacao_segundo_plano(int esperar) {
+    ImportacaoSegundoPlano *imp = &importacao_segundo_plano;
+    if (!imp->ativa) return 0;
+    pthread_mutex_lock(&mutex_versao_leitura);
+    int concluida = imp->concluida;
+    pthread_mutex_unlock(&mutex_versao_leitura);
+    if (!concluida && !esperar) return 1;
+
+    if (!concluida) printf("Aguardando o READ em segundo plano de '%s' terminar...\n", imp->nome_csv);
+    pthread_join(imp->thread, NULL);
+    imp->ativa = 0;
+    // Sem verso publicada os comandos voltam a abrir a base na hora
+    publicar_versao_leitura(NULL);
+    // Compactaes LSM adiadas durante o READ
+    for (int i = 0; i < 5; i++) {
+        lsm_iniciar_compactacao(&arvores[i].lsm);
     }
+    printf("READ em segundo plano de '%s' concluido.\n", imp->nome_csv);
+    return 0;
+}
 
-    //Trie para nu_seq
-    HeaderTrie header_trie;
-    FILE *fp_trie = abrir_arquivo_trie(nome_trie_bin, &header_trie);
-    if (fp_trie == NULL) {
-        fclose(fp_reg_est);
-        fclose(fp_gab);
-        fclose(fp_loc);
-        fclose(fp_bin);
+// Comandos que mudam a base no rodam junto com o READ em segundo plano. Retorna 1 se `comando` foi recusado.
+int recusar_durante_importacao(const char *comando) {
+    if (!recolher_importacao_segundo_plano(0)) return 0;
+    printf("ERRO: Ha um READ em segundo plano de '%s' em andamento; %s so pode ser usado depois dele.\n",
+           importacao_segundo_plano.nome_csv, comando);
+    return 1;
+}
+
+// REINDEX: remonta as 5 rvores B+, a Trie e o ndice por Estado s a partir de participantes.bin
+// (e das localizaes, para o Estado), sem o CSV. O arquivo  lido uma vez, em sequncia, e as tuplas
+// vo pelo mesmo fluxo do READ s threads construtoras. Cada ndice novo substitui o antigo por rename,
+// ento um REINDEX interrompido deixa os ndices antigos (ou j os novos) e basta repeti-lo.
+int reindexar_base(const char *nome_bin) {
+    esperar_compactacoes_lsm();
+    CheckpointImportacao ck;
+    if (ler_checkpoint_importacao(&ck)) {
+        printf("Ha um READ interrompido do arquivo '%s'; conclua-o com READ ou use CLEAR antes do REINDEX.\n", ck.csv);
         return 1;
     }
 
-    FILE *fp_csv = fopen(nome_csv, "r");
-    if (fp_csv == NULL) {
-        perror("Erro ao abrir CSV de participantes");
-        fclose(fp_gab);
-        fclose(fp_loc);
-        fclose(fp_bin);
+    ContextoImportacao ctx;
+    memset(&ctx, 0, sizeof(ContextoImportacao));
+    pthread_mutex_init(&ctx.mutex_checkpoint, NULL);
+    ctx.reconstruir = 1;
+    ctx.fp_bin = fopen(nome_bin, "rb");
+    if (!ctx.fp_bin || fread(&ctx.header, tamanho_header(), 1, ctx.fp_bin) != 1) {
+        printf("Nenhum participante gravado em '%s'; use READ primeiro.\n", nome_bin);
+        fechar_arquivos_importacao(&ctx);
         return 1;
     }
-
-    char linha[4096];
-
-    // Ignora o cabealho
-    if (fgets(linha, sizeof(linha), fp_csv) == NULL) {
-        printf("CSV vazio.\n");
-        fclose(fp_csv);
-        fclose(fp_gab);
-        fclose(fp_loc);
-        fclose(fp_bin);
+    setvbuf(ctx.fp_bin, NULL, _IOFBF, TAM_BUFFER_TRANSACAO);
+    ctx.fp_loc = abrir_arquivo_localizacao(nome_localizacao_bin, &ctx.header_loc);
+    ctx.fp_reg_est = abrir_arquivo_registro_estado(nome_registro_estado_bin, &ctx.header_reg_est);
+    ctx.fp_trie = abrir_arquivo_trie(nome_trie_bin, &ctx.header_trie);
+    if (!ctx.fp_loc || !ctx.fp_reg_est || !ctx.fp_trie) {
+        fechar_arquivos_importacao(&ctx);
         return 1;
     }
+    ctx.estat.inicio = relogio_segundos();
 
-    int linhas_lidas = 0;
-
-    // Variveis temporrias lidas do CSV
-    char temp_cod_esc[15];
-    char temp_cidade[40];
-    char temp_estado[20];
-
-    // VARIVEIS TEMPORRIAS PARA OS 4 CDIGOS E OS 4 GABARITOS
-    float temp_cod_prova_f[4];
-    char temp_gab_str[4][60];
-
-    const char *csv_format_final =
-
-        "%14[^;];%d;"               // NU_SEQ, ANO
-        "%14[^;];"                  // COD_ESC (temp)
-        "%*[^;];"                   // Skip
-        "%39[^;];"                  // CIDADE (temp)
-        "%*[^;];"                   // Skip
-        "%19[^;];"                  // ESTADO (temp)
-        "%*[^;];%*[^;];%*[^;];%*[^;];%*[^;];%*[^;];%*[^;];%*[^;];%*[^;];%*[^;];%*[^;];" // Skips
-        "%f;%f;%f;%f;"              // COD_PROVA CN, CH, LC, MT (temp_cod_prova_f[0]...)
-        "%f;%f;%f;%f;"              // NOTAS CN, CH, LC, MT (p.nota_cn, ...)
-        "%49[^;];%49[^;];%49[^;];%49[^;];" // RESPOSTAS CN, CH, LC, MT (p.resp_cn, ...)
-        "%d;"                       // LING_EST (p.ling_est)
-        "%59[^;];%59[^;];%59[^;];%59[^;];" // GABARITOS CN, CH, LC, MT (temp_gab_str[0]...)
-        "%*[^;];%*[^;];%*[^;];%*[^;];%*[^;];%*[^;];" // Skips
-        "%f";                       // NOTA_RED (p.nota_red)
-
-    while (fgets(linha, sizeof(linha), fp_csv) != NULL) {
-        Participante p;
-        memset(&p, 0, tamanho_participante());
-        memset(temp_cod_esc, 0, sizeof(temp_cod_esc));
-        memset(temp_cidade, 0, sizeof(temp_cidade));
-        memset(temp_estado, 0, sizeof(temp_estado));
-
-        // 23 argumentos a serem lidos
-        int ok = sscanf(
-            linha,
-            csv_format_final,
-            p.nu_seq,
-            &p.ano,
-            temp_cod_esc, // COD_ESC
-            temp_cidade,  // CIDADE
-            temp_estado,  // ESTADO
-            &temp_cod_prova_f[0], // COD_PROVA CN (temp)
-            &temp_cod_prova_f[1], // COD_PROVA CH (temp)
-            &temp_cod_prova_f[2], // COD_PROVA LC (temp)
-            &temp_cod_prova_f[3], // COD_PROVA MT (temp)
-            &p.nota_cn, // NOTA CN
-            &p.nota_ch, // NOTA CH
-            &p.nota_lc, // NOTA LC
-            &p.nota_mt, // NOTA MT
-            p.resp_cn, // RESPOSTA CN
-            p.resp_ch, // RESPOSTA CH
-            p.resp_lc, // RESPOSTA LC
-            p.resp_mt, // RESPOSTA MT
-            &p.ling_est, // LING_EST
-            temp_gab_str[0], // GABARITO CN (temp)
-            temp_gab_str[1], // GABARITO CH (temp)
-            temp_gab_str[2], // GABARITO LC (temp)
-            temp_gab_str[3], // GABARITO MT (temp)
-            &p.nota_red // NOTA_RED
-        );
-
-        // O nmero esperado de argumentos lidos  23
-        if (ok != 23) {
-             //printf("Linha ignorada (formato inesperado). Lidos = %d. Esperado = 23\n", ok);
-             continue;
-        }
-
-        // --- 1. PROCESSAMENTO DE LOCALIZAO ---
-
-        int indice_loc = buscar_indice_localizacao_por_cod_esc(fp_loc, &header_loc, temp_cod_esc);
-
-        if (indice_loc == -1) {
-            Localizacao nova_loc;
-            strcpy(nova_loc.cod_esc, temp_cod_esc);
-            strcpy(nova_loc.cidade, temp_cidade);
-            strcpy(nova_loc.estado, temp_estado);
-            indice_loc = salvar_localizacao(fp_loc, &header_loc, &nova_loc);
-        }
-
-        p.indice_localizacao = indice_loc;
-
-        // --- 2. PROCESSAMENTO DE GABARITO ---
-
-        // Ponteiros para os campos de ndice na struct Participante
-        int *indices_gab_ptr[] = {
-            &p.indice_gabarito_cn,
-            &p.indice_gabarito_ch,
-            &p.indice_gabarito_lc,
-            &p.indice_gabarito_mt
-        };
-
-        for (int i = 0; i < 4; i++) {
-            char cod_prova_str[15];
-            sprintf(cod_prova_str, "%.0f", temp_cod_prova_f[i]);
-
-            // Busca o ndice do gabarito para este cdigo de prova
-            int indice_gab = buscar_indice_gabarito_por_cod_prova(fp_gab, &header_gab, cod_prova_str);
-
-            if (indice_gab == -1) {
-                // Salva o novo registro (cdigo de prova individual + gabarito)
-                Prova nova_gab;
-                strcpy(nova_gab.cod_prova, cod_prova_str);
-                strcpy(nova_gab.gabarito, temp_gab_str[i]);
-                indice_gab = salvar_gabarito(fp_gab, &header_gab, &nova_gab);
-            }
+    // Nada dos ndices antigos  aproveitado: Trie vazia e nenhum vetor de Estado a copiar
+    ctx.trie.raiz = -1;
+    iniciar_header_registro_estado(&ctx.header_reg_est);
+    registros_estado_inicializar(&ctx.estados);
+    iniciar_cargas_bmais(&ctx);
 
-            // Armazena o ndice no campo especfico do Participante
-            *indices_gab_ptr[i] = indice_gab;
+    printf("Reindexando %d participantes de '%s'...\n", ctx.header.qtd_registros, nome_bin);
+    // Cada rvore  reconstruda no motor de CONFIG MOTOR; os arquivos do outro motor so apagados no fim
+    for (int i = 0; i < 5; i++) {
+        if (arvores[i].motor != MOTOR_INDICE_NOTA[i]) {
+            printf("%s: convertendo de %s para %s.\n", arvores[i].nome, nome_motor_indice(arvores[i].motor), nome_motor_indice(MOTOR_INDICE_NOTA[i]));
+            arvores[i].motor = MOTOR_INDICE_NOTA[i];
         }
-
-        // --- 3. INSERIR PARTICIPANTE E NDICES B+ ---
-        //inserir_participante(fp_bin, &header, &p);
-        int indice_registro = inserir_participante(fp_bin, &header, &p);
-
-        // --- 4. INSERIR NO ARQUIVO INVERTIDO DE ESTADO
-        // Nota: O `temp_estado`  a sigla lida do CSV (Ex: "RS")
-        inserir_indice_no_registro_estado(fp_reg_est, &header_reg_est, temp_estado, indice_registro);
-
-        // --- 5. INSERIR NA RVORE TRIE
-        inserir_trie(fp_trie, &header_trie, p.nu_seq, indice_registro);
-
-        linhas_lidas++;
     }
+    SiglaEstado *estados = carregar_estados_localizacoes(&ctx);
+    ConstrutoresIndices construtores;
+    iniciar_construtores_indices(&ctx, &construtores);
+    double t_leitura = relogio_segundos();
+    int lidos = entregar_participantes_indices(&ctx, estados, 0, ctx.header.qtd_registros);
+    t_leitura = relogio_segundos() - t_leitura;
+    free(estados);
+    finalizar_construtores_indices(&ctx, &construtores);
+    liberar_cargas_bmais(&ctx);
+    ctx.estat.seg_total = relogio_segundos() - ctx.estat.inicio;
+
+    if (lidos < ctx.header.qtd_registros) {
+        printf("Aviso: '%s' tem so %d dos %d participantes do cabecalho; os indices cobrem os lidos.\n",
+               nome_bin, lidos, ctx.header.qtd_registros);
+    }
+    double mb_lidos = (double)lidos * tamanho_participante() / (1024.0 * 1024.0);
+    printf("Reindexacao concluida: %d participantes em %.2f s (leitura de %.1f MB em %.2f s, %.1f MB/s).\n",
+           lidos, ctx.estat.seg_total, mb_lidos, t_leitura, t_leitura > 0 ? mb_lidos / t_leitura : 0);
+    for (int c = 0; c < QTD_CONSTRUTORES; c++) {
+        printf("  %s: %.2f durante a leitura + %.2f na construcao\n",
+               nome_construtor_indice(c), ctx.estat.seg_indice[c], ctx.estat.seg_construcao[c]);
+    }
+    printf("Total de registros no indice invertido por Estado: %d\n", ctx.header_reg_est.qtd_nos);
+    printf("Total de nos na Arvore Trie: %d\n", ctx.header_trie.qtd_nos);
 
-    printf("Importacao concluida.\n");
-    printf("Linhas validas inseridas (Participantes): %d\n", linhas_lidas);
-    printf("Total de registros unicos de Localizacao: %d\n", header_loc.qtd_registros);
-    printf("Total de registros unicos de Gabarito de Provas: %d\n", header_gab.qtd_registros);
-    printf("Total de nos do indice invertido por Estado: %d\n", header_reg_est.qtd_nos);
-    printf("Total de nos na Arvore Trie: %d\n", header_trie.qtd_nos);
-
-    fclose(fp_csv);
-    fclose(fp_gab);
-    fclose(fp_loc);
-    fclose(fp_reg_est);
-    fclose(fp_trie);
-    fclose(fp_bin);
-
+    fechar_arquivos_importacao(&ctx);
     return 0;
 }
 
-void ler_todos_participantes(const char *nome) {
-    FILE *fp = fopen(nome, "rb");
+void ler_todos_participantes() {
+    VersaoLeitura *v = adquirir_versao_leitura();
+    FILE *fp = v->fp_participantes;
     if (!fp) {
         perror("Erro ao abrir arquivo de participantes");
+        liberar_versao_leitura(v);
         return;
     }
 
-    HeaderParticipantes h;
-    fread(&h, tamanho_header(), 1, fp);
-
-    // Abertura dos arquivos de metadados
-    HeaderLocalizacao header_loc;
-    FILE *fp_loc = abrir_arquivo_localizacao(nome_localizacao_bin, &header_loc);
-
-    HeaderProva header_gab;
-    FILE *fp_gab = abrir_arquivo_gabarito(nome_gabarito_bin, &header_gab);
+    // Arquivos de metadados da mesma verso
+    FILE *fp_loc = v->fp_loc;
+    FILE *fp_gab = v->fp_gab;
+    FILE *fp_extra = v->fp_extra;
+    HeaderExtras header_extra = v->header_extra;
 
     if (fp_loc == NULL || fp_gab == NULL) {
-        fclose(fp);
-        if (fp_loc) fclose(fp_loc);
-        if (fp_gab) fclose(fp_gab);
+        liberar_versao_leitura(v);
         return;
     }
 
-    int total_registros = h.qtd_registros;
+    // SHOW percorre participantes.bin e participantes_respostas.bin em ordem
+    aconselhar_acesso_mapeado(&v->mapa_participantes, 1);
+    aconselhar_acesso_mapeado(&v->mapa_respostas, 1);
+    FILE *fp_respostas = v->fp_respostas;
+
+    int total_registros = total_registros_versao(v);
     if (total_registros == 0) {
         printf("Nenhum registro encontrado.\n");
-        fclose(fp_gab);
-        fclose(fp_loc);
-        fclose(fp);
+        liberar_versao_leitura(v);
         return;
     }
 
@@ -1476,10 +6179,11 @@ void ler_todos_participantes(const char *nome) {
             indice_final = total_registros; // Limita ao total de registros
         }
 
-        // --- POSICIONA O ARQUIVO NO INCIO DA PGINA ---
+        // --- POSICIONA O ARQUIVO NO INCIO DA PGINA (leitura sem mapeamento) ---
         // Pula o Header + os registros das pginas anteriores
         long offset = tamanho_header() + indice_inicial * tamanho_participante();
         fseek(fp, offset, SEEK_SET);
+        if (fp_respostas) fseek(fp_respostas, tamanho_header() + indice_inicial * tamanho_respostas(), SEEK_SET);
 
         // --- PREPARAO DA EXIBIO ---
         printf("------------------------------------------------------------------------\n");
@@ -1493,12 +6197,30 @@ void ler_todos_participantes(const char *nome) {
         // LEITURA SEQUENCIAL E IMPRESSO
         // Itera apenas sobre os registros da pgina atual (i = ndice absoluto)
         for (long i = indice_inicial; i < indice_final; i++) {
-            Participante p;
-
-            // Leitura sequencial do arquivo
-            if (fread(&p, tamanho_participante(), 1, fp) != 1) {
-                perror("Erro de leitura");
-                break;
+            RegistroParticipante lido;
+            RespostasParticipante resp_lida;
+            RegistroCompacto registro_lido;
+            RespostasCompactas respostas_lidas;
+            const RegistroCompacto *c = registro_mapeado(&v->mapa_participantes, tamanho_header(), tamanho_participante(), (int)i);
+            const RespostasCompactas *c_resp = registro_mapeado(&v->mapa_respostas, tamanho_header(), tamanho_respostas(), (int)i);
+
+            // Sem mapeamento, leitura sequencial dos arquivos
+            if (!c) {
+                if (fread(&registro_lido, tamanho_participante(), 1, fp) != 1) {
+                    perror("Erro de leitura");
+                    break;
+                }
+                c = &registro_lido;
+            }
+            if (!c_resp && fp_respostas && fread(&respostas_lidas, tamanho_respostas(), 1, fp_respostas) == 1) {
+                c_resp = &respostas_lidas;
+            }
+            descompactar_registro(c, &lido);
+            const RegistroParticipante *p = &lido;
+            const RespostasParticipante *resp = &RESPOSTAS_AUSENTES;
+            if (c_resp) {
+                descompactar_respostas(c_resp, &resp_lida);
+                resp = &resp_lida;
             }
 
              // Busca O(1) e exibe os Gabaritos
@@ -1507,32 +6229,30 @@ void ler_todos_participantes(const char *nome) {
                 char gab_lc[55] = "N/A", gab_mt[55] = "N/A";
                 char cod_lc[15] = "N/A", cod_mt[15] = "N/A";
 
-                Prova *p_cn = buscar_gabarito_por_indice(fp_gab, p.indice_gabarito_cn);
+                Prova prova; // Cada gabarito lido  copiado logo em seguida
+                const Prova *p_cn = buscar_gabarito_versao(v, p->indice_gabarito_cn, &prova);
                 if (p_cn) {
                     strcpy(gab_cn, p_cn->gabarito);
                     strcpy(cod_cn, p_cn->cod_prova);
-                    free(p_cn);
                 }
-                Prova *p_ch = buscar_gabarito_por_indice(fp_gab, p.indice_gabarito_ch);
+                const Prova *p_ch = buscar_gabarito_versao(v, p->indice_gabarito_ch, &prova);
                 if (p_ch) {
                     strcpy(gab_ch, p_ch->gabarito);
                     strcpy(cod_ch, p_ch->cod_prova);
-                    free(p_ch);
                 }
-                Prova *p_lc = buscar_gabarito_por_indice(fp_gab, p.indice_gabarito_lc);
+                const Prova *p_lc = buscar_gabarito_versao(v, p->indice_gabarito_lc, &prova);
                 if (p_lc) {
                     strcpy(gab_lc, p_lc->gabarito);
                     strcpy(cod_lc, p_lc->cod_prova);
-                    free(p_lc);
                 }
-                Prova *p_mt = buscar_gabarito_por_indice(fp_gab, p.indice_gabarito_mt);
+                const Prova *p_mt = buscar_gabarito_versao(v, p->indice_gabarito_mt, &prova);
                 if (p_mt) {
                     strcpy(gab_mt, p_mt->gabarito);
                     strcpy(cod_mt, p_mt->cod_prova);
-                    free(p_mt);
                 }
                         // Busca O(1) e exibe a Localizao
-                        Localizacao *loc = buscar_localizacao_por_indice(fp_loc, p.indice_localizacao);
+                        Localizacao loc_lida;
+                        const Localizacao *loc = buscar_localizacao_versao(v, p->indice_localizacao, &loc_lida);
                         char cidade_temp[60] = "Nao Encontrada";
                         char estado_temp[20] = "Nao Encontrado";
                         char cod_esc_temp[15] = "N/A";
@@ -1541,13 +6261,12 @@ void ler_todos_participantes(const char *nome) {
                             strcpy(cidade_temp, loc->cidade);
                             strcpy(estado_temp, loc->estado);
                             strcpy(cod_esc_temp, loc->cod_esc);
-                            free(loc);
                         }
 
                         char lingua[15];
                         char red_gab_lc[55]; // so mostra as questoes da lingua estrangeira selecionada
 
-                        if(!p.ling_est)
+                        if(!p->ling_est)
                         {
                             char parte1[6];
                             char parte2[41];
@@ -1563,16 +6282,29 @@ void ler_todos_participantes(const char *nome) {
                         {
                             strncpy(red_gab_lc, gab_lc + 5, 45);
                             red_gab_lc[45] = '\0';
-                            strcpy(lingua, "Espanhol");
+                            strcpy(lingua, p->ling_est == 1 ? "Espanhol" : "N/A");
                         }
 
-                        printf("%s | %d | %s | %s | %s | %.2f | %.2f | %.2f | %.2f | %.2f | %.2f | %s\n%s | %s | %s \n%s | %s | %s\n%s | %s | %s \n%s | %s | %s\n\n",
-                               p.nu_seq, p.ano, cod_esc_temp, cidade_temp, estado_temp,
-                               p.nota_cn, p.nota_ch, p.nota_lc, p.nota_mt, p.nota_red, (p.nota_cn+p.nota_ch+p.nota_lc+p.nota_mt+p.nota_red)/5, lingua,
-                               cod_cn, gab_cn, p.resp_cn,
-                               cod_ch, gab_ch, p.resp_ch,
-                               cod_lc, red_gab_lc, p.resp_lc,
-                               cod_mt, gab_mt, p.resp_mt);
+                        printf("%s | %d | %s | %s | %s | %.2f | %.2f | %.2f | %.2f | %.2f | %.2f | %s\n%s | %s | %s \n%s | %s | %s\n%s | %s | %s \n%s | %s | %s\n",
+                               p->nu_seq, p->ano, cod_esc_temp, cidade_temp, estado_temp,
+                               NOTA_PARA_FLOAT(p->nota_cn), NOTA_PARA_FLOAT(p->nota_ch), NOTA_PARA_FLOAT(p->nota_lc), NOTA_PARA_FLOAT(p->nota_mt),
+                               NOTA_PARA_FLOAT(p->nota_red), media_participante(p), lingua,
+                               cod_cn, gab_cn, resp->resp_cn,
+                               cod_ch, gab_ch, resp->resp_ch,
+                               cod_lc, red_gab_lc, resp->resp_lc,
+                               cod_mt, gab_mt, resp->resp_mt);
+
+                        // Colunas extras projetadas no READ (se o participante as tem)
+                        char extra[TAM_MAX_REGISTRO_EXTRA];
+                        if (fp_extra && ler_registro_extra(fp_extra, &header_extra, (int)i, extra)) {
+                            for (int c = 0; c < header_extra.qtd_colunas; c++) {
+                                char valor[64];
+                                formatar_coluna_extra(&header_extra.colunas[c], extra, valor, sizeof(valor));
+                                printf("%s%s: %s", c ? " | " : "", header_extra.colunas[c].nome, valor);
+                            }
+                            printf("\n");
+                        }
+                        printf("\n");
         } // Fim do loop de leitura da pgina
 
         // INTERAO COM O USURIO E VALIDAO
@@ -1609,77 +6341,51 @@ void ler_todos_participantes(const char *nome) {
             } else if (nova_pagina_input > max_paginas) {
                 printf("ERRO: A pagina %ld nao existe. A pagina maxima e %d.\n", nova_pagina_input, max_paginas);
             } else {
-                // Entrada vlida! Atualiza a pgina atual e o loop continua.
-                pagina_atual = (int)nova_pagina_input;
-            }
-        }
-
-    } while (!sair);
-
-    fclose(fp_gab);
-    fclose(fp_loc);
-    fclose(fp);
-}
-
-// Busca e l um participante por ndice
-Participante *ler_participante_por_indice(FILE *fp_participantes, int indice) {
-    Participante *p = (Participante *)malloc(tamanho_participante());
-    if (!p) { perror("Erro de alocacao"); return NULL; }
-
-    long offset = tamanho_header() + indice * tamanho_participante();
-    if (fseek(fp_participantes, offset, SEEK_SET) != 0) {
-        free(p);
-        return NULL;
-    }
+                // Entrada vlida! Atualiza a pgina atual e o loop continua.
+                pagina_atual = (int)nova_pagina_input;
+            }
+        }
 
-    if (fread(p, tamanho_participante(), 1, fp_participantes) != 1) {
-        free(p);
-        return NULL;
-    }
+    } while (!sair);
 
-    return p;
+    liberar_versao_leitura(v);
 }
 
-void buscar_participante_por_nuseq(const char *nu_seq) {
-    // 1. Abertura dos arquivos
-    HeaderTrie h_trie;
-    FILE *fp_trie = abrir_arquivo_trie(nome_trie_bin, &h_trie);
-    if (!fp_trie) {
-        perror("Erro ao abrir arquivo da Trie");
-        return;
-    }
-
-    // Abertura dos arquivos de metadados
-    HeaderLocalizacao header_loc;
-    FILE *fp_loc = abrir_arquivo_localizacao(nome_localizacao_bin, &header_loc);
-
-    HeaderProva header_gab;
-    FILE *fp_gab = abrir_arquivo_gabarito(nome_gabarito_bin, &header_gab);
 
-    if (fp_loc == NULL || fp_gab == NULL) {
-        if (fp_loc) fclose(fp_loc);
-        if (fp_gab) fclose(fp_gab);
-        return;
-    }
+void buscar_participante_por_nuseq(const char *nu_seq) {
+    // 1. Arquivos da verso de leitura atual
+    VersaoLeitura *v = adquirir_versao_leitura();
+    FILE *fp_trie = v->fp_trie;
+    FILE *fp_loc = v->fp_loc;
+    FILE *fp_gab = v->fp_gab;
 
-    // 2. Busca na Trie (O(L))
-    int indice_registro = buscar_trie(fp_trie, &h_trie, nu_seq);
+    // 2. Busca nos segmentos parciais de um READ em segundo plano, mais novos que a Trie, e depois na Trie
+    // (O(L)). Sem Trie (o primeiro READ ainda no publicou os ndices) s os segmentos so consultados
+    int indice_registro = buscar_nuseq_parciais(v, nu_seq);
+    if (indice_registro == -1 && fp_trie) indice_registro = buscar_trie(fp_trie, &v->header_trie, nu_seq);
 
     if (indice_registro == -1) {
         printf("Participante com NU_SEQ '%s' nao encontrado.\n", nu_seq);
-        fclose(fp_trie);
+        liberar_versao_leitura(v);
+        return;
+    }
+    if (fp_loc == NULL || fp_gab == NULL) {
+        liberar_versao_leitura(v);
         return;
     }
 
     // 3. Recuperao do Registro Principal
-    FILE *fp_participantes = fopen(nome_participantes_bin, "rb");
+    FILE *fp_participantes = v->fp_participantes;
     if (!fp_participantes) {
         perror("Erro ao abrir arquivo de participantes");
-        fclose(fp_trie);
+        liberar_versao_leitura(v);
         return;
     }
 
-    Participante *p = ler_participante_por_indice(fp_participantes, indice_registro);
+    RegistroParticipante participante;
+    const RegistroParticipante *p = ler_participante_versao(v, indice_registro, &participante);
+    RespostasParticipante resp_lida;
+    const RespostasParticipante *resp = ler_respostas_versao(v, indice_registro, &resp_lida);
 
     if (p) {
             printf("------------------------------------------------------------------------\n");
@@ -1691,32 +6397,30 @@ void buscar_participante_por_nuseq(const char *nu_seq) {
                 char gab_lc[55] = "N/A", gab_mt[55] = "N/A";
                 char cod_lc[15] = "N/A", cod_mt[15] = "N/A";
 
-                Prova *p_cn = buscar_gabarito_por_indice(fp_gab, p->indice_gabarito_cn);
+                Prova prova; // Cada gabarito lido  copiado logo em seguida
+                const Prova *p_cn = buscar_gabarito_versao(v, p->indice_gabarito_cn, &prova);
                 if (p_cn) {
                     strcpy(gab_cn, p_cn->gabarito);
                     strcpy(cod_cn, p_cn->cod_prova);
-                    free(p_cn);
                 }
-                Prova *p_ch = buscar_gabarito_por_indice(fp_gab, p->indice_gabarito_ch);
+                const Prova *p_ch = buscar_gabarito_versao(v, p->indice_gabarito_ch, &prova);
                 if (p_ch) {
                     strcpy(gab_ch, p_ch->gabarito);
                     strcpy(cod_ch, p_ch->cod_prova);
-                    free(p_ch);
                 }
-                Prova *p_lc = buscar_gabarito_por_indice(fp_gab, p->indice_gabarito_lc);
+                const Prova *p_lc = buscar_gabarito_versao(v, p->indice_gabarito_lc, &prova);
                 if (p_lc) {
                     strcpy(gab_lc, p_lc->gabarito);
                     strcpy(cod_lc, p_lc->cod_prova);
-                    free(p_lc);
                 }
-                Prova *p_mt = buscar_gabarito_por_indice(fp_gab, p->indice_gabarito_mt);
+                const Prova *p_mt = buscar_gabarito_versao(v, p->indice_gabarito_mt, &prova);
                 if (p_mt) {
                     strcpy(gab_mt, p_mt->gabarito);
                     strcpy(cod_mt, p_mt->cod_prova);
-                    free(p_mt);
                 }
                         // Busca O(1) e exibe a Localizao
-                        Localizacao *loc = buscar_localizacao_por_indice(fp_loc, p->indice_localizacao);
+                        Localizacao loc_lida;
+                        const Localizacao *loc = buscar_localizacao_versao(v, p->indice_localizacao, &loc_lida);
                         char cidade_temp[60] = "Nao Encontrada";
                         char estado_temp[20] = "Nao Encontrado";
                         char cod_esc_temp[15] = "N/A";
@@ -1725,7 +6429,6 @@ void buscar_participante_por_nuseq(const char *nu_seq) {
                             strcpy(cidade_temp, loc->cidade);
                             strcpy(estado_temp, loc->estado);
                             strcpy(cod_esc_temp, loc->cod_esc);
-                            free(loc);
                         }
 
                         char lingua[15];
@@ -1747,17 +6450,17 @@ void buscar_participante_por_nuseq(const char *nu_seq) {
                         {
                             strncpy(red_gab_lc, gab_lc + 5, 45);
                             red_gab_lc[45] = '\0';
-                            strcpy(lingua, "Espanhol");
+                            strcpy(lingua, p->ling_est == 1 ? "Espanhol" : "N/A");
                         }
 
                         printf("%s | %d | %s | %s | %s | %.2f | %.2f | %.2f | %.2f | %.2f | %.2f | %s\n%s | %s | %s \n%s | %s | %s\n%s | %s | %s \n%s | %s | %s\n",
                                p->nu_seq, p->ano, cod_esc_temp, cidade_temp, estado_temp,
-                               p->nota_cn, p->nota_ch, p->nota_lc, p->nota_mt, p->nota_red, (p->nota_cn+p->nota_ch+p->nota_lc+p->nota_mt+p->nota_red)/5, lingua,
-                               cod_cn, gab_cn, p->resp_cn,
-                               cod_ch, gab_ch, p->resp_ch,
-                               cod_lc, red_gab_lc, p->resp_lc,
-                               cod_mt, gab_mt, p->resp_mt);
-                               free(p);
+                               NOTA_PARA_FLOAT(p->nota_cn), NOTA_PARA_FLOAT(p->nota_ch), NOTA_PARA_FLOAT(p->nota_lc), NOTA_PARA_FLOAT(p->nota_mt),
+                               NOTA_PARA_FLOAT(p->nota_red), media_participante(p), lingua,
+                               cod_cn, gab_cn, resp->resp_cn,
+                               cod_ch, gab_ch, resp->resp_ch,
+                               cod_lc, red_gab_lc, resp->resp_lc,
+                               cod_mt, gab_mt, resp->resp_mt);
 
 
 
@@ -1767,91 +6470,60 @@ void buscar_participante_por_nuseq(const char *nu_seq) {
         printf("Erro ao ler o registro do participante no indice %d.\n", indice_registro);
     }
 
-    fclose(fp_participantes);
-    fclose(fp_trie);
+    liberar_versao_leitura(v);
 }
 
 
-int obter_total_registros_participantes(const char *nome) {
-    FILE *fp = fopen(nome, "rb");
-    if (!fp) return 0;
-    HeaderParticipantes h;
-    if (fread(&h, sizeof(HeaderParticipantes), 1, fp) != 1) {
-        fclose(fp);
-        return 0;
-    }
-    fclose(fp);
-    return h.qtd_registros;
-}
-
 void listar_por_estado(const char* estado_sigla) {
 
-    // 1. Abertura dos arquivos
-    FILE *fp_reg_est = fopen(nome_registro_estado_bin, "rb");
-    if (!fp_reg_est) {
+    // 1. Arquivos da verso de leitura atual
+    VersaoLeitura *v = adquirir_versao_leitura();
+    // Os participantes vm na ordem do ndice, fora da ordem do arquivo
+    aconselhar_acesso_mapeado(&v->mapa_participantes, 0);
+    if (!v->fp_reg_est && v->qtd_parciais == 0) {
         perror("Erro ao abrir arquivo de registro por estado");
+        liberar_versao_leitura(v);
         return;
     }
 
-    FILE *fp_participantes = fopen(nome_participantes_bin, "rb");
+    FILE *fp_participantes = v->fp_participantes;
     if (!fp_participantes) {
         perror("Erro ao abrir arquivo de participantes");
-        fclose(fp_reg_est);
+        liberar_versao_leitura(v);
         return;
     }
 
-    // Abertura dos arquivos de metadados
-    HeaderLocalizacao header_loc;
-    FILE *fp_loc = abrir_arquivo_localizacao(nome_localizacao_bin, &header_loc);
-    HeaderProva header_gab;
-    FILE *fp_gab = abrir_arquivo_gabarito(nome_gabarito_bin, &header_gab);
+    FILE *fp_loc = v->fp_loc;
+    FILE *fp_gab = v->fp_gab;
 
-    if (!fp_participantes || !fp_loc || !fp_gab) {
+    if (!fp_loc || !fp_gab) {
         perror("Erro ao abrir arquivo(s) para leitura");
-        if (fp_participantes) fclose(fp_participantes);
-        if (fp_loc) fclose(fp_loc);
-        if (fp_gab) fclose(fp_gab);
+        liberar_versao_leitura(v);
         return;
     }
 
-
-    HeaderRegistroEstado h_reg_est;
-    fread(&h_reg_est, tamanho_header_registro_estado(), 1, fp_reg_est);
-
     // 2. Busca o ponto de incio na Tabela Hash
     int hash_index = funcao_hash_estado(estado_sigla);
 
     if (hash_index == -1) {
         printf("Estado '%s' nao reconhecido.\n", estado_sigla);
-        fclose(fp_participantes);
-        fclose(fp_reg_est);
+        liberar_versao_leitura(v);
         return;
     }
 
-    int pont_lista_inicial = h_reg_est.tabela_hash[hash_index].pont_lista;
+    // O total do Estado est nos cabealhos (o do ndice e os dos segmentos parciais), sem percorrer nada
+    int total_registros_estado = total_estado_versao(v, hash_index);
 
-    if (pont_lista_inicial == -1) {
+    if (total_registros_estado == 0) {
         printf("Nenhum participante encontrado para o Estado: %s\n", estado_sigla);
-        fclose(fp_participantes);
-        fclose(fp_reg_est);
+        liberar_versao_leitura(v);
         return;
     }
 
-    // CLCULO DO TOTAL DE REGISTROS NA LISTA (PRIMEIRA PASSAGEM) ---
-    int total_registros_estado = 0;
-    int p_temp = pont_lista_inicial;
-    while (p_temp != -1) {
-        NoRegistro *no_temp = buscar_no_registro(fp_reg_est, p_temp);
-        if (!no_temp) break;
-        total_registros_estado++;
-        p_temp = no_temp->prox;
-        free(no_temp);
-    }
-
-    if (total_registros_estado == 0) {
-        printf("Nenhum participante encontrado para o Estado: %s\n", estado_sigla);
-        fclose(fp_participantes);
-        fclose(fp_reg_est);
+    int *indices_pagina = (int *)malloc(REGPORPAG * sizeof(int));
+    if (!indices_pagina) {
+        perror("Erro de alocacao da pagina");
+        liberar_versao_leitura(v);
         return;
     }
 
@@ -1864,17 +6536,17 @@ void listar_por_estado(const char* estado_sigla) {
     long nova_pagina_input;
     char *endptr;
 
-    // LOOP DE PAGINAO E EXIBIO (SEGUNDA PASSAGEM) ---
+    // LOOP DE PAGINAO E EXIBIO ---
 
     do {
         // Converte a pgina de 1-based (usurio) para 0-based (clculo interno)
         int pagina_indice = pagina_atual - 1;
-        long regs_para_pular = (long)pagina_indice * REGPORPAG;
-        int regs_impressos = 0;
-        int regs_pulados = 0;
 
-        // Reinicia o percurso da lista encadeada para o incio
-        int p_atual_no = pont_lista_inicial;
+        // Os mais recentes aparecem primeiro: a pgina  o trecho do vetor que termina
+        // `pagina_indice * REGPORPAG` posies antes do fim, lido de uma vez e percorrido de trs para frente
+        int fim_pagina = total_registros_estado - pagina_indice * REGPORPAG;
+        int inicio_pagina = MAX(0, fim_pagina - REGPORPAG);
+        int qtd_pagina = ler_indices_estado_versao(v, hash_index, inicio_pagina, fim_pagina - inicio_pagina, indices_pagina);
 
         // --- PREPARAO DA EXIBIO ---
         printf("------------------------------------------------------------------------\n");
@@ -1883,30 +6555,17 @@ void listar_por_estado(const char* estado_sigla) {
         printf("------------------------------------------------------------------------\n");
         printf("NU_SEQ | ANO | ESCOLA | CIDADE | ESTADO | NOTA CN | NOTA CH | NOTA LC | NOTA MT| NOTA RED | MEDIA | LINGUA ESTRANGEIRA\n");
 
-        // 5. PERCURSO DA LISTA ENCADEDADA
-        while (p_atual_no != -1) {
-
-            // Se j imprimimos a pgina, podemos parar.
-            if (regs_impressos >= REGPORPAG) break;
-
-            // Busca o N da Lista Encadeada no Arquivo
-            NoRegistro *no_atual = buscar_no_registro(fp_reg_est, p_atual_no);
-            if (!no_atual) break;
-
-            // Pular registros das pginas anteriores
-            if (regs_pulados < regs_para_pular) {
-                regs_pulados++;
-                p_atual_no = no_atual->prox;
-                free(no_atual);
-                continue; // Pula este registro
-            }
+        // 5. PERCURSO DA PGINA
+        for (int i = qtd_pagina - 1; i >= 0; i--) {
 
             // Acessa o registro do Participante por ndice (O(1))
-            Participante *p = ler_participante_por_indice(fp_participantes, no_atual->indice_registro);
+            RegistroParticipante participante;
+            const RegistroParticipante *p = ler_participante_versao(v, indices_pagina[i], &participante);
 
             if (p) {
                         // Busca O(1) e exibe a Localizao
-                        Localizacao *loc = buscar_localizacao_por_indice(fp_loc, p->indice_localizacao);
+                        Localizacao loc_lida;
+                        const Localizacao *loc = buscar_localizacao_versao(v, p->indice_localizacao, &loc_lida);
                         char cidade_temp[60] = "Nao Encontrada";
                         char estado_temp[20] = "Nao Encontrado";
                         char cod_esc_temp[15] = "N/A";
@@ -1915,7 +6574,6 @@ void listar_por_estado(const char* estado_sigla) {
                             strcpy(cidade_temp, loc->cidade);
                             strcpy(estado_temp, loc->estado);
                             strcpy(cod_esc_temp, loc->cod_esc);
-                            free(loc);
                         }
 
                          char lingua[15];
@@ -1925,18 +6583,15 @@ void listar_por_estado(const char* estado_sigla) {
                         }
                         else
                         {
-                            strcpy(lingua, "Espanhol");
+                            strcpy(lingua, p->ling_est == 1 ? "Espanhol" : "N/A");
                         }
 
 
                         printf("%s | %d | %s | %s | %s | %.2f | %.2f | %.2f | %.2f | %.2f | %.2f | %s\n",
                                p->nu_seq, p->ano, cod_esc_temp, cidade_temp, estado_temp,
-                               p->nota_cn, p->nota_ch, p->nota_lc, p->nota_mt, p->nota_red, (p->nota_cn+p->nota_ch+p->nota_lc+p->nota_mt+p->nota_red)/5, lingua);
-                        free(p);
+                               NOTA_PARA_FLOAT(p->nota_cn), NOTA_PARA_FLOAT(p->nota_ch), NOTA_PARA_FLOAT(p->nota_lc), NOTA_PARA_FLOAT(p->nota_mt),
+                               NOTA_PARA_FLOAT(p->nota_red), media_participante(p), lingua);
             }
-            regs_impressos++;
-            p_atual_no = no_atual->prox; // Prximo n na lista encadeada
-            free(no_atual);
         }
 
         // INTERAO COM O USURIO E VALIDAO
@@ -1979,59 +6634,44 @@ void listar_por_estado(const char* estado_sigla) {
 
     } while (!sair);
 
-    fclose(fp_participantes);
-    fclose(fp_reg_est);
+    free(indices_pagina);
+    liberar_versao_leitura(v);
 }
 
 // Implementao para listar do menor para o maior (Forward traversal)
 void listar_ordenado(const char* tipo_nota) {
-    int index = -1;
-    if (strcmp(tipo_nota, "cn") == 0) index = 0;
-    else if (strcmp(tipo_nota, "ch") == 0) index = 1;
-    else if (strcmp(tipo_nota, "lc") == 0) index = 2;
-    else if (strcmp(tipo_nota, "mt") == 0) index = 3;
-    else if (strcmp(tipo_nota, "red") == 0) index = 4;
+    int index = indice_tipo_nota(tipo_nota);
 
     if (index == -1) {
         printf("Tipo de nota '%s' nao reconhecido.\n", tipo_nota);
         return;
     }
 
-    FILE *f_metadados = arvores[index].f_metadados;
-    FILE *f_dados = arvores[index].f_dados;
-    FILE *fp_participantes = fopen(nome_participantes_bin, "rb");
-
-    // Abertura dos arquivos de metadados O(1)
-    HeaderLocalizacao header_loc;
-    FILE *fp_loc = abrir_arquivo_localizacao(nome_localizacao_bin, &header_loc);
-    HeaderProva header_gab;
-    FILE *fp_gab = abrir_arquivo_gabarito(nome_gabarito_bin, &header_gab);
+    // rvore e arquivos da verso de leitura atual
+    VersaoLeitura *v = adquirir_versao_leitura();
+    // Os participantes vm na ordem do ndice, fora da ordem do arquivo
+    aconselhar_acesso_mapeado(&v->mapa_participantes, 0);
+    ArvoreBmais *arvore = &v->arvores[index];
+    FILE *fp_participantes = v->fp_participantes;
+    FILE *fp_loc = v->fp_loc;
+    FILE *fp_gab = v->fp_gab;
 
-    if (!fp_participantes || !fp_loc || !fp_gab) {
+    if (!fp_participantes || !fp_loc || !fp_gab || !arvore->f_metadados) {
         perror("Erro ao abrir arquivo(s) para leitura");
-        if (fp_participantes) fclose(fp_participantes);
-        if (fp_loc) fclose(fp_loc);
-        if (fp_gab) fclose(fp_gab);
+        liberar_versao_leitura(v);
         return;
     }
 
-    Metadados *md = le_metadados(f_metadados);
-    if (!md || md->pont_raiz == -1) {
+    if (indice_nota_vazio(arvore) && v->qtd_parciais == 0) {
         printf("A arvore de nota_%s esta vazia.\n", tipo_nota);
-        free(md);
-        fclose(fp_gab);
-        fclose(fp_loc);
-        fclose(fp_participantes);
+        liberar_versao_leitura(v);
         return;
     }
 
-    int total_registros = obter_total_registros_participantes(nome_participantes_bin);
+    int total_registros = total_registros_versao(v);
     if (total_registros == 0) {
         printf("Nenhum registro encontrado na arvore de nota_%s.\n", tipo_nota);
-        free(md);
-        fclose(fp_gab);
-        fclose(fp_loc);
-        fclose(fp_participantes);
+        liberar_versao_leitura(v);
         return;
     }
 
@@ -2057,76 +6697,56 @@ void listar_ordenado(const char* tipo_nota) {
         printf("------------------------------------------------------------------------\n");
         printf("NU_SEQ | ANO | ESCOLA | CIDADE | ESTADO | NOTA CN | NOTA CH | NOTA LC | NOTA MT| NOTA RED | MEDIA | LINGUA ESTRANGEIRA\n");
 
-        // Varivel de controle de travessia na B+ Tree
-        int p_atual = md->pont_primeira_folha; // Comea na PRIMEIRA folha (menor nota)
-
-
-        // 1. PERCURSO DIRETO DOS NS DE DADOS (FOLHAS)
-        while (p_atual != -1) {
-            NoDados *nd = buscar_no_dados(p_atual, f_dados);
-            if (!nd) break;
-
-            // 2. ITERAO DIRETA DENTRO DO N DE DADOS (i = 0 at nd->m - 1)
-            for (int i = 0; i < nd->m; i++) {
-
+        // Percurso em ordem pelo cursor da rvore (folhas da B+ ou runs do LSM), com os segmentos parciais
+        CursorNota cursor;
+        EntradaIndiceNota entrada;
+        if (cursor_nota_abrir_versao(&cursor, v, index, 0) == 0) {
+            while (regs_impressos < REGPORPAG && cursor_nota_proximo(&cursor, &entrada)) {
                 // Pular registros das pginas anteriores
                 if (regs_pulados < regs_para_pular) {
                     regs_pulados++;
-                    continue; // Pula este registro
+                    continue;
                 }
 
                 // Imprimir registros da pgina atual
-                if (regs_impressos < REGPORPAG) {
-
-                    EntradaIndiceNota entrada = nd->s[i];
-                    Participante *p = ler_participante_por_indice(fp_participantes, entrada.indice_registro);
-
-                    if (p) {
-                        // Busca O(1) e exibe a Localizao
-                        Localizacao *loc = buscar_localizacao_por_indice(fp_loc, p->indice_localizacao);
-                        char cidade_temp[60] = "Nao Encontrada";
-                        char estado_temp[20] = "Nao Encontrado";
-                        char cod_esc_temp[15] = "N/A";
-
-                        if (loc) {
-                            strcpy(cidade_temp, loc->cidade);
-                            strcpy(estado_temp, loc->estado);
-                            strcpy(cod_esc_temp, loc->cod_esc);
-                            free(loc);
-                        }
+                RegistroParticipante participante;
+                const RegistroParticipante *p = ler_participante_versao(v, entrada.indice_registro, &participante);
+
+                if (p) {
+                    // Busca O(1) e exibe a Localizao
+                    Localizacao loc_lida;
+                    const Localizacao *loc = buscar_localizacao_versao(v, p->indice_localizacao, &loc_lida);
+                    char cidade_temp[60] = "Nao Encontrada";
+                    char estado_temp[20] = "Nao Encontrado";
+                    char cod_esc_temp[15] = "N/A";
+
+                    if (loc) {
+                        strcpy(cidade_temp, loc->cidade);
+                        strcpy(estado_temp, loc->estado);
+                        strcpy(cod_esc_temp, loc->cod_esc);
+                    }
 
 
-                         char lingua[15];
-                         if(!p->ling_est)
-                        {
-                            strcpy(lingua, "Ingles");
-                        }
-                        else
-                        {
-                            strcpy(lingua, "Espanhol");
-                        }
+                     char lingua[15];
+                     if(!p->ling_est)
+                    {
+                        strcpy(lingua, "Ingles");
+                    }
+                    else
+                    {
+                        strcpy(lingua, p->ling_est == 1 ? "Espanhol" : "N/A");
+                    }
 
 
-                        printf("%s | %d | %s | %s | %s | %.2f | %.2f | %.2f | %.2f | %.2f | %.2f | %s\n",
-                               p->nu_seq, p->ano, cod_esc_temp, cidade_temp, estado_temp,
-                               p->nota_cn, p->nota_ch, p->nota_lc, p->nota_mt, p->nota_red, (p->nota_cn+p->nota_ch+p->nota_lc+p->nota_mt+p->nota_red)/5, lingua);
-                        free(p);
-                    }
-                    regs_impressos++;
-                } else {
-                    // A pgina atual est completa.
-                    // Libera o n e fora a sada.
-                    free(nd);
-                    p_atual = -1; // Fora a sada do while
-                    break;
+                    printf("%s | %d | %s | %s | %s | %.2f | %.2f | %.2f | %.2f | %.2f | %.2f | %s\n",
+                           p->nu_seq, p->ano, cod_esc_temp, cidade_temp, estado_temp,
+                           NOTA_PARA_FLOAT(p->nota_cn), NOTA_PARA_FLOAT(p->nota_ch), NOTA_PARA_FLOAT(p->nota_lc), NOTA_PARA_FLOAT(p->nota_mt),
+                           NOTA_PARA_FLOAT(p->nota_red), media_participante(p), lingua);
                 }
-            } // Fim do loop for
-
-            if (p_atual != -1) {
-                p_atual = nd->prox; // Prximo n na lista encadeada (Forward Traversal)
-                free(nd);
+                regs_impressos++;
             }
-        } // Fim do loop while (p_atual)
+        }
+        cursor_nota_fechar(&cursor);
 
         // Mensagem de interao
         printf("------------------------------------------------------------------------\n");
@@ -2168,64 +6788,45 @@ void listar_ordenado(const char* tipo_nota) {
         }
 
     } while (!sair);
-
-    free(md);
-    fclose(fp_gab);
-    fclose(fp_loc);
-    fclose(fp_participantes);
+    liberar_versao_leitura(v);
     printf("------------------------------------------------------------------------\n");
 }
 
 // Implementao para listar do maior para o menor (Reverse traversal)
 void listar_ordenado_reverso(const char* tipo_nota) {
-    int index = -1;
-    if (strcmp(tipo_nota, "cn") == 0) index = 0;
-    else if (strcmp(tipo_nota, "ch") == 0) index = 1;
-    else if (strcmp(tipo_nota, "lc") == 0) index = 2;
-    else if (strcmp(tipo_nota, "mt") == 0) index = 3;
-    else if (strcmp(tipo_nota, "red") == 0) index = 4;
+    int index = indice_tipo_nota(tipo_nota);
 
     if (index == -1) {
         printf("Tipo de nota '%s' nao reconhecido.\n", tipo_nota);
         return;
     }
 
-    FILE *f_metadados = arvores[index].f_metadados;
-    FILE *f_dados = arvores[index].f_dados;
-    FILE *fp_participantes = fopen(nome_participantes_bin, "rb");
+    // rvore e arquivos da verso de leitura atual
+    VersaoLeitura *v = adquirir_versao_leitura();
+    // Os participantes vm na ordem do ndice, fora da ordem do arquivo
+    aconselhar_acesso_mapeado(&v->mapa_participantes, 0);
+    ArvoreBmais *arvore = &v->arvores[index];
+    FILE *fp_participantes = v->fp_participantes;
+    FILE *fp_loc = v->fp_loc;
+    FILE *fp_gab = v->fp_gab;
 
-    // Abertura dos arquivos de metadados O(1)
-    HeaderLocalizacao header_loc;
-    FILE *fp_loc = abrir_arquivo_localizacao(nome_localizacao_bin, &header_loc);
-    HeaderProva header_gab;
-    FILE *fp_gab = abrir_arquivo_gabarito(nome_gabarito_bin, &header_gab);
-
-    if (!fp_participantes || !fp_loc || !fp_gab) {
+    if (!fp_participantes || !fp_loc || !fp_gab || !arvore->f_metadados) {
         perror("Erro ao abrir arquivo(s) para leitura");
-        if (fp_participantes) fclose(fp_participantes);
-        if (fp_loc) fclose(fp_loc);
-        if (fp_gab) fclose(fp_gab);
+        liberar_versao_leitura(v);
         return;
     }
 
-    Metadados *md = le_metadados(f_metadados);
-    if (!md || md->pont_raiz == -1) {
+    if (indice_nota_vazio(arvore) && v->qtd_parciais == 0) {
         printf("A arvore de nota_%s esta vazia.\n", tipo_nota);
-        free(md);
-        fclose(fp_gab);
-        fclose(fp_loc);
-        fclose(fp_participantes);
+        liberar_versao_leitura(v);
         return;
     }
 
     // Obter total de registros do arquivo principal (O(1))
-    int total_registros = obter_total_registros_participantes(nome_participantes_bin);
+    int total_registros = total_registros_versao(v);
     if (total_registros == 0) {
         printf("Nenhum registro encontrado na arvore de nota_%s.\n", tipo_nota);
-        free(md);
-        fclose(fp_gab);
-        fclose(fp_loc);
-        fclose(fp_participantes);
+        liberar_versao_leitura(v);
         return;
     }
 
@@ -2253,74 +6854,55 @@ void listar_ordenado_reverso(const char* tipo_nota) {
         printf("------------------------------------------------------------------------\n");
         printf("NU_SEQ | ANO | ESCOLA | CIDADE | ESTADO | NOTA CN | NOTA CH | NOTA LC | NOTA MT| NOTA RED | MEDIA | LINGUA ESTRANGEIRA\n");
 
-        // Varivel de controle de travessia na B+ Tree
-        int p_atual = md->pont_ultima_folha;
-
-        // 1. PERCURSO REVERSO DOS NS DE DADOS (FOLHAS)
-        while (p_atual != -1) {
-            NoDados *nd = buscar_no_dados(p_atual, f_dados);
-            if (!nd) break;
-
-            // 2. ITERAO REVERSA DENTRO DO N DE DADOS
-            for (int i = nd->m - 1; i >= 0; i--) {
-
+        // Percurso em ordem pelo cursor da rvore (folhas da B+ ou runs do LSM), com os segmentos parciais
+        CursorNota cursor;
+        EntradaIndiceNota entrada;
+        if (cursor_nota_abrir_versao(&cursor, v, index, 1) == 0) {
+            while (regs_impressos < REGPORPAG && cursor_nota_proximo(&cursor, &entrada)) {
                 // Pular registros das pginas anteriores
                 if (regs_pulados < regs_para_pular) {
                     regs_pulados++;
-                    continue; // Pula este registro
+                    continue;
                 }
 
                 // Imprimir registros da pgina atual
-                if (regs_impressos < REGPORPAG) {
-
-                    EntradaIndiceNota entrada = nd->s[i];
-                    Participante *p = ler_participante_por_indice(fp_participantes, entrada.indice_registro);
-
-                    if (p) {
-                        // Busca O(1) e exibe a Localizao
-                        Localizacao *loc = buscar_localizacao_por_indice(fp_loc, p->indice_localizacao);
-                        char cidade_temp[60] = "Nao Encontrada";
-                        char estado_temp[20] = "Nao Encontrado";
-                        char cod_esc_temp[15] = "N/A";
-
-                        if (loc) {
-                            strcpy(cidade_temp, loc->cidade);
-                            strcpy(estado_temp, loc->estado);
-                            strcpy(cod_esc_temp, loc->cod_esc);
-                            free(loc);
-                        }
+                RegistroParticipante participante;
+                const RegistroParticipante *p = ler_participante_versao(v, entrada.indice_registro, &participante);
+
+                if (p) {
+                    // Busca O(1) e exibe a Localizao
+                    Localizacao loc_lida;
+                    const Localizacao *loc = buscar_localizacao_versao(v, p->indice_localizacao, &loc_lida);
+                    char cidade_temp[60] = "Nao Encontrada";
+                    char estado_temp[20] = "Nao Encontrado";
+                    char cod_esc_temp[15] = "N/A";
+
+                    if (loc) {
+                        strcpy(cidade_temp, loc->cidade);
+                        strcpy(estado_temp, loc->estado);
+                        strcpy(cod_esc_temp, loc->cod_esc);
+                    }
 
-                        char lingua[15];
-                        if(!p->ling_est)
-                        {
-                            strcpy(lingua, "Ingles");
-                        }
-                        else
-                        {
-                            strcpy(lingua, "Espanhol");
-                        }
+                    char lingua[15];
+                    if(!p->ling_est)
+                    {
+                        strcpy(lingua, "Ingles");
+                    }
+                    else
+                    {
+                        strcpy(lingua, p->ling_est == 1 ? "Espanhol" : "N/A");
+                    }
 
 
-                        printf("%s | %d | %s | %s | %s | %.2f | %.2f | %.2f | %.2f | %.2f | %.2f | %s\n",
-                               p->nu_seq, p->ano, cod_esc_temp, cidade_temp, estado_temp,
-                               p->nota_cn, p->nota_ch, p->nota_lc, p->nota_mt, p->nota_red,(p->nota_cn+p->nota_ch+p->nota_lc+p->nota_mt+p->nota_red)/5, lingua);
-                        free(p);
-                    }
-                    regs_impressos++;
-                } else {
-                    // A pgina atual est completa.
-                    // Libera o n e sai da funo.
-                    free(nd);
-                    p_atual = -1; // Fora a sada do while
-                    break;
+                    printf("%s | %d | %s | %s | %s | %.2f | %.2f | %.2f | %.2f | %.2f | %.2f | %s\n",
+                           p->nu_seq, p->ano, cod_esc_temp, cidade_temp, estado_temp,
+                           NOTA_PARA_FLOAT(p->nota_cn), NOTA_PARA_FLOAT(p->nota_ch), NOTA_PARA_FLOAT(p->nota_lc), NOTA_PARA_FLOAT(p->nota_mt),
+                           NOTA_PARA_FLOAT(p->nota_red), media_participante(p), lingua);
                 }
-            } // Fim do loop for
-
-            if (p_atual != -1) {
-                p_atual = nd->ant; // N ANTERIOR na lista duplamente encadeada
-                free(nd);
+                regs_impressos++;
             }
-        } // Fim do loop while (p_atual)
+        }
+        cursor_nota_fechar(&cursor);
 
 
         // Mensagem de interao
@@ -2363,51 +6945,560 @@ void listar_ordenado_reverso(const char* tipo_nota) {
         }
 
     } while (!sair);
-
-    free(md);
-    fclose(fp_gab);
-    fclose(fp_loc);
-    fclose(fp_participantes);
+    liberar_versao_leitura(v);
     printf("------------------------------------------------------------------------\n");
 }
 
 void limpar_arquivos_bmais() {
-    char *nomes[] = {"cn", "ch", "lc", "mt", "red"};
     int i;
     for (i = 0; i < 5; i++) {
-        char nome_base[100];
-        sprintf(nome_base, "nota_%s", nomes[i]);
+        const char *nome_base = arvores[i].nome;
 
-        char nome_meta[120], nome_idx[120], nome_dados[120];
-        sprintf(nome_meta, "%s_meta.dat", nome_base);
-        sprintf(nome_idx, "%s_indice.dat", nome_base);
-        sprintf(nome_dados, "%s_dados.dat", nome_base);
+        char nome_meta[TAM_CAMINHO], nome_idx[TAM_CAMINHO], nome_dados[TAM_CAMINHO];
+        nome_arquivo_arvore(&arvores[i], "meta", nome_meta);
+        nome_arquivo_arvore(&arvores[i], "indice", nome_idx);
+        nome_arquivo_arvore(&arvores[i], "dados", nome_dados);
 
         remove(nome_meta);
         remove(nome_idx);
         remove(nome_dados);
+        // Manifesto e runs, se a rvore usava o motor LSM
+        if (lsm_remover(&arvores[i].lsm)) {
+            printf("Indice LSM de %s (manifesto e runs) removido.\n", nome_base);
+        }
     }
     printf("Arquivos das 5 rvores B+ (metadados, indice, dados) removidos.\n");
 }
 
+/************************************************ VERSES DA BASE ************************************************/
+
+// RELOAD constri a base inteira num diretrio novo (base_<n>) enquanto a atual segue em uso, e s ento
+// troca de verso regravando o arquivo de ponteiro com rename. Cada sesso segura um lock compartilhado
+// no diretrio da verso que usa e passa para a nova entre um comando e outro; uma verso antiga s 
+// apagada quando nenhuma sesso a segura mais.
+const char *nome_ponteiro_base = "base_atual";
+const char *nome_lock_base = "sessao.lock";
+int fd_lock_base = -1; // Lock compartilhado desta sesso na verso em uso
+
+// Aponta os nomes dos arquivos da base para o diretrio `dir`
+void definir_diretorio_base(const char *dir) {
+    montar_caminho(DIRETORIO_BASE, sizeof(DIRETORIO_BASE), "%s", dir);
+    caminho_na_base(nome_participantes_bin, sizeof(nome_participantes_bin), "participantes.bin");
+    caminho_na_base(nome_respostas_bin, sizeof(nome_respostas_bin), "participantes_respostas.bin");
+    caminho_na_base(nome_localizacao_bin, sizeof(nome_localizacao_bin), "localizacao.bin");
+    caminho_na_base(nome_registro_estado_bin, sizeof(nome_registro_estado_bin), "reg_por_estado.bin");
+    caminho_na_base(nome_gabarito_bin, sizeof(nome_gabarito_bin), "gabarito_provas.bin");
+    caminho_na_base(nome_trie_bin, sizeof(nome_trie_bin), "trie_nuseq.bin");
+    caminho_na_base(nome_extras_bin, sizeof(nome_extras_bin), "participantes_extra.bin");
+    caminho_na_base(nome_resumo_importacao, sizeof(nome_resumo_importacao), "resumo_importacao.json");
+    caminho_na_base(nome_checkpoint_importacao, sizeof(nome_checkpoint_importacao), "importacao.ckpt");
+}
+
+// 0 para a base legada ("."), n para base_<n>
+int numero_versao_base(const char *dir) {
+    int n = 0;
+    if (sscanf(dir, "base_%d", &n) != 1 || n < 1) return 0;
+    return n;
+}
+
+void nome_versao_base(int n, char *destino, size_t tamanho) {
+    if (n == 0) snprintf(destino, tamanho, ".");
+    else snprintf(destino, tamanho, "base_%d", n);
+}
+
+// Verso apontada pelo arquivo de ponteiro ("." se ele no existe)
+void ler_ponteiro_base(char *destino, size_t tamanho) {
+    char linha[64] = "";
+    FILE *fp = fopen(nome_ponteiro_base, "r");
+    if (fp) {
+        if (fgets(linha, sizeof(linha), fp) == NULL) linha[0] = '\0';
+        fclose(fp);
+    }
+    nome_versao_base(numero_versao_base(linha), destino, tamanho);
+}
+
+// Troca a verso em uso: o ponteiro novo  gravado inteiro ao lado e entra no lugar do antigo com rename
+int gravar_ponteiro_base(const char *dir) {
+    char nome_tmp[TAM_CAMINHO];
+    montar_caminho(nome_tmp, sizeof(nome_tmp), "%s.tmp", nome_ponteiro_base);
+    FILE *fp = fopen(nome_tmp, "w");
+    if (!fp) {
+        perror("Erro ao gravar o ponteiro da base");
+        return 1;
+    }
+    fprintf(fp, "%s\n", dir);
+    fflush(fp);
+#ifndef _WIN32
+    fsync(fileno(fp));
+#endif
+    fclose(fp);
+#ifdef _WIN32
+    // O rename do Windows no substitui um arquivo existente
+    remove(nome_ponteiro_base);
+#endif
+    if (rename(nome_tmp, nome_ponteiro_base) != 0) {
+        perror("Erro ao trocar o ponteiro da base");
+        return 1;
+    }
+    sincronizar_caminho_disco("."); // O rename s  definitivo com o diretrio no disco
+    return 0;
+}
+
+void caminho_lock_versao_base(const char *dir, char *destino) {
+    if (strcmp(dir, ".") == 0) montar_caminho(destino, TAM_CAMINHO, "%s", nome_lock_base);
+    else montar_caminho(destino, TAM_CAMINHO, "%s/%s", dir, nome_lock_base);
+}
+
+// Trava a verso em `dir`: compartilhado (sesso que a usa; espera um exclusivo em andamento) ou exclusivo
+// (quem vai apag-la ou constru-la; no espera). Retorna o descritor que segura o lock, ou -1.
+// No Windows no h lock: a verso antiga  apagada logo depois da troca, e os arquivos que outra sesso
+// ainda tem abertos simplesmente no so removidos.
+int travar_versao_base(const char *dir, int exclusivo) {
+#ifndef _WIN32
+    char nome[TAM_CAMINHO];
+    caminho_lock_versao_base(dir, nome);
+    int fd = open(nome, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return -1;
+    if (flock(fd, exclusivo ? (LOCK_EX | LOCK_NB) : LOCK_SH) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+#else
+    (void)dir;
+    (void)exclusivo;
+    return 0;
+#endif
+}
+
+void destravar_versao_base(int fd) {
+#ifndef _WIN32
+    if (fd >= 0) close(fd);
+#else
+    (void)fd;
+#endif
+}
+
+int criar_diretorio_base(const char *dir) {
+#ifndef _WIN32
+    return mkdir(dir, 0755);
+#else
+    return _mkdir(dir);
+#endif
+}
+
+int remover_diretorio_base(const char *dir) {
+#ifndef _WIN32
+    return rmdir(dir);
+#else
+    return _rmdir(dir);
+#endif
+}
+
+// Retorna 1 se ainda h arquivos da verso em `dir` (a legada sempre tem as rvores, criadas na abertura)
+int versao_base_existe(const char *dir) {
+    struct stat st;
+    if (strcmp(dir, ".") == 0) return stat("nota_cn_meta.dat", &st) == 0;
+    return stat(dir, &st) == 0;
+}
+
+// Entra na verso apontada pelo ponteiro, segurando o lock compartilhado dela. Se o ponteiro muda
+// enquanto o lock  pedido, a verso travada pode estar sendo apagada: tenta de novo com a nova.
+void entrar_versao_atual_base() {
+    char dir[TAM_DIRETORIO_BASE], conferido[TAM_DIRETORIO_BASE];
+    int fd;
+    for (;;) {
+        ler_ponteiro_base(dir, sizeof(dir));
+        fd = travar_versao_base(dir, 0);
+        ler_ponteiro_base(conferido, sizeof(conferido));
+        if (strcmp(dir, conferido) == 0) break;
+        destravar_versao_base(fd);
+    }
+    fd_lock_base = fd;
+    definir_diretorio_base(dir);
+}
+
+// Sai da verso em uso (as rvores j devem estar fechadas)
+void sair_versao_base() {
+    destravar_versao_base(fd_lock_base);
+    fd_lock_base = -1;
+}
+
+// Chama `acao` com o caminho de cada arquivo da base na verso em `dir` (as runs LSM antes do manifesto
+// delas). Retorna quantas chamadas falharam
+int para_cada_arquivo_versao_base(const char *dir, int (*acao)(const char *nome)) {
+    char em_uso[TAM_DIRETORIO_BASE];
+    snprintf(em_uso, sizeof(em_uso), "%s", DIRETORIO_BASE);
+    definir_diretorio_base(dir);
+
+    int falhas = 0;
+    const char *arquivos[] = {nome_participantes_bin, nome_respostas_bin, nome_localizacao_bin, nome_registro_estado_bin, nome_gabarito_bin,
+                              nome_trie_bin, nome_extras_bin, nome_resumo_importacao, nome_checkpoint_importacao};
+    for (int i = 0; i < 9; i++) falhas += (acao(arquivos[i]) != 0);
+    const char *sufixos[3] = {"meta", "indice", "dados"};
+    for (int i = 0; i < 5; i++) {
+        char nome[TAM_CAMINHO];
+        for (int j = 0; j < 3; j++) {
+            nome_arquivo_arvore(&arvores[i], sufixos[j], nome);
+            falhas += (acao(nome) != 0);
+        }
+        IndiceLsm lsm;
+        caminho_na_base(lsm.nome, sizeof(lsm.nome), arvores[i].nome);
+        if (lsm_ler_manifesto(&lsm)) {
+            for (int r = 0; r < lsm.manifesto.qtd_runs; r++) {
+                nome_run_lsm(lsm.nome, lsm.manifesto.runs[r].id, nome);
+                falhas += (acao(nome) != 0);
+            }
+            nome_manifesto_lsm(&lsm, nome);
+            falhas += (acao(nome) != 0);
+        }
+    }
+
+    definir_diretorio_base(em_uso);
+    return falhas;
+}
+
+// Apaga os arquivos da base na verso em `dir`, que esta sesso no est usando
+void apagar_arquivos_versao_base(const char *dir) {
+    para_cada_arquivo_versao_base(dir, remove); // Os que no existem so ignorados
+}
+
+// Leva ao disco os arquivos da verso em `dir` e o prprio diretrio, antes de o ponteiro apontar para ela:
+// sem isso uma queda logo depois da troca pode deixar o ponteiro numa verso com arquivos vazios ou faltando.
+// Retorna 0 em caso de sucesso.
+int sincronizar_versao_base(const char *dir) {
+    int falhas = para_cada_arquivo_versao_base(dir, sincronizar_caminho_disco);
+    falhas += sincronizar_caminho_disco(dir);
+    if (falhas > 0) {
+        perror("Erro ao gravar no disco a nova versao da base");
+        return 1;
+    }
+    return 0;
+}
+
+// Apaga as verses anteriores  em uso que nenhuma sesso segura mais; as ainda em uso ficam para depois
+void recolher_versoes_antigas_base() {
+    int atual = numero_versao_base(DIRETORIO_BASE);
+    for (int n = 0; n < atual; n++) {
+        char dir[TAM_DIRETORIO_BASE], nome_lock[TAM_CAMINHO];
+        nome_versao_base(n, dir, sizeof(dir));
+        if (!versao_base_existe(dir)) continue;
+        int fd = travar_versao_base(dir, 1);
+        if (fd < 0) {
+            printf("Versao antiga '%s' da base ainda em uso por outra sessao; sera apagada quando ela sair.\n", dir);
+            continue;
+        }
+        apagar_arquivos_versao_base(dir);
+        caminho_lock_versao_base(dir, nome_lock);
+        remove(nome_lock);
+        if (n > 0) remover_diretorio_base(dir);
+        destravar_versao_base(fd);
+        printf("Versao antiga '%s' da base apagada.\n", dir);
+    }
+}
+
+// Entre um comando e outro: se outra sesso trocou a base com RELOAD, passa para a verso nova
+void acompanhar_versao_base() {
+    char dir[TAM_DIRETORIO_BASE];
+    ler_ponteiro_base(dir, sizeof(dir));
+    if (strcmp(dir, DIRETORIO_BASE) == 0) return;
+    fechar_arvores();
+    sair_versao_base();
+    entrar_versao_atual_base();
+    inicializar_arvores();
+    for (int i = 0; i < 5; i++) {
+        MOTOR_INDICE_NOTA[i] = arvores[i].motor;
+    }
+    printf("A base foi trocada por outra sessao; agora em uso: '%s'.\n", DIRETORIO_BASE);
+    recolher_versoes_antigas_base();
+}
+
+// RELOAD: importa o CSV numa verso nova da base e troca para ela s com tudo gravado
+void recarregar_base(char *nome_csv) {
+    char antiga[TAM_DIRETORIO_BASE], nova[TAM_DIRETORIO_BASE];
+    snprintf(antiga, sizeof(antiga), "%s", DIRETORIO_BASE);
+    nome_versao_base(numero_versao_base(antiga) + 1, nova, sizeof(nova));
+
+    criar_diretorio_base(nova);
+    int fd_nova = travar_versao_base(nova, 1);
+    if (fd_nova < 0) {
+        printf("ERRO: Outra sessao ja esta construindo a versao '%s' da base.\n", nova);
+        return;
+    }
+    // S quem segura o lock exclusivo de uma verso aponta para ela: se o ponteiro j passou daqui, outra
+    // sesso trocou a base depois do ltimo comando, e `nova` pode ser a verso em uso
+    char apontada[TAM_DIRETORIO_BASE];
+    ler_ponteiro_base(apontada, sizeof(apontada));
+    if (numero_versao_base(apontada) >= numero_versao_base(nova)) {
+        destravar_versao_base(fd_nova);
+        printf("ERRO: Outra sessao trocou a base agora ha pouco; tente o RELOAD de novo.\n");
+        return;
+    }
+    // Sobras de um RELOAD interrompido nesse mesmo diretrio
+    apagar_arquivos_versao_base(nova);
+
+    fechar_arvores();
+    definir_diretorio_base(nova);
+    inicializar_arvores();
+    printf("Construindo a nova versao da base em '%s'; a versao '%s' segue em uso ate a troca.\n", nova, antiga);
+
+    int erro = importar_participantes_csv(nome_csv, nome_participantes_bin, 0);
+    fechar_arvores();
+    if (erro == 0) erro = sincronizar_versao_base(nova);
+    if (erro == 0) erro = gravar_ponteiro_base(nova);
+    if (erro != 0) {
+        char nome_lock[TAM_CAMINHO];
+        apagar_arquivos_versao_base(nova);
+        caminho_lock_versao_base(nova, nome_lock);
+        remove(nome_lock);
+        remover_diretorio_base(nova);
+        destravar_versao_base(fd_nova);
+        definir_diretorio_base(antiga);
+        inicializar_arvores();
+        printf("RELOAD cancelado; a base em uso continua '%s'.\n", antiga);
+        return;
+    }
+
+    destravar_versao_base(fd_nova);
+    sair_versao_base();
+    entrar_versao_atual_base();
+    inicializar_arvores();
+    printf("Base trocada: '%s' e a versao em uso.\n", DIRETORIO_BASE);
+    recolher_versoes_antigas_base();
+}
+
+// L um inteiro positivo digitado pelo usurio. Retorna -1 se a entrada for invlida.
+long ler_inteiro_positivo() {
+    char entrada[COMMAND_MAX_SIZE];
+    if (fgets(entrada, COMMAND_MAX_SIZE, stdin) == NULL) return -1;
+    size_t len = strlen(entrada);
+    if (len > 0 && entrada[len-1] == '\n') {
+        entrada[len-1] = '\0';
+    }
+    char *endptr;
+    long valor = strtol(entrada, &endptr, 10);
+    if (endptr == entrada || *endptr != '\0' || valor < 1) return -1;
+    return valor;
+}
+
+// CONFIG <PARAMETRO>: ajusta os parmetros da importao
+void configurar_parametro(const char *parametro) {
+    if (strcmp(parametro, "memoria") == 0) {
+        printf("\nDigite o limite de memoria (em MB) da ordenacao externa usada no READ (atual: %ld)\n", MEMORIA_ORDENACAO_MB);
+        long valor = ler_inteiro_positivo();
+        if (valor < 1) {
+            printf("ERRO: O limite de memoria deve ser um inteiro de pelo menos 1 MB.\n");
+        } else {
+            MEMORIA_ORDENACAO_MB = valor;
+        }
+    } else if (strcmp(parametro, "threads") == 0) {
+        printf("\nDigite quantas threads devem interpretar o CSV no READ (atual: %d)\n", obter_qtd_threads_importacao());
+        long valor = ler_inteiro_positivo();
+        if (valor < 1 || valor > 64) {
+            printf("ERRO: A quantidade de threads deve estar entre 1 e 64.\n");
+        } else {
+            THREADS_IMPORTACAO = (int)valor;
+        }
+    } else if (strcmp(parametro, "paralelo") == 0) {
+        printf("\nConstruir cada indice (5 arvores B+, Trie e Estado) em sua propria thread durante o READ?\n");
+        printf("1 - Sim (atual: %s)\n2 - Nao, atualizar um indice apos o outro\n", CONSTRUCAO_PARALELA_INDICES ? "sim" : "nao");
+        long valor = ler_inteiro_positivo();
+        if (valor == 1 || valor == 2) {
+            CONSTRUCAO_PARALELA_INDICES = (valor == 1);
+        } else {
+            printf("ERRO: Opcao invalida.\n");
+        }
+    } else if (strcmp(parametro, "checkpoint") == 0) {
+        printf("\nQuando gravar um checkpoint (ponto de retomada) durante o READ?\n");
+        printf("1 - Apenas no inicio e no fim da leitura\n2 - A cada N registros\n");
+        if (CHECKPOINT_IMPORTACAO > 0) {
+            printf("(atual: a cada %ld registros)\n", CHECKPOINT_IMPORTACAO);
+        } else {
+            printf("(atual: apenas no fim)\n");
+        }
+        long valor = ler_inteiro_positivo();
+        if (valor == 1) {
+            CHECKPOINT_IMPORTACAO = 0;
+        } else if (valor == 2) {
+            printf("Digite N:\n");
+            valor = ler_inteiro_positivo();
+            if (valor < 1) {
+                printf("ERRO: N deve ser um inteiro positivo.\n");
+            } else {
+                CHECKPOINT_IMPORTACAO = valor;
+            }
+        } else {
+            printf("ERRO: Opcao invalida.\n");
+        }
+    } else if (strcmp(parametro, "limpeza") == 0) {
+        printf("\nO que fazer no READ com linhas que tem algum campo vazio (vazio, so espacos, NA ou NaN)?\n");
+        printf("1 - Descartar a linha, como o limpeza.py\n2 - Manter a linha, o campo vira nulo\n");
+        printf("(atual: %s)\n", LIMPEZA_IMPORTACAO ? "descartar" : "manter");
+        long valor = ler_inteiro_positivo();
+        if (valor == 1 || valor == 2) {
+            LIMPEZA_IMPORTACAO = (valor == 1);
+        } else {
+            printf("ERRO: Opcao invalida.\n");
+        }
+    } else if (strcmp(parametro, "colunas") == 0) {
+        // Depois que o arquivo de colunas extras existe, o esquema dele vale at o CLEAR
+        HeaderExtras gravado;
+        FILE *fp_extra = abrir_arquivo_extras(nome_extras_bin, &gravado, NULL, 0);
+        if (fp_extra) {
+            fclose(fp_extra);
+            printf("\nA base ja grava as colunas extras:");
+            for (int i = 0; i < gravado.qtd_colunas; i++) printf(" %s", gravado.colunas[i].nome);
+            printf("\nUse CLEAR para escolher outras.\n");
+            return;
+        }
+
+        printf("\nQuais colunas do CSV gravar alem das do participante? (atual:");
+        if (ESQUEMA_EXTRAS.qtd_colunas == 0) printf(" nenhuma");
+        for (int i = 0; i < ESQUEMA_EXTRAS.qtd_colunas; i++) printf(" %s", ESQUEMA_EXTRAS.colunas[i].nome);
+        printf(")\nDisponiveis:");
+        for (int i = 0; i < QTD_CATALOGO_COLUNAS_EXTRAS; i++) {
+            printf("%s%s", i % 5 == 0 ? "\n  " : " ", CATALOGO_COLUNAS_EXTRAS[i].nome);
+        }
+        printf("\nDigite os nomes separados por espaco (ou NENHUMA):\n");
+
+        char entrada[1024];
+        if (fgets(entrada, sizeof(entrada), stdin) == NULL) return;
+        HeaderExtras novo;
+        memset(&novo, 0, sizeof(HeaderExtras));
+        int erro = 0;
+        for (char *nome = strtok(entrada, " ,;\t\r\n"); nome; nome = strtok(NULL, " ,;\t\r\n")) {
+            for (char *c = nome; *c; c++) *c = toupper((unsigned char)*c);
+            if (strcmp(nome, "NENHUMA") == 0) continue;
+            if (adicionar_coluna_extra(&novo, nome) == 1) {
+                printf("ERRO: Coluna '%s' nao disponivel.\n", nome);
+                erro = 1;
+            }
+        }
+        if (!erro) ESQUEMA_EXTRAS = novo;
+    } else if (strcmp(parametro, "segundoplano") == 0) {
+#ifdef _WIN32
+        // Os arquivos trocados por rename no podem estar abertos por uma verso de leitura no Windows
+        printf("\nO READ em segundo plano nao esta disponivel no Windows.\n");
+#else
+        printf("\nRodar o READ em segundo plano, deixando SHOW, FIND, FILTER e LIST disponiveis durante a importacao?\n");
+        printf("(ate o READ terminar, as consultas veem os participantes confirmados no ultimo checkpoint; ver CONFIG CHECKPOINT)\n");
+        printf("1 - Sim (atual: %s)\n2 - Nao\n", READ_EM_SEGUNDO_PLANO ? "sim" : "nao");
+        long valor = ler_inteiro_positivo();
+        if (valor == 1 || valor == 2) {
+            READ_EM_SEGUNDO_PLANO = (valor == 1);
+        } else {
+            printf("ERRO: Opcao invalida.\n");
+        }
+#endif
+    } else if (strcmp(parametro, "motor") == 0) {
+        printf("\nQual indice de nota deve mudar de motor? (CN, CH, LC, MT, RED ou TODAS)\n");
+        printf("(atual:");
+        for (int i = 0; i < 5; i++) printf(" %s=%s", arvores[i].nome, nome_motor_indice(MOTOR_INDICE_NOTA[i]));
+        printf(")\n");
+        char entrada[COMMAND_MAX_SIZE];
+        if (fgets(entrada, COMMAND_MAX_SIZE, stdin) == NULL) return;
+        entrada[strcspn(entrada, "\r\n")] = '\0';
+        to_lowercase(entrada);
+        int index = indice_tipo_nota(entrada);
+        if (index == -1 && strcmp(entrada, "todas") != 0) {
+            printf("ERRO: Nota '%s' nao reconhecida.\n", entrada);
+            return;
+        }
+
+        printf("1 - Arvore B+ (cada READ intercala as notas novas e reescreve a arvore)\n");
+        printf("2 - LSM (cada READ grava uma run ordenada; as runs sao compactadas em segundo plano)\n");
+        long valor = ler_inteiro_positivo();
+        if (valor != 1 && valor != 2) {
+            printf("ERRO: Opcao invalida.\n");
+            return;
+        }
+        int motor = (valor == 2) ? MOTOR_LSM : MOTOR_BMAIS;
+        for (int i = 0; i < 5; i++) {
+            if (index != -1 && i != index) continue;
+            MOTOR_INDICE_NOTA[i] = motor;
+            // Uma rvore com dados s muda de motor quando  reconstruda
+            lsm_esperar_compactacao(&arvores[i].lsm);
+            if (arvores[i].motor != motor && !indice_nota_vazio(&arvores[i])) {
+                printf("%s ja tem notas em %s; o novo motor vale a partir do proximo REINDEX (ou do READ depois de um CLEAR).\n",
+                       arvores[i].nome, nome_motor_indice(arvores[i].motor));
+            }
+        }
+    } else if (strcmp(parametro, "pool") == 0) {
+        printf("\nDigite o limite de memoria (em MB) do cache de paginas dos indices (atual: %ld)\n", MEMORIA_POOL_MB);
+        long valor = ler_inteiro_positivo();
+        if (valor < 1) {
+            printf("ERRO: O limite de memoria deve ser um inteiro de pelo menos 1 MB.\n");
+        } else {
+            redimensionar_pool(valor);
+        }
+    } else if (strcmp(parametro, "leitura") == 0) {
+#ifdef _WIN32
+        printf("\nA leitura por mmap nao esta disponivel no Windows.\n");
+#else
+        printf("\nComo SHOW, FIND, FILTER e LIST devem ler participantes, localizacoes e gabaritos?\n");
+        printf("(atual: %s)\n", LEITURA_MAPEADA ? "mmap" : "fread");
+        printf("1 - Mapeando os arquivos em memoria (mmap), sem copia por registro\n2 - Com fseek e fread a cada registro\n");
+        long valor = ler_inteiro_positivo();
+        if (valor == 1 || valor == 2) {
+            LEITURA_MAPEADA = (valor == 1);
+        } else {
+            printf("ERRO: Opcao invalida.\n");
+        }
+#endif
+    } else {
+        printf("Parametro '%s' nao reconhecido. Parametros: MEMORIA, THREADS, PARALELO, CHECKPOINT, LIMPEZA, COLUNAS, MOTOR, SEGUNDOPLANO, LEITURA, POOL\n", parametro);
+    }
+}
+
 int main(void) {
     bool sair = false;
     char nome_csv[100];
 
-    // 1. Inicializa as 5 rvores B+ (abre/cria os 15 arquivos)
+    // 1. Entra na verso da base em uso e inicializa as 5 rvores B+ (abre/cria os 15 arquivos)
+    entrar_versao_atual_base();
+    // Uma base gravada num formato anterior passa para o compacto antes de qualquer leitura
+    int convertida = converter_participantes_para_compacto();
+    if (convertida < 0) {
+        sair_versao_base();
+        return 1;
+    }
     inicializar_arvores();
+    // O motor de cada rvore comea como o que j est no disco
+    for (int i = 0; i < 5; i++) {
+        MOTOR_INDICE_NOTA[i] = arvores[i].motor;
+    }
+#if NOTA_PONTO_FIXO
+    // Os ndices de uma base anterior ao formato compacto tm chaves float
+    if (convertida > 0) reindexar_base(nome_participantes_bin);
+#else
+    (void)convertida;
+#endif
+    // Verses antigas que as sesses anteriores ainda seguravam
+    recolher_versoes_antigas_base();
 
     while(!sair) {
         char comando[COMMAND_MAX_SIZE];
         printf("\n\n------------------------------------------------------------------------\n");
+        if (recolher_importacao_segundo_plano(0)) {
+            VersaoLeitura *v = adquirir_versao_leitura();
+            printf("READ em segundo plano de '%s' em andamento: %d participantes visiveis.\n",
+                   importacao_segundo_plano.nome_csv, total_registros_versao(v));
+            liberar_versao_leitura(v);
+        } else {
+            acompanhar_versao_base();
+        }
         printf("Indique o que voce quer fazer:\n");
         printf("CLEAR - Limpa todo o banco de dados de registros e indices\n");
         printf("READ - Le um arquivo CSV com registros e faz toda a estruturacao\n");
+        printf("RELOAD - Le um arquivo CSV numa base nova e so entao troca a base em uso por ela\n");
+        printf("REINDEX - Reconstroi todos os indices a partir dos participantes ja gravados, sem o CSV\n");
         printf("SHOW - Mostra na tela os registros salvos em ordem de insercao, com todas informacoes\n");
         printf("LIST <NOTA> - Lista registros ordenados por nota. <NOTA>: CN, CH, LC, MT, RED\n");
         printf("FIND <NU_SEQ> - Busca um participante pela chave unica (Ex: FIND 0123456789)\n");
         printf("FILTER <ESTADO> - Lista todos os participantes de um Estado (ex: FILTER RS)\n");
+        printf("POOL - Mostra os acertos e faltas do cache de paginas dos indices (POOL ZERAR zera as contagens)\n");
         printf("CONFIG - Configura quantos registros devem aparecer por pagina\n");
+        printf("CONFIG <PARAMETRO> - Ajusta a importacao. <PARAMETRO>: MEMORIA, THREADS, PARALELO, CHECKPOINT, LIMPEZA, COLUNAS, MOTOR, SEGUNDOPLANO, LEITURA, POOL\n");
         printf("EXIT - Sai do programa\n");
         printf("------------------------------------------------------------------------\n");
         printf("> ");
@@ -2425,6 +7516,7 @@ int main(void) {
         to_lowercase(comando_base);
 
         if (strcmp(comando_base, "clear") == 0) {
+            if (recusar_durante_importacao("CLEAR")) continue;
             fechar_arvores();
             limpar_arquivos_bmais();
             if (remove(nome_gabarito_bin) == 0) {
@@ -2447,23 +7539,48 @@ int main(void) {
             } else {
                 perror("Aviso: Nao foi possivel remover o arquivo de participantes.bin");
             }
+            if (remove(nome_respostas_bin) == 0) {
+                printf("Arquivo de respostas '%s' removido com sucesso.\n", nome_respostas_bin);
+            } else {
+                perror("Aviso: Nao foi possivel remover o arquivo de participantes_respostas.bin");
+            }
             if (remove(nome_registro_estado_bin) == 0) {
                  printf("Arquivo Invertido por Estado '%s' removido com sucesso.\n", nome_registro_estado_bin);
             } else {
                  perror("Aviso: Nao foi possivel remover o arquivo reg_por_estado.bin");
             }
+            // S existe se CONFIG COLUNAS escolheu colunas extras
+            if (remove(nome_extras_bin) == 0) {
+                 printf("Arquivo de colunas extras '%s' removido com sucesso.\n", nome_extras_bin);
+            }
+            // Um READ interrompido no tem mais o que retomar
+            if (remove(nome_checkpoint_importacao) == 0) {
+                 printf("Checkpoint de importacao '%s' removido.\n", nome_checkpoint_importacao);
+            }
             // Reabre as rvores vazias
             inicializar_arvores();
         } else if (strcmp(comando_base, "read") == 0) {
+            if (recusar_durante_importacao("READ")) continue;
             printf("\nEscreva o nome do arquivo csv que voce quer ler (incluindo a extensao)\n");
             if (fgets(nome_csv, 100, stdin) == NULL) continue;
             size_t len2 = strlen(nome_csv);
             if (len2 > 0 && nome_csv[len2-1] == '\n') {
                 nome_csv[len2-1] = '\0';
             }
-            importar_participantes_csv(nome_csv, nome_participantes_bin);
+            if (!READ_EM_SEGUNDO_PLANO || iniciar_importacao_segundo_plano(nome_csv) != 0) {
+                importar_participantes_csv(nome_csv, nome_participantes_bin, 0);
+            }
+        } else if (strcmp(comando_base, "reload") == 0) {
+            if (recusar_durante_importacao("RELOAD")) continue;
+            printf("\nEscreva o nome do arquivo csv da nova base (incluindo a extensao)\n");
+            if (fgets(nome_csv, 100, stdin) == NULL) continue;
+            nome_csv[strcspn(nome_csv, "\r\n")] = '\0';
+            recarregar_base(nome_csv);
+        } else if (strcmp(comando_base, "reindex") == 0) {
+            if (recusar_durante_importacao("REINDEX")) continue;
+            reindexar_base(nome_participantes_bin);
         } else if (strcmp(comando_base, "show") == 0) {
-            ler_todos_participantes(nome_participantes_bin);
+            ler_todos_participantes();
         }
         else if (strcmp(comando_base, "filter") == 0) {
             if (arg[0] != '\0') {
@@ -2510,6 +7627,13 @@ int main(void) {
             } else {
                 printf("Comando FIND requer o NU_SEQ (ex: FIND 1234567890123).\n");
             }
+        } else if (strcmp(comando_base, "pool") == 0) {
+            to_lowercase(arg);
+            mostrar_estatisticas_pool(strcmp(arg, "zerar") == 0);
+        } else if (strcmp(comando_base, "config") == 0 && arg[0] != '\0') {
+            if (recusar_durante_importacao("CONFIG <PARAMETRO>")) continue;
+            to_lowercase(arg);
+            configurar_parametro(arg);
         } else if (strcmp(comando_base, "config") == 0) {
             printf("\nDigite quantos registros voce quer que aparecam por pagina\n");
             if (fgets(comando, COMMAND_MAX_SIZE, stdin) == NULL) continue;
@@ -2532,6 +7656,7 @@ int main(void) {
                    printf("\nArgumento invalido '%s'", comando);
                 }
         } else if (strcmp(comando_base, "exit") == 0) {
+            recolher_importacao_segundo_plano(1);
             printf("\nSaindo do programa...\n");
             sair = true;
         } else {
@@ -2541,6 +7666,7 @@ int main(void) {
 
     // 2. Fecha todos os arquivos antes de sair
     fechar_arvores();
+    sair_versao_base();
 
     return 0;
 }
@@ -0,0 +1,280 @@
+#!/bin/bash
+# Teste de regressao do RevisaoFinal.c: importa um CSV gerado a partir do RESULTADOS_2024_simplificado.csv
+# em varios cenarios e confere se as consultas (LIST, FIND, FILTER) dao exatamente o mesmo resultado
+# da importacao de referencia.
+#
+# Uso: ./teste_regressao.sh [qtd_linhas]      (padrao: 50000)
+# Variaveis: CC (padrao gcc), CFLAGS (ex.: CFLAGS=-DNOTA_PONTO_FIXO=1), MANTER=1 mantem o diretorio de trabalho
+
+set -u
+
+RAIZ=$(cd "$(dirname "$0")" && pwd)
+QTD_LINHAS=${1:-50000}
+TRABALHO=$(mktemp -d "${TMPDIR:-/tmp}/teste_regressao.XXXXXX")
+PROGRAMA="$TRABALHO/revisao"
+FALHAS=0
+
+limpar() {
+    if [ "${MANTER:-0}" = "1" ]; then
+        echo "Diretorio de trabalho mantido em $TRABALHO"
+    else
+        rm -rf "$TRABALHO"
+    fi
+}
+trap limpar EXIT
+
+# Linhas do CSV original sem campo vazio, repetidas com NU_SEQUENCIAL unico (a partir de $2, padrao
+# 900000000) e notas variadas
+gerar_csv() {
+    LC_ALL=C awk -F';' -v OFS=';' -v qtd="$1" -v primeiro="${2:-900000000}" '
+        { sub(/\r$/, "") }
+        NR == 1 { print $0 "\r"; next }
+        {
+            for (i = 1; i <= NF; i++) if ($i == "") next
+            linhas[n++] = $0
+        }
+        END {
+            for (i = 0; i < qtd; i++) {
+                split(linhas[i % n], c, ";")
+                c[1] = primeiro + i
+                for (k = 23; k <= 26; k++) c[k] = sprintf("%.1f", 300 + ((i * (k + 7919)) % 6000) / 10)
+                c[42] = ((i * 37) % 51) * 20
+                linha = c[1]
+                for (k = 2; k <= 42; k++) linha = linha OFS c[k]
+                print linha "\r"
+            }
+        }' "$RAIZ/RESULTADOS_2024_simplificado.csv"
+}
+
+# Roda o programa em `dir` com os comandos recebidos na entrada padrao
+rodar() {
+    (cd "$1" && "$PROGRAMA" > "$2" 2>&1)
+}
+
+# Consultas conferidas em todos os cenarios: as 5 notas listadas inteiras (uma pagina so), FIND e FILTER
+CONSULTAS='config
+100000
+list red
+2
+back
+list mt
+1
+back
+list cn
+1
+back
+list ch
+2
+back
+list lc
+1
+back
+find 900000007
+find 900000123
+filter CE
+back
+filter SP
+back
+exit
+'
+
+# Consultas numa sessao separada da importacao
+consultar() {
+    printf '%s' "$CONSULTAS" | rodar "$1" "$1/sessao.txt"
+}
+
+# Saida das consultas de uma sessao: do CONFIG delas ate o ultimo prompt antes do EXIT (ou do POOL que
+# vem depois delas). Assim elas podem rodar na mesma sessao da importacao
+extrair_consultas() {
+    awk '/^Digite quantos registros voce quer que aparecam por pagina/ { p = 1 }
+         /^(Cache de paginas dos indices|Saindo do programa)/ { exit }
+         p { if (n++) print anterior; anterior = $0 }' "$1/sessao.txt" > "$1/consultas.txt"
+}
+
+# Compara as consultas de um cenario com as da referencia
+conferir() {
+    local nome=$1 dir=$2
+    extrair_consultas "$dir"
+    if cmp -s "$TRABALHO/referencia/consultas.txt" "$dir/consultas.txt"; then
+        echo "ok    $nome"
+    else
+        echo "FALHA $nome (diff $TRABALHO/referencia/consultas.txt $dir/consultas.txt)"
+        FALHAS=$((FALHAS + 1))
+        MANTER=1
+    fi
+}
+
+novo_cenario() {
+    mkdir -p "$TRABALHO/$1"
+    echo "$TRABALHO/$1"
+}
+
+echo "Compilando..."
+if ! ${CC:-gcc} -O2 -Wall ${CFLAGS:-} -o "$PROGRAMA" "$RAIZ/RevisaoFinal.c" -lm -lpthread 2> "$TRABALHO/compilacao.txt"; then
+    cat "$TRABALHO/compilacao.txt"
+    echo "FALHA na compilacao"
+    exit 1
+fi
+if grep -q "warning:" "$TRABALHO/compilacao.txt"; then
+    cat "$TRABALHO/compilacao.txt"
+    echo "FALHA compilacao: o -Wall deu avisos"
+    FALHAS=$((FALHAS + 1))
+fi
+
+echo "Gerando CSV com $QTD_LINHAS linhas..."
+gerar_csv "$QTD_LINHAS" > "$TRABALHO/entrada.csv"
+
+# Referencia: READ com as configuracoes padrao
+dir=$(novo_cenario referencia)
+printf 'read\n%s\nexit\n' "$TRABALHO/entrada.csv" | rodar "$dir" "$dir/read.txt"
+consultar "$dir"
+extrair_consultas "$dir"
+if [ "$(grep -c "Total de Registros: $QTD_LINHAS)" "$dir/consultas.txt")" -ne 5 ]; then
+    echo "FALHA referencia: LIST nao mostra os $QTD_LINHAS participantes nas 5 notas"
+    FALHAS=$((FALHAS + 1))
+fi
+
+# Cache de paginas de 1 MB, com as consultas na mesma sessao do READ: as listas nao cabem no pool, e os
+# metadados das arvores recem-construidas (paginas sujas) sao descartados e relidos do disco
+dir=$(novo_cenario pool_pequeno)
+printf 'config pool\n1\nread\n%s\n%spool\nexit\n' "$TRABALHO/entrada.csv" "${CONSULTAS%exit*}" | rodar "$dir" "$dir/sessao.txt"
+if ! grep -q "Paginas descartadas: [1-9]" "$dir/sessao.txt"; then
+    echo "aviso pool_pequeno: nenhuma pagina foi descartada; aumente qtd_linhas"
+fi
+conferir "pool pequeno (CONFIG POOL 1)" "$dir"
+
+# READ morto num ponto exato (FALHA_IMPORTACAO=<ponto>:<n>: o programa sai na hora, como num kill -9),
+# numa base vazia, e retomado por outro READ: as consultas tem de dar o mesmo resultado da referencia
+retomar_apos_falha() {
+    local cenario=$1 falha=$2 descricao=$3
+    dir=$(novo_cenario "$cenario")
+    printf 'config checkpoint\n2\n%d\nread\n%s\nexit\n' $((QTD_LINHAS / 10)) "$TRABALHO/entrada.csv" |
+        FALHA_IMPORTACAO=$falha rodar "$dir" "$dir/read_morto.txt"
+    if ! grep -q "FALHA_IMPORTACAO: processo encerrado" "$dir/read_morto.txt" || [ ! -f "$dir/importacao.ckpt" ]; then
+        echo "FALHA $cenario: o READ nao parou em $falha"
+        FALHAS=$((FALHAS + 1))
+        return
+    fi
+    printf 'read\n%s\nexit\n' "$TRABALHO/entrada.csv" | rodar "$dir" "$dir/read.txt"
+    if ! grep -q "Retomando o READ interrompido" "$dir/read.txt" || grep -q "mudaram" "$dir/read.txt"; then
+        echo "FALHA $cenario: o READ nao foi retomado do checkpoint"
+        FALHAS=$((FALHAS + 1))
+    fi
+    consultar "$dir"
+    conferir "$descricao" "$dir"
+}
+
+retomar_apos_falha retomada_checkpoint checkpoint:3 "READ morto no 2o checkpoint da leitura e retomado"
+retomar_apos_falha retomada_indice indice:1 "READ morto com o 1o indice pronto e retomado"
+retomar_apos_falha retomada_indices indice:5 "READ morto com 5 indices prontos e retomado"
+
+# Motor LSM: 5 READs com partes do CSV deixam 5 runs por nota, e o ultimo dispara a compactacao. As
+# consultas na mesma sessao rodam junto com ela (sem esperar, sobre o manifesto de antes) e depois numa
+# sessao nova, com as runs ja compactadas
+dir=$(novo_cenario lsm)
+qtd_parte=$(((QTD_LINHAS + 4) / 5))
+for k in 1 2 3 4 5; do
+    { head -n 1 "$TRABALHO/entrada.csv"; tail -n +$(((k - 1) * qtd_parte + 2)) "$TRABALHO/entrada.csv" | head -n $qtd_parte; } > "$dir/parte_$k.csv"
+done
+{
+    printf 'config motor\ntodas\n2\n'
+    for k in 1 2 3 4 5; do printf 'read\nparte_%d.csv\n' $k; done
+    printf '%s' "$CONSULTAS"
+} | rodar "$dir" "$dir/sessao.txt"
+conferir "motor LSM, consultas durante a compactacao" "$dir"
+if [ "$(find "$dir" -name 'nota_*_run_*.dat' | wc -l)" -ne 5 ]; then
+    echo "FALHA lsm: as runs de cada nota nao foram compactadas numa so (ou as antigas nao foram apagadas)"
+    FALHAS=$((FALHAS + 1))
+fi
+consultar "$dir"
+conferir "motor LSM depois da compactacao" "$dir"
+
+# READ em segundo plano sobre uma base com os primeiros 2% do CSV. Enquanto ele roda, cada LIST (uma
+# pagina so) tem de percorrer na arvore tantos participantes quantos a versao que ele usou diz existir
+dir=$(novo_cenario segundo_plano)
+qtd_a=$((QTD_LINHAS / 50))
+head -n $((qtd_a + 1)) "$TRABALHO/entrada.csv" > "$dir/a.csv"
+{ head -n 1 "$TRABALHO/entrada.csv"; tail -n +$((qtd_a + 2)) "$TRABALHO/entrada.csv"; } > "$dir/b.csv"
+printf 'read\na.csv\nexit\n' | rodar "$dir" "$dir/read_a.txt"
+{
+    printf 'config\n100000\nconfig segundoplano\n1\nconfig checkpoint\n2\n%d\nread\nb.csv\n' $((QTD_LINHAS / 50))
+    for _ in $(seq 30); do
+        printf 'list cn\n1\nback\n'
+        sleep 0.02
+    done
+    printf 'exit\n'
+} | rodar "$dir" "$dir/read_b.txt"
+resultado=$(awk '
+    function conferir_lista() {
+        if (total != "") { conferidas++; if (linhas != total) erros++; if (total + 0 > maior) maior = total + 0 }
+        total = ""
+    }
+    /em andamento: [0-9]+ participantes visiveis/ { conferir_lista(); andamento = 1 }
+    /concluido\.$/ { conferir_lista(); andamento = 0 }
+    /^Pagina 1 de .*Total de Registros: [0-9]+\)/ {
+        if (andamento) { total = $0; sub(/.*Total de Registros: /, "", total); sub(/\).*/, "", total); linhas = 0 }
+    }
+    /^9[0-9]+ \| / { linhas++ }
+    END { print conferidas + 0, erros + 0, maior + 0 }' "$dir/read_b.txt")
+read -r conferidas erros maior <<< "$resultado"
+if [ "$erros" -ne 0 ]; then
+    echo "FALHA segundo_plano: o LIST nao percorreu os participantes que a versao mostra ($erros de $conferidas)"
+    FALHAS=$((FALHAS + 1))
+elif [ "$conferidas" -eq 0 ]; then
+    echo "aviso segundo_plano: nenhum LIST rodou durante o READ; aumente qtd_linhas"
+elif [ "$maior" -le "$qtd_a" ]; then
+    echo "aviso segundo_plano: nenhum LIST rodou depois de um checkpoint do READ; aumente qtd_linhas"
+fi
+# Os segmentos parciais dos checkpoints sao apagados quando a ultima versao que os usa e liberada
+if ls "$dir"/parcial_* > /dev/null 2>&1; then
+    echo "FALHA segundo_plano: sobraram arquivos dos segmentos parciais"
+    FALHAS=$((FALHAS + 1))
+fi
+consultar "$dir"
+conferir "READ em segundo plano" "$dir"
+
+# RELOAD do CSV inteiro sobre uma base com outros participantes: a versao nova (base_1) tem de ficar so
+# com o CSV do RELOAD, e uma sessao nova tem de abrir nela pelo ponteiro
+dir=$(novo_cenario reload)
+gerar_csv $((QTD_LINHAS / 50)) 800000000 > "$dir/antiga.csv"
+printf 'read\nantiga.csv\nreload\n%s\nexit\n' "$TRABALHO/entrada.csv" | rodar "$dir" "$dir/reload.txt"
+if ! grep -q "Base trocada: 'base_1'" "$dir/reload.txt" || [ "$(cat "$dir/base_atual" 2> /dev/null)" != "base_1" ]; then
+    echo "FALHA reload: a base nao foi trocada para base_1"
+    FALHAS=$((FALHAS + 1))
+fi
+if [ -f "$dir/participantes.bin" ]; then
+    echo "FALHA reload: a versao antiga da base nao foi apagada"
+    FALHAS=$((FALHAS + 1))
+fi
+consultar "$dir"
+conferir "RELOAD" "$dir"
+
+# READ de um CSV gzip truncado, sobre a base da referencia: o descompressor falha depois de alguns
+# checkpoints e o READ inteiro tem de ser desfeito
+if command -v gzip > /dev/null; then
+    dir=$(novo_cenario gzip_truncado)
+    gerar_csv "$QTD_LINHAS" 800000000 | gzip -c > "$dir/completo.csv.gz"
+    tamanho=$(wc -c < "$dir/completo.csv.gz")
+    head -c $((tamanho / 2)) "$dir/completo.csv.gz" > "$dir/truncado.csv.gz"
+    printf 'read\n%s\nconfig checkpoint\n2\n%d\nread\ntruncado.csv.gz\nexit\n' "$TRABALHO/entrada.csv" $((QTD_LINHAS / 10)) |
+        rodar "$dir" "$dir/read.txt"
+    if ! grep -q "READ desfeito" "$dir/read.txt"; then
+        echo "FALHA gzip_truncado: o READ do CSV truncado nao foi desfeito"
+        FALHAS=$((FALHAS + 1))
+    fi
+    if [ -f "$dir/importacao.ckpt" ]; then
+        echo "FALHA gzip_truncado: sobrou o checkpoint do READ desfeito"
+        FALHAS=$((FALHAS + 1))
+    fi
+    consultar "$dir"
+    conferir "CSV gzip truncado" "$dir"
+else
+    echo "aviso: sem gzip; cenario do CSV truncado nao executado"
+fi
+
+if [ "$FALHAS" -eq 0 ]; then
+    echo "Todos os cenarios passaram."
+else
+    echo "$FALHAS cenario(s) falharam."
+fi
+exit $((FALHAS > 0))